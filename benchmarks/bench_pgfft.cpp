@@ -0,0 +1,117 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+#include <benchmark/benchmark.h>
+#include <complex>
+#include <vector>
+
+#include <NTL/BasicThreadPool.h>
+#include <helib/PGFFT.h>
+
+// The single-vector PGFFT::apply (with each of the SIMD paths), the batched
+// PGFFT::apply_batch and the multi-threaded PGFFT::apply_mt, for the
+// (m/2)-point transforms used by CKKS encoding with m = 2^12, ..., 2^17.
+
+typedef std::complex<double> cmplx_t;
+
+static std::vector<cmplx_t> randomVectors(long n, long count)
+{
+  std::vector<cmplx_t> v(n * count);
+  for (long i = 0; i < n * count; i++)
+    v[i] = cmplx_t(i % 17 - 8, i % 13 - 6);
+  return v;
+}
+
+static void BM_pgfft_single(benchmark::State& state)
+{
+  long n = state.range(0);
+  long count = state.range(1);
+  helib::PGFFT fft(n);
+  std::vector<cmplx_t> v = randomVectors(n, count);
+
+  for (auto _ : state)
+    for (long i = 0; i < count; i++)
+      fft.apply(&v[i * n]);
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+static void BM_pgfft_batch(benchmark::State& state)
+{
+  long n = state.range(0);
+  long count = state.range(1);
+  helib::PGFFT fft(n);
+  std::vector<cmplx_t> v = randomVectors(n, count);
+
+  for (auto _ : state)
+    fft.apply_batch(&v[0], &v[0], count, n);
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+static void BM_pgfft_mt(benchmark::State& state)
+{
+  long n = state.range(0);
+  long nthreads = state.range(1);
+  helib::PGFFT fft(n);
+  std::vector<cmplx_t> v = randomVectors(n, 1);
+
+  // apply_mt takes its threads from NTL's pool
+  long oldThreads = NTL::AvailableThreads();
+  NTL::SetNumThreads(nthreads);
+  for (auto _ : state)
+    fft.apply_mt(&v[0], &v[0], nthreads);
+  NTL::SetNumThreads(oldThreads);
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// The same, forcing each of the SIMD paths (if supported by the CPU)
+static void BM_pgfft_simd_path(benchmark::State& state)
+{
+  long n = state.range(0);
+  helib::PGFFT fft(n);
+  std::vector<cmplx_t> v = randomVectors(n, 1);
+
+  const helib::PGFFT::simd_path best = helib::PGFFT::simd_enabled();
+  auto path = helib::PGFFT::simd_path(state.range(1));
+  if (helib::PGFFT::set_simd_path(path) != path)
+    state.SkipWithError("SIMD path not supported by this CPU");
+
+  for (auto _ : state)
+    fft.apply(&v[0]);
+
+  helib::PGFFT::set_simd_path(best);
+  state.SetItemsProcessed(state.iterations());
+}
+
+// {n, number of vectors}
+BENCHMARK(BM_pgfft_single)
+    ->Unit(benchmark::kMicrosecond)
+    ->Ranges({{1 << 11, 1 << 16}, {1, 16}});
+BENCHMARK(BM_pgfft_batch)
+    ->Unit(benchmark::kMicrosecond)
+    ->Ranges({{1 << 11, 1 << 16}, {1, 16}});
+
+// {n, number of threads}, n = 1 thread is the same as apply
+BENCHMARK(BM_pgfft_mt)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime()
+    ->Ranges({{1 << 15, 1 << 16}, {1, 8}});
+
+// {n, SIMD path}
+BENCHMARK(BM_pgfft_simd_path)
+    ->Unit(benchmark::kMicrosecond)
+    ->ArgsProduct({{1 << 12, 1 << 15, 12345},
+                   {helib::PGFFT::SIMD_NONE,
+                    helib::PGFFT::SIMD_AVX2,
+                    helib::PGFFT::SIMD_AVX512}});
@@ -97,9 +97,20 @@ public:
    */
   Cmodulus(const PAlgebra& zms, long qq, long rt);
 
+  /**
+   * @brief Constructor from the tables written by writeTables
+   * @note Restores q, the root of unity and the Bluestein FFT tables without
+   * recomputing them. NTL's own tables for q and the reduction tables for
+   * Phi_m(X) mod q are rebuilt.
+   */
+  Cmodulus(const PAlgebra& zms, std::istream& str);
+
   //! Copy assignment operator
   Cmodulus& operator=(const Cmodulus& other);
 
+  //! @brief Writes q, the root of unity and the Bluestein FFT tables
+  void writeTables(std::ostream& str) const;
+
   // utility methods
 
   const PAlgebra& getZMStar() const { return *zMStar; }
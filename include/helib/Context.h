@@ -22,6 +22,7 @@
 #include <helib/primeChain.h>
 #include <helib/powerful.h>
 #include <helib/apiAttributes.h>
+#include <helib/lazyPtr.h>
 
 #include <NTL/Lazy.h>
 
@@ -60,6 +61,10 @@ class Context
   // This is private since the implementation assumes that the list of
   // primes only grows and no prime is ever modified or removed.
 
+  // Appends the Cmodulus objects for qs to moduli, building them in
+  // parallel, and returns the index of the first one
+  long addModuli(const std::vector<long>& qs);
+
 public:
   // Context is meant for convenience, not encapsulation: Most data
   // members are public and can be initialized by the application program.
@@ -70,16 +75,17 @@ public:
   //! @brief The structure of Z[X]/(Phi_m(X),p^r)
   PAlgebraMod alMod;
 
-  //! @brief A default EncryptedArray
-  std::shared_ptr<const EncryptedArray> ea;
+  //! @brief A default EncryptedArray, built on first access
+  LazyPtr<const EncryptedArray> ea;
 
   std::shared_ptr<const PowerfulDCRT> pwfl_converter;
 
   /** @brief The structure of a single slot of the plaintext space.
    *
    * This will be Z[X]/(G(x),p^r) for some irreducible factor G of Phi_m(X).
+   * Built on first access, it is null for CKKS.
    **/
-  std::shared_ptr<PolyModRing> slotRing;
+  LazyPtr<PolyModRing> slotRing;
 
   //! @brief sqrt(variance) of the LWE error (default=3.2)
   NTL::xdouble stdev;
@@ -327,13 +333,33 @@ public:
   void makeBootstrappable(const NTL::Vec<long>& mvec,
                           long skWht = 0,
                           bool build_cache = false,
-                          bool alsoThick = true)
+                          bool alsoThick = true,
+                          long streamWindow = 0)
   {
-    rcData.init(*this, mvec, alsoThick, skWht, build_cache);
+    rcData.init(*this,
+                mvec,
+                alsoThick,
+                skWht,
+                build_cache,
+                /*minimal=*/false,
+                streamWindow);
   }
 
   bool isBootstrappable() const { return rcData.alMod != nullptr; }
 
+  /**
+   * @brief Marks this context as never using the plaintext slots.
+   *
+   * The slot-related structures (the alMod tables, ea and slotRing) are
+   * built lazily, the first time they are used. A context that only does
+   * key generation, key switching or arithmetic on encoded polynomials never
+   * builds them. After calling disableSlots(), any attempt to build them
+   * throws a LogicError instead, which catches unintended uses early.
+   * Structures that were already built stay available.
+   **/
+  void disableSlots() { alMod.disable(); }
+  bool slotsDisabled() const { return alMod.isDisabled(); }
+
   IndexSet fullPrimes() const { return ctxtPrimes | specialPrimes; }
 
   IndexSet allPrimes() const
@@ -432,6 +458,13 @@ public:
   void AddCtxtPrime(long q);
   void AddSpecialPrime(long q);
 
+  //! @brief Add the given primes to the chain, in this order. The Cmodulus
+  //! tables of the primes (NTL's FFT tables, Bluestein FFT tables, and
+  //! Phi_m(X) mod q) are built in parallel.
+  void AddSmallPrimes(const std::vector<long>& qs);
+  void AddCtxtPrimes(const std::vector<long>& qs);
+  void AddSpecialPrimes(const std::vector<long>& qs);
+
   ///@{
   /**
      @name I/O routines
@@ -486,7 +519,9 @@ public:
   friend std::istream& operator>>(std::istream& str, Context& context);
   ///@}
 
-  friend void writeContextBinary(std::ostream& str, const Context& context);
+  friend void writeContextBinary(std::ostream& str,
+                                 const Context& context,
+                                 bool withTables);
   friend void readContextBinary(std::istream& str, Context& context);
 };
 
@@ -503,7 +538,16 @@ std::unique_ptr<Context> buildContextFromAscii(std::istream& str);
 
 //! @brief write [m p r gens ords] data
 void writeContextBaseBinary(std::ostream& str, const Context& context);
-void writeContextBinary(std::ostream& str, const Context& context);
+/**
+ * @brief Writes the context data that follows the base data.
+ * @param withTables Also write the precomputed tables of the primes (the
+ * Bluestein FFT tables of each Cmodulus, and the ModuliSizes table), so that
+ * readContextBinary does not have to recompute them. This makes the output
+ * roughly 4m words larger per prime.
+ **/
+void writeContextBinary(std::ostream& str,
+                        const Context& context,
+                        bool withTables = false);
 
 //! @brief read [m p r gens ords] data, needed to construct context
 void readContextBaseBinary(std::istream& s,
@@ -68,6 +68,7 @@ class Ptxt;
 class KeySwitch;
 class PubKey;
 class SecKey;
+class EncodedPtxt;
 
 /**
  * @class SKHandle
@@ -271,6 +272,7 @@ class Ctxt
   friend class PubKey;
   friend class SecKey;
   friend class BasicAutomorphPrecon;
+  friend class SeededCtxt;
 
   const Context& context;      // points to the parameters of this FHE instance
   const PubKey& pubKey;        // points to the public encryption key;
@@ -454,6 +456,15 @@ public:
    **/
   Ctxt& operator*=(const Ptxt<BGV>& other);
 
+  //! @brief Plus equals operator with a pre-encoded `BGV` plaintext.
+  Ctxt& operator+=(const EncodedPtxt& other);
+
+  //! @brief Minus equals operator with a pre-encoded `BGV` plaintext.
+  Ctxt& operator-=(const EncodedPtxt& other);
+
+  //! @brief Times equals operator with a pre-encoded `BGV` plaintext.
+  Ctxt& operator*=(const EncodedPtxt& other);
+
   // CKKS case
   /**
    * @brief Plus equals operator with a `CKKS` `Ptxt`.
@@ -510,6 +521,8 @@ public:
     addConstant(ptxt.getPolyRepr());
   }
   void addConstant(const NTL::ZZ& c);
+  //! Add (or subtract, if negative is set) a pre-encoded plaintext
+  void addConstant(const EncodedPtxt& ptxt, bool negative = false);
   //! add a rational number in the form a/b, a,b are long
   void addConstantCKKS(std::pair</*numerator=*/long, /*denominator=*/long>);
   void addConstantCKKS(double x)
@@ -541,6 +554,10 @@ public:
   void multByConstant(const NTL::ZZX& poly, double size = -1.0);
   void multByConstant(const zzX& poly, double size = -1.0);
   void multByConstant(const NTL::ZZ& c);
+  void multByConstant(const EncodedPtxt& ptxt);
+  //! Multiply by a constant held in external memory, see
+  //! DoubleCRT::Mul(const std::vector<const long*>&). BGV only.
+  void multByConstant(const std::vector<const long*>& rows, double size);
 
   /**
    * @brief Multiply a `BGV` plaintext to this `Ctxt`.
@@ -634,7 +651,8 @@ public:
   void divideBy2();
   void extractBits(std::vector<Ctxt>& bits, long nBits2extract = 0);
 
-  // Higher-level multiply routines
+  // Higher-level multiply routines. These bootstrap their operands first
+  // when the key has an auto-bootstrap policy, see PubKey::setAutoBootstrap
   void multiplyBy(const Ctxt& other);
   void multiplyBy2(const Ctxt& other1, const Ctxt& other2);
   void square() { multiplyBy(*this); }
@@ -722,6 +740,13 @@ public:
   //! additive mod switching noise)
   double rawModSwitch(std::vector<NTL::ZZX>& zzParts, long toModulus) const;
 
+  //! @brief Same as above, but the parts are returned in the powerful basis
+  //! as vectors of words, each coefficient in [-toModulus/2, toModulus/2].
+  //! This skips the conversion to ZZX, which bootstrapping does only after
+  //! more word-sized processing in that basis.
+  double rawModSwitch(std::vector<NTL::Vec<long>>& pwrflParts,
+                      long toModulus) const;
+
   //! @brief compute the power X,X^2,...,X^n
   //  void computePowers(std::vector<Ctxt>& v, long nPowers) const;
 
@@ -808,6 +833,45 @@ public:
   static void equalizeRationalFactors(Ctxt& c1, Ctxt& c2);
 };
 
+/**
+ * @class SeededCtxt
+ * @brief A compact form of a fresh symmetric-key encryption
+ *
+ * A fresh encryption under the secret key is a pair (c0,c1) where c1 is
+ * uniformly random. As with the bottom row of a key-switching matrix (see
+ * KeySwitch::prgSeed), c1 can be regenerated from a short seed, so a
+ * SeededCtxt keeps only c0 and the seed, which makes it about half the size
+ * of the corresponding Ctxt in memory and when serialized. It is produced by
+ * SecKey::skEncrypt, and expanded into a usable Ctxt (relative to any
+ * PubKey for the same secret key) by expand() or expandSeededCtxts().
+ **/
+class SeededCtxt
+{
+  friend class SecKey;
+
+  Ctxt ctxt;           // the ciphertext without its random part
+  SKHandle randHandle; // the handle of the random part
+  NTL::ZZ prgSeed;     // the seed to generate the random part
+
+public:
+  explicit SeededCtxt(const PubKey& newPubKey) : ctxt(newPubKey) {}
+
+  const Context& getContext() const { return ctxt.getContext(); }
+  const PubKey& getPubKey() const { return ctxt.getPubKey(); }
+
+  //! @brief Regenerate the random part, out must have the same PubKey
+  void expand(Ctxt& out) const;
+
+  // Raw IO
+  void write(std::ostream& str) const;
+  void read(std::istream& str);
+};
+
+//! @brief Expand a vector of seeded ciphertexts, in parallel.
+//! out is resized as needed, using the PubKey of in[0].
+void expandSeededCtxts(std::vector<Ctxt>& out,
+                       const std::vector<SeededCtxt>& in);
+
 // set out=prod_{i=0}^{n-1} v[j], takes depth log n and n-1 products
 // out could point to v[0], but having it pointing to any other v[i]
 // will make the result unpredictable.
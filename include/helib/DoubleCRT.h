@@ -328,6 +328,11 @@ public:
     do_mul(other, matchIndexSets);
   }
 
+  //! @brief Multiply by a constant held in external memory, such as a
+  //! memory-mapped file: rows[i] points to the phi(m) evaluations of the
+  //! constant modulo the i'th prime. Every prime of *this must have a row.
+  void Mul(const std::vector<const long*>& rows);
+
   // Division by constant
   DoubleCRT& operator/=(const NTL::ZZ& num);
   DoubleCRT& operator/=(long num) { return (*this /= NTL::to_ZZ(num)); }
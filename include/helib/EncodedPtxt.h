@@ -0,0 +1,191 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_ENCODEDPTXT_H
+#define HELIB_ENCODEDPTXT_H
+/**
+ * @file EncodedPtxt.h
+ * @brief A BGV plaintext, pre-encoded for repeated use with ciphertexts.
+ **/
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <helib/Context.h>
+#include <helib/DoubleCRT.h>
+#include <helib/IndexSet.h>
+#include <helib/multicore.h>
+#include <helib/zzX.h>
+
+namespace helib {
+
+struct BGV;
+template <typename Scheme>
+class Ptxt;
+
+/**
+ * @class EncodedPtxt
+ * @brief A BGV plaintext constant, encoded once and reused.
+ *
+ * Every Ctxt constant operation on a Ptxt<BGV> or a ZZX re-encodes the
+ * plaintext into a polynomial, computes its size, and converts it to a
+ * DoubleCRT. An EncodedPtxt does the first two steps once, and keeps the
+ * encoding in the compact zzX form (balanced modulo p^r).
+ *
+ * The DoubleCRT forms, which make the constant operations much faster but
+ * take up (number of primes) times more memory, are governed by a simple
+ * memory policy, in the spirit of ConstMultiplierCache in matmul.cpp:
+ *   - By default (downgraded) only the zzX is kept, and the DoubleCRT is
+ *     computed on the fly for each operation.
+ *   - After upgrade(), the DoubleCRT form for each prime set is computed
+ *     the first time it is needed and cached. A cached form over a superset
+ *     of the primes of a ciphertext is reused for it.
+ *   - downgrade() drops all the cached DoubleCRT forms.
+ *
+ * An EncodedPtxt may be used concurrently by several threads.
+ **/
+class EncodedPtxt
+{
+public:
+  /**
+   * @brief Encodes a BGV plaintext.
+   * @param context The context of the ciphertexts it will be used with.
+   * @param ptxt The plaintext to encode.
+   **/
+  EncodedPtxt(const Context& context, const Ptxt<BGV>& ptxt);
+
+  //! @brief Wraps an already encoded polynomial.
+  EncodedPtxt(const Context& context, const zzX& poly);
+  EncodedPtxt(const Context& context, const NTL::ZZX& poly);
+
+  //! The copy has the same policy, and shares the cached DoubleCRT forms.
+  EncodedPtxt(const EncodedPtxt& other);
+  EncodedPtxt& operator=(const EncodedPtxt&) = delete;
+
+  const Context& getContext() const { return context; }
+
+  //! @brief The encoded polynomial
+  const zzX& getPoly() const { return poly; }
+
+  //! @brief The largest coefficient of the canonical embedding of the
+  //! polynomial, used to update the noise bound of ciphertexts.
+  double getSize() const { return size; }
+
+  /**
+   * @brief Returns the DoubleCRT form over (at least) the primes in s.
+   * @note The result is cached if this object is upgraded, and is computed
+   * afresh otherwise.
+   **/
+  std::shared_ptr<const DoubleCRT> getDCRT(const IndexSet& s) const;
+
+  //! @brief Cache the DoubleCRT forms from now on.
+  void upgrade();
+
+  //! @brief Same as upgrade(), and also compute the form over s right now.
+  void upgrade(const IndexSet& s);
+
+  //! @brief Drop the cached DoubleCRT forms, and stop caching them.
+  void downgrade();
+
+  bool isUpgraded() const;
+
+  //! @brief An estimate of the memory used by this object, in bytes.
+  std::size_t memoryUsage() const;
+
+private:
+  const Context& context;
+  zzX poly;
+  double size;
+
+  bool upgraded;
+  mutable std::vector<std::pair<IndexSet, std::shared_ptr<const DoubleCRT>>>
+      dcrts;
+  mutable HELIB_MUTEX_TYPE mtx; // guards upgraded and dcrts
+
+  void init();
+};
+
+/**
+ * @class EncodedPtxtCache
+ * @brief A thread-safe cache of upgraded EncodedPtxt objects, with a
+ * memory cap.
+ *
+ * Entries are identified by a key (a vector of longs, whose meaning is up to
+ * the user) and are built on first use. Each entry caches the DoubleCRT forms
+ * of its constant for the prime sets it is used with. When the memory used by
+ * all the entries goes over the limit, the least recently used ones are
+ * dropped (objects still in use elsewhere stay valid, through their
+ * shared_ptr).
+ **/
+class EncodedPtxtCache
+{
+public:
+  typedef std::vector<long> Key;
+
+  //! @brief Constructor, limit is in bytes; 0 disables the cache.
+  explicit EncodedPtxtCache(std::size_t limit);
+
+  //! The copy is empty, with the same limit.
+  EncodedPtxtCache(const EncodedPtxtCache& other);
+  EncodedPtxtCache& operator=(const EncodedPtxtCache&) = delete;
+
+  /**
+   * @brief Returns the entry for key, with its DoubleCRT form over (at least)
+   * the primes in s.
+   * @param key The key of the entry.
+   * @param s The prime set the constant will be used with.
+   * @param build Computes the polynomial of the entry; only called if the
+   * entry is not in the cache. It is called without holding any lock.
+   * @param context The context of the entries.
+   **/
+  std::shared_ptr<const EncodedPtxt> get(const Key& key,
+                                         const IndexSet& s,
+                                         const std::function<zzX()>& build,
+                                         const Context& context);
+
+  //! @brief Change the memory limit, dropping entries if needed.
+  void setLimit(std::size_t limit);
+  std::size_t getLimit() const;
+
+  //! @brief Memory used by the entries, in bytes.
+  std::size_t memoryUsage() const;
+
+  //! @brief Number of entries.
+  long size() const;
+
+  //! @brief Drop all the entries.
+  void clear();
+
+private:
+  struct Entry
+  {
+    std::shared_ptr<EncodedPtxt> ptxt;
+    std::size_t bytes;
+    unsigned long lastUse;
+  };
+
+  std::map<Key, Entry> entries;
+  std::size_t limit;
+  std::size_t total;     // sum of the bytes of the entries
+  unsigned long useCount; // clock for the LRU policy
+  mutable HELIB_MUTEX_TYPE mtx; // guards everything above
+
+  // Drop the least recently used entries until total <= limit.
+  // Must be called with the lock held.
+  void evict();
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_ENCODEDPTXT_H
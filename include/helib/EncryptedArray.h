@@ -18,6 +18,7 @@
 #include <exception>
 #include <cmath>
 #include <complex>
+#include <functional>
 #include <NTL/Lazy.h>
 #include <NTL/pair.h>
 #include <NTL/SmartPtr.h>
@@ -25,6 +26,7 @@
 #include <helib/DoubleCRT.h>
 #include <helib/Context.h>
 #include <helib/Ctxt.h>
+#include <helib/EncodedPtxt.h>
 #include <helib/keys.h>
 
 namespace helib {
@@ -150,6 +152,11 @@ public:
                                                long i,
                                                long amt) const = 0;
 
+  //! @brief The cache of the encoded masks used by rotate, shift and
+  //! badDimensionAutomorphCorrection, which may be used to change its memory
+  //! limit. Returns nullptr for the classes that do not use masks.
+  virtual EncodedPtxtCache* getMaskCache() const { return nullptr; }
+
   ///@{
   //! @name Encoding/decoding methods
   // encode/decode arrays into plaintext polynomials
@@ -342,6 +349,20 @@ private:
   NTL::Lazy<NTL::Pair<NTL::Mat<R>, NTL::Mat<R>>> normalBasisMatrices;
   // a is the matrix, b is its inverse
 
+  // The DoubleCRT forms of the masks used by rotate and shift, which are
+  // otherwise recomputed for every call
+  mutable EncodedPtxtCache maskCache;
+
+  // The polynomial of the mask applied to dimension i by rotate and shift
+  // with amount amt (for i < numOfGens()-1)
+  RX rotationMask(long amt, long i) const;
+
+  // Gets a mask from the cache, building it with build() if needed
+  std::shared_ptr<const EncodedPtxt> getMask(
+      const EncodedPtxtCache::Key& key,
+      const IndexSet& s,
+      const std::function<RX()>& build) const;
+
 public:
   explicit EncryptedArrayDerived(const Context& _context,
                                  const RX& _G,
@@ -349,7 +370,7 @@ public:
 
   EncryptedArrayDerived(const EncryptedArrayDerived& other) // copy constructor
       :
-      context(other.context), tab(other.tab)
+      context(other.context), tab(other.tab), maskCache(other.maskCache)
   {
     RBak bak;
     bak.save();
@@ -380,6 +401,7 @@ public:
     mappingData = other.mappingData;
     linPolyMatrix = other.linPolyMatrix;
     normalBasisMatrices = other.normalBasisMatrices;
+    maskCache.setLimit(other.maskCache.getLimit());
     return *this;
   }
 
@@ -440,6 +462,8 @@ public:
                                                long i,
                                                long k) const override;
 
+  EncodedPtxtCache* getMaskCache() const override { return &maskCache; }
+
   long getP2R() const override { return getTab().getPPowR(); }
 
   // avoid this being "hidden" by other rotate1D's
@@ -1066,6 +1090,27 @@ public:
     decode(array, tmp, scaling);
   }
 
+  /**
+   * @brief Batched version of encode, the vectors are encoded in parallel.
+   * @param ptxts Encoded polynomials, resized to `arrays.size()`.
+   * @param factors The scaling factor used for each of the polynomials.
+   * @param arrays The vectors to encode.
+   * @param useThisSize Size to use for all the vectors. If negative, the
+   * size of each vector is its own largest entry, as in encode.
+   * @param precision Precision to use.
+   **/
+  void encodeMany(std::vector<zzX>& ptxts,
+                  std::vector<double>& factors,
+                  const std::vector<std::vector<cx_double>>& arrays,
+                  double useThisSize = -1,
+                  long precision = -1) const;
+
+  //! @brief Batched version of decode, the polynomials are decoded in
+  //! parallel, each with its own scaling factor.
+  void decodeMany(std::vector<std::vector<cx_double>>& arrays,
+                  const std::vector<zzX>& ptxts,
+                  const std::vector<double>& scalings) const;
+
   void decode(std::vector<double>& array, const zzX& ptxt, double scaling) const
   {
     std::vector<cx_double> v;
@@ -1319,6 +1364,8 @@ public:
     rep->badDimensionAutomorphCorrection(ctxt, i, amt);
   }
 
+  EncodedPtxtCache* getMaskCache() const { return rep->getMaskCache(); }
+
   template <typename PTXT, typename ARRAY>
   void encode(PTXT& ptxt, const ARRAY& array) const
   {
@@ -1527,6 +1574,31 @@ void runningSums(const EncryptedArray& ea, Ctxt& ctxt);
 //! encryption of \f$(y, ..., y)\$, where \f$y = sum_{j=1}^n x_j.\f$
 void totalSums(const EncryptedArray& ea, Ctxt& ctxt);
 
+//! @brief A ctxt that encrypts \f$(x_1, ..., x_n)\f$ is replaced by an
+//! encryption of \f$(y, ..., y)\$, where \f$y = prod_{j=1}^n x_j.\f$
+void totalProducts(const EncryptedArray& ea, Ctxt& ctxt);
+
+//! @brief A ctxt that encrypts \f$(x_1, ..., x_n)\f$ is replaced by an
+//! encryption of \f$(y, ..., y)\$, where \f$y = x_1 op ... op x_n\f$.
+//! @param op An associative and commutative operation, called as
+//! `op(acc, other)` to set `acc = acc op other`.
+void allSlotsReduce(const EncryptedArray& ea,
+                    Ctxt& ctxt,
+                    const std::function<void(Ctxt&, const Ctxt&)>& op);
+
+//! @brief Same as above, for a value spread over several ciphertexts that
+//! are always rotated together (e.g., the bits of a binary number).
+//! `op(acc, other)` may modify `other`, which is a scratch copy.
+void allSlotsReduce(
+    const EncryptedArray& ea,
+    std::vector<Ctxt>& v,
+    const std::function<void(std::vector<Ctxt>&, std::vector<Ctxt>&)>& op);
+// The implementation works one hypercube dimension at a time. A dimension
+// of size n takes O(log n) rotations and a chain of at most ceil(log n)
+// calls to op, so totalProducts has depth sum_i ceil(log n_i) ~ log(nslots).
+// Rotations of the same ciphertext are hoisted when the key-switching
+// strategy allows it.
+
 //! @brief Map all non-zero slots to 1, leaving zero slots as zero.
 //! Assumes that r=1, and that all the slots contain elements from GF(p^d).
 void mapTo01(const EncryptedArray& ea, Ctxt& ctxt);
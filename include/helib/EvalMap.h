@@ -15,6 +15,7 @@
  *  @brief Implementing the recryption linear transformations
  */
 
+#include <string>
 #include <helib/EncryptedArray.h>
 #include <helib/matmul.h>
 
@@ -59,6 +60,13 @@ private:
   long nfactors; // how many factors of m
   std::unique_ptr<BlockMatMul1DExec> mat1;        // one block matrix
   NTL::Vec<std::unique_ptr<MatMul1DExec>> matvec; // regular matrices
+  bool mapped = false; // constants mapped from the cache file
+
+  // The mapped constants file, see setEvalMapCacheDir. readCache returns
+  // false if there is no valid file.
+  bool readCache(const std::string& fileName, const std::string& header);
+  bool writeCache(const std::string& fileName,
+                  const std::string& header) const;
 
 public:
   EvalMap(const EncryptedArray& _ea,
@@ -73,7 +81,16 @@ public:
   // On by default, off for testing
 
   void upgrade();
+  // Convert the constants in a bounded window instead of upgrading them,
+  // see MatMulExecBase::setStreaming
+  void setStreaming(long window);
   void apply(Ctxt& ctxt) const;
+  // Applies the map to all of v, one stage at a time for the whole batch,
+  // see MatMulExecBase::mulMany
+  void applyMany(std::vector<Ctxt>& v) const;
+  // Whether the constants were read from the on-disk cache, see
+  // setEvalMapCacheDir
+  bool isMapped() const { return mapped; }
 };
 
 //! @class ThinEvalMap
@@ -91,6 +108,11 @@ private:
   bool invert;   // apply transformation in inverse order?
   long nfactors; // how many factors of m
   NTL::Vec<std::unique_ptr<MatMulExecBase>> matvec; // regular matrices
+  bool mapped = false; // constants mapped from the cache file
+
+  bool readCache(const std::string& fileName, const std::string& header);
+  bool writeCache(const std::string& fileName,
+                  const std::string& header) const;
 
 public:
   ThinEvalMap(const EncryptedArray& _ea,
@@ -100,9 +122,31 @@ public:
               bool build_cache);
 
   void upgrade();
+  void setStreaming(long window);
   void apply(Ctxt& ctxt) const;
+  void applyMany(std::vector<Ctxt>& v) const;
+  bool isMapped() const { return mapped; }
 };
 
+/**
+ * @brief Sets the directory of the on-disk cache of the EvalMap and
+ * ThinEvalMap constants.
+ *
+ * When a cache directory is set, an EvalMap or ThinEvalMap built with
+ * build_cache = true (e.g. by makeBootstrappable) memory-maps its
+ * constants in DoubleCRT form from a file there, keyed by the parameters
+ * of the map and the primes of the context, instead of computing them.
+ * If the file is missing or stale, the constants are computed and written
+ * to it first. The mapping is read-only and shared, so the constants are
+ * stored once per host rather than once per process. The empty string
+ * (the default) disables the cache.
+ * @note Not thread-safe, meant to be called once before building contexts.
+ **/
+void setEvalMapCacheDir(const std::string& dir);
+
+//! @brief The directory set by setEvalMapCacheDir.
+const std::string& getEvalMapCacheDir();
+
 } // namespace helib
 
 #endif // ifndef HELIB_EVALMAP_H
@@ -87,6 +87,28 @@ inline bool setDryRun(bool toWhat = true)
 
 inline bool isDryRun() { return FHEglobals::dryRun; }
 
+//! @brief Sets the dry-run flag for the lifetime of this object, and restores
+//! the previous value on exit. Used to build lazily-constructed tables with
+//! the flag they were created with.
+class DryRunGuard
+{
+  bool saved;
+
+public:
+  explicit DryRunGuard(bool toWhat) : saved(isDryRun())
+  {
+    if (saved != toWhat)
+      setDryRun(toWhat);
+  }
+  ~DryRunGuard()
+  {
+    if (isDryRun() != saved)
+      setDryRun(saved);
+  }
+  DryRunGuard(const DryRunGuard&) = delete;
+  DryRunGuard& operator=(const DryRunGuard&) = delete;
+};
+
 inline void setAutomorphVals(std::set<long>* aVals)
 {
   FHEglobals::automorphVals = aVals;
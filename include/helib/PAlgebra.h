@@ -16,6 +16,7 @@
  * @brief Declarations of the classes PAlgebra
  */
 #include <exception>
+#include <string>
 #include <utility>
 #include <vector>
 #include <complex>
@@ -25,6 +26,7 @@
 #include <helib/hypercube.h>
 #include <helib/PGFFT.h>
 #include <helib/clonedPtr.h>
+#include <helib/lazyPtr.h>
 #include <helib/apiAttributes.h>
 
 namespace helib {
@@ -550,8 +552,28 @@ private:
   std::vector<RX> crtTable;
   std::shared_ptr<TNode<RX>> crtTree;
 
+  // When p^r splits Phi_m(X) into linear factors (ordP == 1), the slots are
+  // the evaluations at the primitive m-th roots of unity omega^e, so encoding
+  // and decoding are DFTs of length m. These are computed with Bluestein's
+  // algorithm, using jk = C(j+k,2)-C(j,2)-C(k,2) so that it also works for
+  // even m. slotExps is empty when this is not applicable.
+  std::vector<long> slotExps; // the root of factors[i] is omega^slotExps[i]
+  vec_R nttTwist;             // omega^{-C(k,2)}, k < m
+  vec_R nttTwistInv;          // omega^{C(k,2)}, k < m
+  RX nttChirp;                // sum_n omega^{C(n,2)} X^n, n < 2m-1
+  RX nttChirpInv;             // sum_n omega^{-C(n,2)} X^n, n < 2m-1
+  R mInv;                     // m^{-1} mod p^r
+
   void genMaskTable();
   void genCrtTable();
+  void genNttTable();
+
+  // The on-disk cache of the factors, crtCoeffs, crtTable and maskTable,
+  // see setPAlgebraModCacheDir. readTableCache assumes the current modulus
+  // is p^r and returns false if there is no valid cache file.
+  std::string tableCacheFile() const;
+  bool readTableCache();
+  void writeTableCache() const;
 
 public:
   PAlgebraModDerived(const PAlgebra& zMStar, long r);
@@ -571,6 +593,12 @@ public:
     maskTable = other.maskTable;
     crtTable = other.crtTable;
     crtTree = other.crtTree;
+    slotExps = other.slotExps;
+    nttTwist = other.nttTwist;
+    nttTwistInv = other.nttTwistInv;
+    nttChirp = other.nttChirp;
+    nttChirpInv = other.nttChirpInv;
+    mInv = other.mInv;
   }
 
   PAlgebraModDerived& operator=(const PAlgebraModDerived& other) // assignment
@@ -593,6 +621,12 @@ public:
     maskTable = other.maskTable;
     crtTable = other.crtTable;
     crtTree = other.crtTree;
+    slotExps = other.slotExps;
+    nttTwist = other.nttTwist;
+    nttTwistInv = other.nttTwistInv;
+    nttChirp = other.nttChirp;
+    nttChirpInv = other.nttChirpInv;
+    mInv = other.mInv;
 
     return *this;
   }
@@ -748,6 +782,9 @@ private:
                 const std::vector<RX>& crt1,
                 long offset,
                 long extent) const;
+
+  //! y[k] = sum_j x[j] omega^{jk} (or omega^{-jk} if inverse), for k < m
+  void slotDFT(vec_R& y, const vec_R& x, bool inverse) const;
 };
 
 //! A different derived class to be used for the approximate-numbers scheme
@@ -789,27 +826,57 @@ public:
 //! Builds a table, of type PA_GF2 if p == 2 and r == 1, and PA_zz_p otherwise
 PAlgebraModBase* buildPAlgebraMod(const PAlgebra& zMStar, long r);
 
+/**
+ * @brief Sets the directory of the on-disk cache of the PAlgebraMod tables.
+ *
+ * Building a PAlgebraMod (e.g. in the Context constructor) factors Phi_m(X)
+ * mod p^r and computes the CRT and mask tables, which for large m and d can
+ * take minutes. When a cache directory is set, these tables are read from
+ * a file there keyed by (m, p, r, gens, ords), and are written to it after
+ * being computed if the file is missing or stale. The empty string (the
+ * default) disables the cache.
+ * @note Not thread-safe, meant to be called once before building contexts.
+ **/
+void setPAlgebraModCacheDir(const std::string& dir);
+
+//! @brief The directory set by setPAlgebraModCacheDir.
+const std::string& getPAlgebraModCacheDir();
+
 // A simple wrapper for a pointer to an object of type PAlgebraModBase.
 //
 // Direct access to the virtual methods of PAlgebraModBase is provided,
 // along with a "downcast" operator to get a reference to the object
 // as a derived type, and == and != operators.
+//
+// The tables (factors of Phi_m(X), CRT and mask tables) are only built the
+// first time they are needed, which is thread-safe. The tag, r and p^r are
+// available without building them, so a context that never touches the
+// plaintext slots never pays for the tables. The tables are shared between
+// copies, which is fine since they are never modified after construction.
 class PAlgebraMod
 {
 
 private:
-  cloned_ptr<PAlgebraModBase> rep;
+  const PAlgebra* zMStar;
+  long r;
+  long pPowR;
+  PA_tag tag;
+  bool disabled;
+  LazyPtr<const PAlgebraModBase> rep;
+
+  const PAlgebraModBase& getRep() const
+  {
+    assertFalse<LogicError>(disabled && !rep.isBuilt(),
+                            "PAlgebraMod tables are disabled (no-slots mode)");
+    return *rep;
+  }
 
 public:
   // copy constructor: default
   // assignment: default
   // destructor: default
-  // NOTE: the use of cloned_ptr ensures that the default copy constructor,
-  // assignment operator, and destructor will work correctly.
 
-  explicit PAlgebraMod(const PAlgebra& zMStar, long r) :
-      rep(buildPAlgebraMod(zMStar, r))
-  {}
+  explicit PAlgebraMod(const PAlgebra& zMStar, long r);
   // constructor
 
   //! Downcast operator
@@ -818,11 +885,11 @@ public:
   template <typename type>
   const PAlgebraModDerived<type>& getDerived(type) const
   {
-    return dynamic_cast<const PAlgebraModDerived<type>&>(*rep);
+    return dynamic_cast<const PAlgebraModDerived<type>&>(getRep());
   }
   const PAlgebraModCx& getCx() const
   {
-    return dynamic_cast<const PAlgebraModCx&>(*rep);
+    return dynamic_cast<const PAlgebraModCx&>(getRep());
   }
 
   bool operator==(const PAlgebraMod& other) const
@@ -837,22 +904,30 @@ public:
   /* direct access to the PAlgebraModBase methods */
 
   //! Returns the type tag: PA_GF2_tag or PA_zz_p_tag
-  PA_tag getTag() const { return rep->getTag(); }
+  PA_tag getTag() const { return tag; }
   //! Returns reference to underlying PAlgebra object
-  const PAlgebra& getZMStar() const { return rep->getZMStar(); }
+  const PAlgebra& getZMStar() const { return *zMStar; }
   //! Returns reference to the factorization of Phi_m(X) mod p^r, but as ZZX's
   const std::vector<NTL::ZZX>& getFactorsOverZZ() const
   {
-    return rep->getFactorsOverZZ();
+    return getRep().getFactorsOverZZ();
   }
   //! The value r
-  long getR() const { return rep->getR(); }
+  long getR() const { return r; }
   //! The value p^r
-  long getPPowR() const { return rep->getPPowR(); }
+  long getPPowR() const { return pPowR; }
   //! Restores the NTL context for p^r
-  void restoreContext() const { rep->restoreContext(); }
+  void restoreContext() const { getRep().restoreContext(); }
+
+  zzX getMask_zzX(long i, long j) const { return getRep().getMask_zzX(i, j); }
+
+  //! @brief Whether the tables were built already
+  bool isBuilt() const { return rep.isBuilt(); }
 
-  zzX getMask_zzX(long i, long j) const { return rep->getMask_zzX(i, j); }
+  //! @brief Forbid building the tables from now on: any later access to them
+  //! throws a LogicError. Tables that were already built stay available.
+  void disable() { disabled = true; }
+  bool isDisabled() const { return disabled; }
 };
 
 //! returns true if the palg parameters match the rest, false otherwise
@@ -44,6 +44,27 @@ public:
    void apply(std::complex<double>* v) const { apply(v, v); }
    // same as apply(v, v)
 
+   void apply_batch(const std::complex<double>* src, std::complex<double>* dst,
+                    long count, long stride) const;
+   // Apply n-point FFT to count vectors, the i-th one being
+   // src[i*stride..i*stride+n-1], and storing its result in
+   // dst[i*stride..i*stride+n-1].
+   // REQUIREMENT: stride >= n
+   // The transforms are done one after the other, as by apply, but the
+   // same scratch space is used for the whole batch, which makes this
+   // faster than count calls to apply, especially for small n. (The
+   // transforms are not interleaved: the SIMD lanes are filled within
+   // each transform.)
+   // src and dst may be equal, but should not otherwise overlap
+
+   void apply_mt(const std::complex<double>* src, std::complex<double>* dst,
+                 long nthreads) const;
+   // Same as apply, but splits the transform between (up to) nthreads
+   // threads of NTL's thread pool, and no more than NTL::AvailableThreads().
+   // This is only done for large power-of-two n (currently n >= 2^14),
+   // and only if HElib is built with HELIB_THREADS; otherwise, or when
+   // called from a task of the pool, this is the same as apply.
+
    // Copy/move constructors/assignment ops deleted, as future implementations
    // may not support them.
    PGFFT(const PGFFT&) = delete;
@@ -51,8 +72,21 @@ public:
    PGFFT& operator=(const PGFFT&) = delete;
    PGFFT& operator=(PGFFT&&) = delete;
 
-   static bool
+   enum simd_path { SIMD_NONE = 0, SIMD_AVX2 = 1, SIMD_AVX512 = 2 };
+
+   static simd_path
    simd_enabled();
+   // The SIMD kernels in use: AVX2 (with FMA), AVX-512F, or none (scalar code).
+   // By default, this is the best path supported by the CPU, as detected at
+   // runtime, so binaries built for a generic x86-64 target still use SIMD.
+   // As SIMD_NONE == 0, this can still be tested as a bool.
+
+   static simd_path
+   set_simd_path(simd_path path);
+   // Restricts the kernels to path, or to the best one supported by the CPU
+   // if that is lower, and returns the path now in use. This is meant for
+   // testing and benchmarking, and should not be called while transforms
+   // are running in other threads.
 
    // Define aligned vectors.
    // This stuff should probably be private, but I'm not sure
@@ -127,6 +161,13 @@ private:
    // additonal data structures needed for 2^k-point FFT
    std::vector<long> rev, rev1;
 
+   // size of the scratch space needed by apply_buf
+   long scratch_size() const;
+
+   // same as apply, using x as scratch space
+   void apply_buf(const std::complex<double>* src, std::complex<double>* dst,
+                  std::complex<double>* x) const;
+
 
 
 
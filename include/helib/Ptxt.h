@@ -22,6 +22,7 @@
 #include <helib/Context.h>
 #include <helib/EncryptedArray.h>
 #include <helib/assertions.h>
+#include <helib/multicore.h>
 #include <helib/PolyMod.h>
 
 /**
@@ -149,6 +150,16 @@ void innerProduct(Ptxt<Scheme>& result,
  * `PolyMod` type can be easily converted via `static_cast` to more convenient
  * types such as `long` and `NTL::ZZX`.
  *
+ * When the plaintext space splits into linear factors (d = 1), every slot is
+ * just an integer mod p^r, and a BGV `Ptxt` keeps its data in a dense
+ * `std::vector<long>` instead, so that the slot-wise arithmetic is done with
+ * single-precision modular kernels rather than one `NTL::ZZX` per slot. This
+ * is transparent: the `PolyMod` form is built when it is asked for (by the
+ * non-const `operator[]`, `at` or `getSlotRepr`), and the next arithmetic
+ * operation switches back to the dense form. As with the `std::vector`
+ * containers, references to slots are invalidated by operations modifying
+ * the `Ptxt`.
+ *
  * In the `CKKS` case, the slot type is `std::complex<double>`, and has
  * sensible operator overloads supporting operations with other `Ptxt<CKKS>`,
  * `Ctxt`, and `std::complex<double>` objects, as well as performing all
@@ -314,6 +325,8 @@ public:
   /**
    * @brief Get the data held in the slots as a `std::vector<SlotType>`.
    * @return Constant reference to the slot vector.
+   * @note For a BGV `Ptxt` with d = 1, the vector is built on the first call
+   * after each modification.
    **/
   const std::vector<SlotType>& getSlotRepr() const;
 
@@ -415,6 +428,11 @@ public:
     assertTrue<RuntimeError>(isValid(),
                              "Cannot call operator*= on "
                              "default-constructed Ptxt");
+    if (compactable()) {
+      SlotType one = convertToSlot(*context, 1L);
+      one *= scalar;
+      return *this *= one;
+    }
     for (std::size_t i = 0; i < this->slots.size(); i++) {
       this->slots[i] *= scalar;
     }
@@ -446,6 +464,11 @@ public:
     assertTrue<RuntimeError>(isValid(),
                              "Cannot call operator+= on "
                              "default-constructed Ptxt");
+    if (compactable()) {
+      SlotType zero = convertToSlot(*context, 0L);
+      zero += scalar;
+      return *this += zero;
+    }
     for (std::size_t i = 0; i < this->slots.size(); i++) {
       this->slots[i] += scalar;
     }
@@ -477,6 +500,11 @@ public:
     assertTrue<RuntimeError>(isValid(),
                              "Cannot call operator-= on "
                              "default-constructed Ptxt");
+    if (compactable()) {
+      SlotType zero = convertToSlot(*context, 0L);
+      zero += scalar;
+      return *this -= zero;
+    }
     for (std::size_t i = 0; i < this->slots.size(); i++) {
       this->slots[i] -= scalar;
     }
@@ -738,10 +766,11 @@ public:
 
     stream_modifier sm(os);
 
+    const std::vector<SlotType>& slots = ptxt.getSlotRepr();
     os << "[";
-    for (std::size_t i = 0; i < ptxt.slots.size(); ++i) {
-      os << ptxt.slots[i];
-      if (i != ptxt.slots.size() - 1) {
+    for (std::size_t i = 0; i < slots.size(); ++i) {
+      os << slots[i];
+      if (i != slots.size() - 1) {
         os << " ";
       }
     }
@@ -763,6 +792,73 @@ private:
   //! `std::complex<double>` (CKKS) or `helib::PolyMod` (BGV).
   std::vector<SlotType> slots;
 
+  //! @brief `true` if the data is held in `compactSlots` rather than in
+  //! `slots` (which is then empty), see `compactable`.
+  bool compact = false;
+
+  //! @brief The slots of a BGV `Ptxt` with d = 1, as integers in [0, p^r).
+  std::vector<long> compactSlots;
+
+  //! @brief The `PolyMod` form of `compactSlots`, built on demand by
+  //! `getSlotRepr`. Copies of it start out empty.
+  struct SlotsView
+  {
+    std::vector<SlotType> slots;
+    bool valid = false;
+    HELIB_MUTEX_TYPE mtx; // guards slots and valid
+
+    SlotsView() = default;
+    SlotsView(const SlotsView&) noexcept {}
+    SlotsView& operator=(const SlotsView&) noexcept
+    {
+      clear();
+      return *this;
+    }
+    void clear() noexcept
+    {
+      slots.clear();
+      valid = false;
+    }
+  };
+  mutable SlotsView view;
+
+  /**
+   * @brief Whether the slots of `this` can be kept in `compactSlots`, i.e.
+   * the scheme is BGV, d = 1 and p^r is a single-precision modulus.
+   **/
+  bool compactable() const;
+
+  /**
+   * @brief Moves the data into `compactSlots` if `compactable()`, does
+   * nothing otherwise.
+   **/
+  void makeCompact();
+
+  /**
+   * @brief Moves the data into `slots`.
+   **/
+  void expand();
+
+  /**
+   * @brief The slots of a `compactable()` `Ptxt` as integers in [0, p^r).
+   * @param tmp Storage for the result if `this` is not in compact form.
+   * @return Either `compactSlots` or `tmp`.
+   **/
+  const std::vector<long>& compactData(std::vector<long>& tmp) const;
+
+  /**
+   * @brief Sets the data of a `compactable()` `Ptxt`.
+   * @param data The slots, as integers in [0, p^r).
+   **/
+  void setCompactData(std::vector<long>&& data);
+
+  /**
+   * @brief Replaces slot `i` with the old slot `src[i]`, or with `0` if
+   * `src[i]` is negative.
+   * @param src Source index of each slot.
+   **/
+  void permute(const std::vector<long>& src);
+
   /**
    * @brief Helper function to convert between different indexing formats.
    * @param coords Vector of coordinates.
@@ -0,0 +1,141 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_ZEROENCRYPTIONPOOL_H
+#define HELIB_ZEROENCRYPTIONPOOL_H
+/**
+ * @file ZeroEncryptionPool.h
+ * @brief Pre-computed encryptions of zero for offline/online encryption.
+ **/
+
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <vector>
+
+#include <helib/Ctxt.h>
+#include <helib/IndexSet.h>
+#include <helib/multicore.h>
+
+#ifdef HELIB_THREADS
+#include <condition_variable>
+#include <thread>
+#endif
+
+namespace helib {
+
+class PubKey;
+
+/**
+ * @class ZeroEncryptionPool
+ * @brief A bounded queue of fresh BGV public-key encryptions of zero.
+ *
+ * Most of the cost of PubKey::Encrypt (sampling r, e0, e1, the FFTs and the
+ * products with the public key) does not depend on the plaintext. A
+ * ZeroEncryptionPool does this work ahead of time in background threads.
+ * Once attached to its key with PubKey::setZeroEncryptionPool, Encrypt pops
+ * one encryption of zero and adds the encoded plaintext to it, so that the
+ * online phase is the encoding of the plaintext and a single addition.
+ * Encrypt then skips the check of the plaintext size against the noise
+ * bound (a canonical embedding), unless fhe_stats is set. If the queue is
+ * empty, Encrypt falls back to computing the encryption of zero itself,
+ * and the pool records a starvation event.
+ *
+ * The encryptions are made relative to the ctxtPrimes and then, if a target
+ * prime set is given, mod-switched down to it.
+ *
+ * Without thread support (HELIB_THREADS undefined) no background threads are
+ * started, and the queue is only filled by explicit calls to refill().
+ *
+ * A background thread that fails to compute an encryption of zero stops.
+ * The failure is counted in the metrics, and the error is rethrown by the
+ * next call to refill().
+ **/
+class ZeroEncryptionPool
+{
+public:
+  //! @brief A snapshot of the pool's counters
+  struct Metrics
+  {
+    long produced;     // encryptions of zero computed by the pool
+    long consumed;     // encryptions of zero taken from the queue
+    long starved;      // calls to pop() that found the queue empty
+    long failed;       // background threads stopped by an error
+    long queued;       // current number of encryptions in the queue
+    double refillRate; // encryptions produced per second since construction
+  };
+
+  /**
+   * @brief Constructor, starts the background threads.
+   * @param pubKey The key to encrypt with; it must outlive the pool.
+   * @param depth Maximum number of encryptions kept in the queue.
+   * @param numThreads Number of background threads refilling the queue.
+   * @param primeSet Target prime set of the encryptions, the default (empty
+   * set) means all the ctxtPrimes.
+   **/
+  ZeroEncryptionPool(const PubKey& pubKey,
+                     long depth,
+                     long numThreads = 1,
+                     const IndexSet& primeSet = IndexSet::emptySet());
+
+  //! Stops the background threads, waiting for those in mid-computation.
+  ~ZeroEncryptionPool();
+
+  ZeroEncryptionPool(const ZeroEncryptionPool&) = delete;
+  ZeroEncryptionPool& operator=(const ZeroEncryptionPool&) = delete;
+
+  //! @brief Moves the oldest encryption of zero into ctxt.
+  //! Returns false (and counts a starvation) if the queue is empty.
+  bool pop(Ctxt& ctxt);
+
+  //! @brief Fills the queue up to its depth in the calling thread.
+  //! First rethrows the error that stopped a background thread, if any.
+  void refill();
+
+  const PubKey& getPubKey() const { return pubKey; }
+  long getDepth() const { return depth; }
+  long getPtxtSpace() const { return ptxtSpace; }
+  const IndexSet& getPrimeSet() const { return primeSet; }
+
+  Metrics getMetrics() const;
+
+private:
+  const PubKey& pubKey;
+  const long depth;
+  const long ptxtSpace;
+  const IndexSet primeSet;
+  const std::chrono::steady_clock::time_point startTime;
+
+  std::deque<Ctxt> queue;
+  long pending;  // encryptions being computed, counted against depth
+  long produced;
+  long consumed;
+  long starved;
+  long failed;
+  std::exception_ptr error; // of the last failed background thread
+  bool stopping;
+
+  mutable HELIB_MUTEX_TYPE mtx; // guards everything above
+
+#ifdef HELIB_THREADS
+  std::condition_variable notFull;
+  std::vector<std::thread> workers;
+
+  void worker();
+#endif
+
+  // Computes a single encryption of zero, without holding the lock
+  void makeZero(Ctxt& ctxt) const;
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_ZEROENCRYPTIONPOOL_H
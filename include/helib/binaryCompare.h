@@ -64,5 +64,37 @@ void compareTwoNumbers(Ctxt& mu,
                        bool twosComplement = false,
                        std::vector<zzX>* unpackSlotEncoding = nullptr);
 
+/**
+ * @brief Replaces the integer in binary `num` by the maximum of its values
+ * across all the slots, in every slot.
+ * @param ea The `EncryptedArray` that defines the slot structure.
+ * @param num The bits of the integer, least significant first.
+ * @param twosComplement When set to `true`, the input is a signed integer in
+ *2's complement. If set to `false` (default), unsigned comparison is performed.
+ * @param unpackSlotEncoding Vector of constants for unpacking, as used in
+ *bootstrapping.
+ * @note Uses O(log nslots) rotations and comparisons, see `allSlotsReduce`.
+ **/
+void totalMax(const EncryptedArray& ea,
+              CtPtrs& num,
+              bool twosComplement = false,
+              std::vector<zzX>* unpackSlotEncoding = nullptr);
+
+/**
+ * @brief Replaces the integer in binary `num` by the minimum of its values
+ * across all the slots, in every slot.
+ * @param ea The `EncryptedArray` that defines the slot structure.
+ * @param num The bits of the integer, least significant first.
+ * @param twosComplement When set to `true`, the input is a signed integer in
+ *2's complement. If set to `false` (default), unsigned comparison is performed.
+ * @param unpackSlotEncoding Vector of constants for unpacking, as used in
+ *bootstrapping.
+ * @note Uses O(log nslots) rotations and comparisons, see `allSlotsReduce`.
+ **/
+void totalMin(const EncryptedArray& ea,
+              CtPtrs& num,
+              bool twosComplement = false,
+              std::vector<zzX>* unpackSlotEncoding = nullptr);
+
 } // namespace helib
 #endif // ifndef HELIB_BINARYCOMPARE_H
@@ -28,6 +28,8 @@
 #define BINIO_EYE_CONTEXTBASE_END   "]BS|"
 #define BINIO_EYE_CONTEXT_BEGIN     "|CN["
 #define BINIO_EYE_CONTEXT_END       "]CN|"
+#define BINIO_EYE_CONTEXT_TABLES_BEGIN "|CT["
+#define BINIO_EYE_CONTEXT_TABLES_END   "]CT|"
 #define BINIO_EYE_CTXT_BEGIN        "|CX["
 #define BINIO_EYE_CTXT_END          "]CX|"
 #define BINIO_EYE_PK_BEGIN          "|PK["
@@ -36,6 +38,12 @@
 #define BINIO_EYE_SK_END            "]SK|"
 #define BINIO_EYE_SKM_BEGIN         "|KM["
 #define BINIO_EYE_SKM_END           "]KM|"
+#define BINIO_EYE_SEEDCTXT_BEGIN    "|SC["
+#define BINIO_EYE_SEEDCTXT_END      "]SC|"
+#define BINIO_EYE_PALGEBRAMOD_BEGIN "|PM["
+#define BINIO_EYE_PALGEBRAMOD_END   "]PM|"
+#define BINIO_EYE_MAPPEDEXECS_BEGIN "|MX["
+#define BINIO_EYE_MAPPEDEXECS_END   "]MX|"
 // clang-format on
 
 namespace helib {
@@ -15,6 +15,7 @@
 
 #include <vector>
 #include <iostream>
+#include <helib/multicore.h>
 
 namespace helib {
 
@@ -57,6 +58,27 @@ const std::vector<double>* fetch_saved_values(const char*);
 
 extern bool fhe_stats;
 
+// Running totals of some expensive operations, over all threads. The
+// bootstrapping profile (see BootstrapProfile) reports their differences.
+// They are only counted while some bootstrap is being profiled, so that
+// the other operations do not all write to the same shared counters.
+struct OpCounters
+{
+  HELIB_atomic_long keySwitches{0};
+  HELIB_atomic_long automorphisms{0};
+  HELIB_atomic_long ntts{0}; // forward and inverse
+
+  HELIB_atomic_long profiling{0}; // number of bootstraps being profiled
+};
+
+extern OpCounters opCounters;
+
+#define HELIB_COUNT_OP(op)                                                     \
+  do {                                                                         \
+    if (::helib::opCounters.profiling > 0)                                     \
+      ++::helib::opCounters.op;                                                \
+  } while (0)
+
 } // namespace helib
 
 #endif
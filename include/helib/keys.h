@@ -20,10 +20,13 @@
  * Copyright IBM Corporation 2019 All rights reserved.
  */
 
+#include <memory>
 #include <helib/keySwitching.h>
 
 namespace helib {
 
+class ZeroEncryptionPool;
+
 #define HELIB_KSS_UNKNOWN (0)
 // unknown KS strategy
 
@@ -71,6 +74,69 @@ private:
   long recryptKeyID; // index of the bootstrapping key
   Ctxt recryptEkey;  // the key itself, encrypted under key #0
 
+  // Optional source of pre-computed encryptions of zero, used by Encrypt.
+  // This is not copied with the key, nor serialized.
+  std::shared_ptr<ZeroEncryptionPool> zeroPool;
+
+  // When multiplications bootstrap their operands (off by default).
+  // This is copied with the key, but not serialized.
+  AutoBootstrapPolicy autoBootstrap;
+
+  // The noise parameter and the scratch space of encryptZero and
+  // CKKSencrypt. EncryptMany sets up one per thread, and reuses it for all
+  // the ciphertexts of that thread.
+  struct EncryptionNoise
+  {
+    explicit EncryptionNoise(const Context& context);
+
+    double stdev; // of the Gaussian error, scaled up if m is not a power of 2
+    DoubleCRT r;  // the random small scalar
+    DoubleCRT e;  // the error of one part
+  };
+
+  // Sets ctxt to a fresh random encryption of zero (the part of Encrypt
+  // that does not depend on the plaintext)
+  void encryptZero(Ctxt& ctxt, long ptxtSpace, bool highNoise) const;
+  void encryptZero(Ctxt& ctxt,
+                   long ptxtSpace,
+                   bool highNoise,
+                   EncryptionNoise& noise) const;
+
+  // Moves an encryption of zero from the attached pool into ctxt, if the
+  // pool has one for this key and plaintext space
+  bool popZero(Ctxt& ctxt, long ptxtSpace) const;
+
+  // Adds ptxt to ctxt, an encryption of zero mod ptxtSpace. The size of
+  // ptxt is checked against the noise bound only if checkSize is true,
+  // since that takes an FFT.
+  void addPlaintext(Ctxt& ctxt,
+                    const NTL::ZZX& ptxt,
+                    long ptxtSpace,
+                    bool checkSize) const;
+
+  void CKKSencrypt(Ctxt& ciphertxt,
+                   const NTL::ZZX& plaintxt,
+                   double ptxtSize,
+                   double scaling,
+                   EncryptionNoise& noise) const;
+
+  // One encryption of EncryptMany, with a plaintext space already checked
+  void encryptWith(Ctxt& ciphertxt,
+                   const Ptxt<BGV>& plaintxt,
+                   long ptxtSpace,
+                   EncryptionNoise& noise) const;
+  void encryptWith(Ctxt& ciphertxt,
+                   const Ptxt<CKKS>& plaintxt,
+                   long ptxtSpace,
+                   EncryptionNoise& noise) const;
+
+  // Handles the empty and dummy ciphertexts, which need no bootstrapping.
+  // Returns true if ctxt was one of those.
+  bool reCryptTrivial(Ctxt& ctxt) const;
+
+  // The key-switching and mod-switching part of reCrypt and thinReCrypt
+  void bootKeySwitch(Ctxt& ctxt) const;
+
 public:
   //! This constructor thorws run-time error if activeContext=nullptr
   PubKey();
@@ -142,6 +208,12 @@ public:
   //! dim == -1 is Frobenius
   void setKSStrategy(long dim, int val);
 
+  //! @brief Attach a pool of pre-computed encryptions of zero, which BGV
+  //! Encrypt then uses for its plaintext-independent part. Pass nullptr to
+  //! detach. The pool must have been built for this key.
+  void setZeroEncryptionPool(std::shared_ptr<ZeroEncryptionPool> pool);
+  const std::shared_ptr<ZeroEncryptionPool>& getZeroEncryptionPool() const;
+
   /**
    * Encrypts plaintext, result returned in the ciphertext argument. When
    * called with highNoise=true, returns a ciphertext with noise level
@@ -192,15 +264,92 @@ public:
                const Ptxt<Scheme>& plaintxt,
                long ptxtSpace = 0) const;
 
+  /**
+   * @brief Encrypts a batch of plaintexts into a batch of ciphertexts.
+   * @tparam Scheme Encryption scheme used (must be `BGV` or `CKKS`).
+   * @param ciphertxts Vector of ciphertexts, resized to `plaintxts.size()`.
+   * @param plaintxts Plaintexts to encrypt.
+   * @return Plaintext space.
+   * @note The plaintext space is checked once for the whole batch. The
+   * plaintexts are then split into contiguous blocks, one per NTL thread.
+   * Each thread sets up the noise sampling once, with the DoubleCRTs that
+   * hold the randomness, and reuses it for all its ciphertexts. It encodes
+   * its plaintexts one at a time and samples its randomness from its own
+   * NTL random stream, so the encodings are never all held in memory at
+   * once. An attached ZeroEncryptionPool is used as by Encrypt.
+   **/
+  template <typename Scheme>
+  long EncryptMany(std::vector<Ctxt>& ciphertxts,
+                   const std::vector<Ptxt<Scheme>>& plaintxts,
+                   long ptxtSpace = 0) const;
+
   bool isCKKS() const;
   // NOTE: Is taking the alMod from the context the right thing to do?
 
   bool isBootstrappable() const;
-  void reCrypt(Ctxt& ctxt) const;     // bootstrap a ciphertext to reduce noise
-  void thinReCrypt(Ctxt& ctxt) const; // bootstrap a "thin" ciphertext, where
-  // slots are assumed to contain constants
+  // bootstrap a ciphertext to reduce noise, and optionally return the
+  // profile of the bootstrap
+  void reCrypt(Ctxt& ctxt, BootstrapProfile* profile = nullptr) const;
+  // bootstrap a "thin" ciphertext, where slots are assumed to contain
+  // constants
+  void thinReCrypt(Ctxt& ctxt, BootstrapProfile* profile = nullptr) const;
+
+  /**
+   * @brief Bootstraps all the ciphertexts of `ctxts`, as by reCrypt.
+   * @param ctxts The ciphertexts to bootstrap.
+   * @param profile If not null, receives the profile of the whole batch.
+   * @note The ciphertexts go through each stage of bootstrapping together.
+   * The linear maps are applied with MatMulExecBase::mulMany, which
+   * applies each group of constants to the whole batch before loading the
+   * next one. The other stages process the ciphertexts in parallel rather
+   * than the work within each of them. This pays off for batches of at
+   * least as many ciphertexts as there are threads.
+   **/
+  void reCryptMany(std::vector<Ctxt>& ctxts,
+                   BootstrapProfile* profile = nullptr) const;
+
+  /**
+   * @brief Bootstraps all the ciphertexts of `ctxts`, as by thinReCrypt.
+   * @param ctxts The ciphertexts to bootstrap.
+   * @param profile As for reCryptMany.
+   * @note See reCryptMany.
+   **/
+  void thinReCryptMany(std::vector<Ctxt>& ctxts,
+                       BootstrapProfile* profile = nullptr) const;
+
+  /**
+   * @brief Sets when Ctxt::multiplyBy and Ctxt::multiplyBy2 (and so square,
+   * cube, power and polyEval) bootstrap their operands.
+   * @param policy The policy, a default one turns it off.
+   * @note Before each multiplication, the operands whose bitCapacity is
+   * below policy.minCapacity are bootstrapped, all of them together (see
+   * autoReCrypt). minCapacity should cover what a multiplication consumes
+   * and what its result must keep, and must be below the capacity that
+   * bootstrapping leaves. Only BGV ciphertexts whose plaintext space
+   * divides p^r are bootstrapped, and never those of a bootstrap in
+   * progress. Not thread-safe, meant to be called before the key is used.
+   * @note The operands of multiplyBy and multiplyBy2 other than *this are
+   * const, so a copy of them is bootstrapped. DynamicCtxtPowers (and so
+   * power and polyEval) bootstraps the powers it keeps in place, once.
+   * Other callers that multiply by the same ciphertext several times
+   * should bootstrap it first with autoReCrypt.
+   **/
+  void setAutoBootstrap(const AutoBootstrapPolicy& policy);
+  const AutoBootstrapPolicy& getAutoBootstrap() const;
+
+  //! @brief Does the auto-bootstrap policy call for bootstrapping ctxt now?
+  bool needsAutoReCrypt(const Ctxt& ctxt) const;
+
+  /**
+   * @brief Bootstraps the ciphertexts of `ctxts` that the auto-bootstrap
+   * policy calls for, as one batch of reCryptMany or thinReCryptMany.
+   * @param ctxts The candidates, repeated pointers are bootstrapped once.
+   * @return The number of ciphertexts bootstrapped.
+   **/
+  long autoReCrypt(const std::vector<Ctxt*>& ctxts) const;
 
   friend class SecKey;
+  friend class ZeroEncryptionPool;
   friend std::ostream& operator<<(std::ostream& str, const PubKey& pk);
   friend std::istream& operator>>(std::istream& str, PubKey& pk);
   friend void ::helib::writePubKeyBinary(std::ostream& str, const PubKey& pk);
@@ -285,12 +434,53 @@ public:
   //! before reduction modulo the ptxtSpace
   void Decrypt(NTL::ZZX& plaintxt, const Ctxt& ciphertxt, NTL::ZZX& f) const;
 
+  /**
+   * @brief Fast decryption of a BGV ciphertext.
+   * @param plaintxt Plaintext into which to decrypt.
+   * @param ciphertxt Ciphertext to decrypt.
+   * @note The decrypted polynomial is computed modulo only as few of the
+   * primes as are needed to hold its coefficients (according to the noise
+   * bound of the ciphertext), and is then reconstructed modulo the
+   * plaintext space using single-precision CRT. The result is the same as
+   * that of Decrypt. For CKKS, or when the noise is too large to save any
+   * primes, this just calls Decrypt.
+   **/
+  void fastDecrypt(NTL::ZZX& plaintxt, const Ctxt& ciphertxt) const;
+  template <typename Scheme>
+  void fastDecrypt(Ptxt<Scheme>& plaintxt, const Ctxt& ciphertxt) const;
+
+  /**
+   * @brief Decrypts a batch of ciphertexts in parallel, using fastDecrypt.
+   * @tparam Scheme Encryption scheme used (must be `BGV` or `CKKS`).
+   * @param plaintxts Vector of plaintexts, resized to `ciphertxts.size()`.
+   * @param ciphertxts Ciphertexts to decrypt.
+   **/
+  template <typename Scheme>
+  void DecryptMany(std::vector<Ptxt<Scheme>>& plaintxts,
+                   const std::vector<Ctxt>& ciphertxts) const;
+
   //! @brief Symmetric encryption using the secret key.
+  //! If prgSeed is not null, the random part of ctxt is generated from it.
   long skEncrypt(Ctxt& ctxt,
                  const NTL::ZZX& ptxt,
                  long ptxtSpace,
-                 long skIdx) const;
-  long skEncrypt(Ctxt& ctxt, const zzX& ptxt, long ptxtSpace, long skIdx) const;
+                 long skIdx,
+                 const NTL::ZZ* prgSeed = nullptr) const;
+  long skEncrypt(Ctxt& ctxt,
+                 const zzX& ptxt,
+                 long ptxtSpace,
+                 long skIdx,
+                 const NTL::ZZ* prgSeed = nullptr) const;
+
+  //! @brief Symmetric encryption into the compact seeded form.
+  long skEncrypt(SeededCtxt& ctxt,
+                 const NTL::ZZX& ptxt,
+                 long ptxtSpace = 0,
+                 long skIdx = 0) const;
+  long skEncrypt(SeededCtxt& ctxt,
+                 const zzX& ptxt,
+                 long ptxtSpace = 0,
+                 long skIdx = 0) const;
 
   // These methods override the public-key Encrypt methods
   long Encrypt(Ctxt& ciphertxt,
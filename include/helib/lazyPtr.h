@@ -0,0 +1,115 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_LAZYPTR_H
+#define HELIB_LAZYPTR_H
+/**
+ * @file lazyPtr.h
+ * @brief A shared pointer whose object is built on first access
+ **/
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include <helib/multicore.h>
+
+namespace helib {
+
+/**
+ * @class LazyPtr
+ * @brief A shared_ptr<T> whose object is built by a given function the first
+ * time it is dereferenced.
+ * @tparam T The class to which this points
+ *
+ * The object is built at most once, even when several threads access it at
+ * the same time. If the build function throws, the exception is passed on to
+ * the caller and the next access tries again.
+ *
+ * A LazyPtr converts implicitly to const std::shared_ptr<T>&, so it can be
+ * used (mostly) wherever a shared_ptr was used before. A copy shares the
+ * object if it is already built, and otherwise the build function.
+ **/
+template <typename T>
+class LazyPtr
+{
+public:
+  typedef std::function<std::shared_ptr<T>()> Builder;
+
+  LazyPtr() : built(false) {}
+
+  //! @brief The object will be built by builder on first access
+  explicit LazyPtr(Builder _builder) : builder(std::move(_builder)), built(false)
+  {}
+
+  //! @brief An already built object
+  LazyPtr(std::shared_ptr<T> _ptr) : ptr(std::move(_ptr)), built(true) {}
+
+  LazyPtr(const LazyPtr& other) : builder(other.builder)
+  {
+    ptr = other.peek();
+    built = (ptr != nullptr);
+  }
+
+  LazyPtr& operator=(const LazyPtr& other)
+  {
+    if (this == &other)
+      return *this;
+    std::shared_ptr<T> p = other.peek();
+    HELIB_MUTEX_GUARD(mtx);
+    builder = other.builder;
+    ptr = std::move(p);
+    built = (ptr != nullptr);
+    return *this;
+  }
+
+  //! @brief Returns the object, building it if needed
+  const std::shared_ptr<T>& shared() const
+  {
+    if (!built.load(std::memory_order_acquire)) {
+      HELIB_MUTEX_GUARD(mtx);
+      if (!built.load(std::memory_order_relaxed)) {
+        if (builder)
+          ptr = builder();
+        built.store(true, std::memory_order_release);
+      }
+    }
+    return ptr;
+  }
+
+  operator const std::shared_ptr<T>&() const { return shared(); }
+
+  T* get() const { return shared().get(); }
+  T& operator*() const { return *shared(); }
+  T* operator->() const { return shared().get(); }
+  explicit operator bool() const { return shared() != nullptr; }
+
+  //! @brief Whether the object was already built, does not build it
+  bool isBuilt() const { return built.load(std::memory_order_acquire); }
+
+private:
+  Builder builder;
+  mutable std::shared_ptr<T> ptr;
+  mutable std::atomic<bool> built;
+  mutable HELIB_MUTEX_TYPE mtx; // guards the build
+
+  // The object if it is already built, or null
+  std::shared_ptr<T> peek() const
+  {
+    HELIB_MUTEX_GUARD(mtx);
+    return built ? ptr : std::shared_ptr<T>();
+  }
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_LAZYPTR_H
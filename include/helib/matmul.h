@@ -12,10 +12,37 @@
 #ifndef HELIB_MATMUL_H
 #define HELIB_MATMUL_H
 
+#include <string>
 #include <helib/EncryptedArray.h>
 
 namespace helib {
 
+/**
+ * @class BasicAutomorphPrecon
+ * @brief Pre-computation to speed many automorphism on the same ciphertext.
+ *
+ * The expensive part of homomorphic automorphism is breaking the ciphertext
+ * parts into digits. The usual setting is we first rotate the ciphertext
+ * parts, then break them into digits. But when we apply many automorphisms
+ * it is faster to break the original ciphertext into digits, then rotate
+ * the digits (as opposed to first rotate, then break).
+ * An BasicAutomorphPrecon object breaks the original ciphertext and keeps
+ * the digits, then when you call automorph is only needs to apply the
+ * native automorphism and key switching to the digits, which is fast(er).
+ **/
+class BasicAutomorphPrecon
+{
+  Ctxt ctxt;
+  NTL::xdouble noise;
+  std::vector<DoubleCRT> polyDigits;
+
+public:
+  explicit BasicAutomorphPrecon(const Ctxt& _ctxt);
+
+  //! Returns the image of the original ciphertext under X -> X^k.
+  std::shared_ptr<Ctxt> automorph(long k) const;
+};
+
 class MatMulFullExec;
 
 // Abstract base class for representing a linear transformation on a full
@@ -198,12 +225,30 @@ public:
   // Upgrade zzX constants to DoubleCRT constants.
   virtual void upgrade() = 0;
 
+  // A bounded-memory alternative to upgrade(): the constants stay in zzX
+  // form, and mul() converts those of the next giant steps to DoubleCRT
+  // in a background thread while the current one is computed. At most
+  // window giant steps of converted constants are kept at any time.
+  // A window of 0 (the default) converts each constant when it is used.
+  virtual void setStreaming(long window) = 0;
+
   // If ctxt encrypts a row std::vector v, then this replaces ctxt
   // by an encryption of the row std::vector v*mat, where mat is
   // a matrix provided to the constructor of one of the
   // concrete subclasses MatMul1DExec, BlockMatMul1DExec,
   // MatMulFullExec, BlockMatMulFullExec, defined below.
   virtual void mul(Ctxt& ctxt) const = 0;
+
+  // Applies mul to every ciphertext of v. The ciphertexts are processed
+  // in parallel, rather than the work within each of them.
+  virtual void mulMany(std::vector<Ctxt>& v) const;
+
+  // Writes this object to a file, with its constants in DoubleCRT form if
+  // dcrt is set and in zzX form otherwise. It is read back by the static
+  // read method of its class, see writeMappedExecs.
+  bool write(const std::string& fileName,
+             const std::string& header = "",
+             bool dcrt = true) const;
 };
 
 //====================================
@@ -224,6 +269,8 @@ public:
   ConstMultiplierCache cache;
   ConstMultiplierCache cache1; // only for non-native dimension
 
+  long streamWindow = 0; // see setStreaming
+
   // The constructor encodes all the constants for a given
   // matrix in zzX format.
   // The mat argument defines the entries of the matrix.
@@ -239,6 +286,14 @@ public:
   // Replaces an encryption of row std::vector v by encryption of v*mat
   void mul(Ctxt& ctxt) const override;
 
+  // Each group of constants (a giant step with BSGS) is applied to all
+  // the ciphertexts before moving on to the next, while it is hot in the
+  // cache. The rotations of each ciphertext are hoisted, and the work is
+  // spread over the ciphertexts, which must all have the same key.
+  // Constants in zzX form are converted to DoubleCRT once for the whole
+  // batch, a group ahead of their use.
+  void mulMany(std::vector<Ctxt>& v) const override;
+
   // Upgrades encoded constants from zzX to DoubleCRT.
   void upgrade() override
   {
@@ -246,7 +301,25 @@ public:
     cache1.upgrade(ea.getContext());
   }
 
+  // Only affects the baby-step/giant-step multiplication (g != 0)
+  void setStreaming(long window) override { streamWindow = window; }
+
+  // Reads an object written by write, or returns null if the file is
+  // missing or was not written for ea and header
+  static std::unique_ptr<MatMul1DExec> read(const std::string& fileName,
+                                            const EncryptedArray& ea,
+                                            const std::string& header = "");
+
   const EncryptedArray& getEA() const override { return ea; }
+
+private:
+  // An object without constants, filled in by MappedExecReader
+  explicit MatMul1DExec(const EncryptedArray& _ea) : ea(_ea) {}
+
+  // The baby-step/giant-step multiplication in streaming mode
+  void mulStreaming(Ctxt& ctxt) const;
+
+  friend class MappedExecReader;
 };
 
 //====================================
@@ -267,6 +340,8 @@ public:
   ConstMultiplierCache cache;
   ConstMultiplierCache cache1; // only for non-native dimension
 
+  long streamWindow = 0; // see setStreaming
+
   // The constructor encodes all the constants for a given
   // matrix in zzX format.
   // The mat argument defines the entries of the matrix.
@@ -282,6 +357,10 @@ public:
   // Replaces an encryption of row std::vector v by encryption of v*mat
   void mul(Ctxt& ctxt) const override;
 
+  // As for MatMul1DExec, a group being the constants of a rotation of
+  // the first phase of mul
+  void mulMany(std::vector<Ctxt>& v) const override;
+
   // Upgrades encoded constants from zzX to DoubleCRT.
   void upgrade() override
   {
@@ -289,7 +368,23 @@ public:
     cache1.upgrade(ea.getContext());
   }
 
+  // Each rotation of the first phase of mul is a giant step
+  void setStreaming(long window) override { streamWindow = window; }
+
+  // Reads an object written by write, or returns null if the file is
+  // missing or was not written for ea and header
+  static std::unique_ptr<BlockMatMul1DExec> read(
+      const std::string& fileName,
+      const EncryptedArray& ea,
+      const std::string& header = "");
+
   const EncryptedArray& getEA() const override { return ea; }
+
+private:
+  // An object without constants, filled in by MappedExecReader
+  explicit BlockMatMul1DExec(const EncryptedArray& _ea) : ea(_ea) {}
+
+  friend class MappedExecReader;
 };
 
 //====================================
@@ -319,6 +414,10 @@ public:
   // Replaces an encryption of row std::vector v by encryption of v*mat
   void mul(Ctxt& ctxt) const override;
 
+  // The 1D transforms are applied to the whole batch with their mulMany,
+  // and the rotations between them are done in parallel over the batch
+  void mulMany(std::vector<Ctxt>& v) const override;
+
   // Upgrades encoded constants from zzX to DoubleCRT.
   void upgrade() override
   {
@@ -326,10 +425,33 @@ public:
       t.upgrade();
   }
 
+  void setStreaming(long window) override
+  {
+    for (auto& t : transforms)
+      t.setStreaming(window);
+  }
+
   const EncryptedArray& getEA() const override { return ea; }
 
+  // As for MatMul1DExec
+  static std::unique_ptr<MatMulFullExec> read(
+      const std::string& fileName,
+      const EncryptedArray& ea,
+      const std::string& header = "");
+
   // This really should be private.
   long rec_mul(Ctxt& acc, const Ctxt& ctxt, long dim, long idx) const;
+
+private:
+  // An object without transforms, filled in by MappedExecReader
+  explicit MatMulFullExec(const EncryptedArray& _ea) : ea(_ea) {}
+
+  long rec_mulMany(std::vector<Ctxt>& acc,
+                   const std::vector<Ctxt>& v,
+                   long dim,
+                   long idx) const;
+
+  friend class MappedExecReader;
 };
 
 //====================================
@@ -367,14 +489,64 @@ public:
       t.upgrade();
   }
 
+  void setStreaming(long window) override
+  {
+    for (auto& t : transforms)
+      t.setStreaming(window);
+  }
+
   const EncryptedArray& getEA() const override { return ea; }
 
+  // As for MatMul1DExec
+  static std::unique_ptr<BlockMatMulFullExec> read(
+      const std::string& fileName,
+      const EncryptedArray& ea,
+      const std::string& header = "");
+
   // This really should be private.
   long rec_mul(Ctxt& acc, const Ctxt& ctxt, long dim, long idx) const;
+
+private:
+  // An object without transforms, filled in by MappedExecReader
+  explicit BlockMatMulFullExec(const EncryptedArray& _ea) : ea(_ea) {}
+
+  friend class MappedExecReader;
 };
 
 //===================================
 
+// Memory-mapped exec objects.
+//
+// writeMappedExecs writes a list of exec objects of the four classes above
+// (null entries are allowed) to a file. By default all their constants are
+// in DoubleCRT form over all the primes of the context, and every row of
+// every constant is 64-byte aligned in the file, so that readMappedExecs
+// can map it read-only and multiply by the rows in place: the constants
+// then take no private memory, and a single copy in the page cache is
+// shared by all the processes that map the same file. With dcrt false the
+// constants are written in the much smaller zzX form instead, which does
+// not depend on the primes; readMappedExecs copies them into memory.
+//
+// The file records the parameters and the slot structure of the
+// EncryptedArray (and the primes, in DoubleCRT form), and starts with the
+// caller's header (typically a description of the matrices). Reading
+// returns an empty vector if the file is missing, or if its header,
+// parameters or structure do not match. The file is written under a
+// temporary name and renamed, so that it can be shared between concurrent
+// processes. writeMappedExecs returns false if the file could not be
+// written.
+bool writeMappedExecs(const std::string& fileName,
+                      const std::string& header,
+                      const std::vector<const MatMulExecBase*>& execs,
+                      bool dcrt = true);
+
+std::vector<std::unique_ptr<MatMulExecBase>> readMappedExecs(
+    const std::string& fileName,
+    const std::string& header,
+    const EncryptedArray& ea);
+
+//===================================
+
 // ctxt = \sum_{i=0}^{d-1} \sigma^i(ctxt),
 //   where d = order of p mod m, and \sigma is the Frobenius map
 
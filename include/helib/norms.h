@@ -123,6 +123,19 @@ void CKKS_embedInSlots(zzX& f,
                        const PAlgebra& palg,
                        double scaling);
 
+//! Batched versions of the above, the vectors are processed in parallel.
+//! Sets v[i] to the canonical embedding of f[i].
+void CKKS_canonicalEmbedding(std::vector<std::vector<cx_double>>& v,
+                             const std::vector<zzX>& f,
+                             const PAlgebra& palg);
+
+//! Sets f[i] to the inverse canonical embedding of v[i], scaled by
+//! scaling[i] and rounded.
+void CKKS_embedInSlots(std::vector<zzX>& f,
+                       const std::vector<std::vector<cx_double>>& v,
+                       const PAlgebra& palg,
+                       const std::vector<double>& scaling);
+
 } // namespace helib
 
 #endif // ifndef HELIB_NORMS_H
@@ -160,6 +160,10 @@ public:
 
   void ZZXtoPowerful(NTL::Vec<NTL::ZZ>& powerful, const NTL::ZZX& poly) const;
   void powerfulToZZX(NTL::ZZX& poly, const NTL::Vec<NTL::ZZ>& powerful) const;
+
+  //! Same as above for word-sized coefficients. The rows of the CRT are
+  //! computed in parallel.
+  void powerfulToZZX(NTL::ZZX& poly, const NTL::Vec<long>& powerful) const;
 };
 
 /********************************************************************/
@@ -15,6 +15,8 @@
  *  @brief Define some data structures to hold recryption data
  */
 
+#include <array>
+#include <functional>
 #include <helib/NumbTh.h>
 
 namespace helib {
@@ -78,7 +80,8 @@ public:
             bool enableThick, /*init linear transforms for non-thin*/
             long t = 0 /*min Hwt for sk*/,
             bool build_cache = false,
-            bool minimal = false);
+            bool minimal = false,
+            long streamWindow = 0 /*see EvalMap::setStreaming*/);
 
   bool operator==(const RecryptData& other) const;
   bool operator!=(const RecryptData& other) const
@@ -131,7 +134,90 @@ public:
             bool alsoThick, /*init linear transforms also for non-thin*/
             long t = 0 /*min Hwt for sk*/,
             bool build_cache = false,
-            bool minimal = false);
+            bool minimal = false,
+            long streamWindow = 0 /*see EvalMap::setStreaming*/);
+};
+
+/**
+ * @brief The stages of bootstrapping, in the order of reCrypt.
+ * @note Thin bootstrapping starts with LinearTransform2 (slotToCoeff),
+ * followed by PreProcess (the switch to the bootstrapping key and modulus),
+ * LinearTransform1 (coeffToSlot) and ExtractDigits.
+ **/
+enum class BootstrapStage
+{
+  PreProcess,
+  LinearTransform1,
+  ExtractDigits,
+  LinearTransform2
+};
+
+//! @brief The costs of a stage of bootstrapping, or of all of it
+struct BootstrapStageProfile
+{
+  double wallTime = 0; //! seconds
+  double cpuTime = 0;  //! seconds, summed over all threads of the process
+  long keySwitches = 0;
+  long automorphisms = 0;
+  long ntts = 0; //! forward and inverse
+};
+
+/**
+ * @brief The profile of one call to reCrypt, thinReCrypt or their Many
+ * variants, see setBootstrapProfileCallback.
+ * @note The times and operation counts are process-wide, so they include
+ * the work of any other thread that runs concurrently with the bootstrap.
+ **/
+struct BootstrapProfile
+{
+  bool thin = false;
+  //! number of ciphertexts bootstrapped together, 0 if all of them were
+  //! empty or noiseless and there was nothing to do
+  long batchSize = 1;
+
+  //! Indexed by BootstrapStage
+  std::array<BootstrapStageProfile, 4> stages;
+  BootstrapStageProfile total;
+
+  //! Peak resident set size of the process so far, in KB (0 if unknown)
+  long peakMemoryKB = 0;
+
+  //! bitCapacity before and after, the smallest over the batch (0 if the
+  //! batch is empty)
+  long inputCapacity = 0;
+  long outputCapacity = 0;
+
+  const BootstrapStageProfile& stage(BootstrapStage s) const
+  {
+    return stages[static_cast<std::size_t>(s)];
+  }
+
+  //! "preProcess", "LinearTransform1", "extractDigits", "LinearTransform2"
+  static const char* stageName(BootstrapStage s);
+};
+
+/**
+ * @brief Sets a function called with the profile of every bootstrap.
+ * @param callback The function, or an empty one (the default) to stop.
+ * @note The profile is only collected when it is asked for, through this
+ * callback or the profile argument of reCrypt and thinReCrypt. The
+ * callback may be called from several threads at once.
+ * Not thread-safe, meant to be called at startup.
+ **/
+void setBootstrapProfileCallback(
+    std::function<void(const BootstrapProfile&)> callback);
+
+//! @brief When the multiplications of Ctxt bootstrap their operands, see
+//! PubKey::setAutoBootstrap
+struct AutoBootstrapPolicy
+{
+  //! Operands with a smaller bitCapacity are bootstrapped before they are
+  //! multiplied. 0 (the default) turns the policy off.
+  long minCapacity = 0;
+  //! Bootstrap with thinReCrypt rather than reCrypt
+  bool thin = false;
+
+  bool enabled() const { return minCapacity > 0; }
 };
 
 #define HELIB_MIN_CAP_FRAC (2.0 / 3.0)
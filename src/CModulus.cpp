@@ -25,7 +25,9 @@
  * roots of unity.
  */
 #include <helib/CModulus.h>
+#include <helib/binio.h>
 #include <helib/timing.h>
+#include <helib/fhe_stats.h>
 
 namespace helib {
 
@@ -41,6 +43,18 @@ NTL::zz_pContext BuildContext(long p, long maxroot)
     return NTL::zz_pContext(p, maxroot);
 }
 
+// The context used when m is a power of 2, with deterministic roots
+static NTL::zz_pContext BuildPow2Context(long q)
+{
+  RandomState state;
+  SetSeed(NTL::conv<NTL::ZZ>("84547180875373941534287406458029"));
+  // DIRT: this ensures the roots are deterministically generated
+  //    inside the zz_pContext constructor
+  NTL::zz_pContext context(NTL::INIT_USER_FFT, q);
+  state.restore();
+  return context;
+}
+
 // Constructor: it is assumed that zms is already set with m>1
 // If q == 0, then the current context is used
 Cmodulus::Cmodulus(const PAlgebra& zms, long qq, long rt)
@@ -74,14 +88,7 @@ Cmodulus::Cmodulus(const PAlgebra& zms, long qq, long rt)
                "is a power of 2)");
 
     bak.save();
-
-    RandomState state;
-    SetSeed(NTL::conv<NTL::ZZ>("84547180875373941534287406458029"));
-    // DIRT: this ensures the roots are deterministically generated
-    //    inside the zz_pContext constructor
-    context = NTL::zz_pContext(NTL::INIT_USER_FFT, q);
-    state.restore();
-
+    context = BuildPow2Context(q);
     context.restore();
 
     powers.set_ptr(new NTL::zz_pX);
@@ -208,6 +215,136 @@ Cmodulus& Cmodulus::operator=(const Cmodulus& other)
   return *this;
 }
 
+// Raw I/O of the tables, relative to the current modulus
+
+static void writeTable(std::ostream& str, const NTL::zz_pX& a)
+{
+  write_raw_int(str, a.rep.length());
+  for (long i = 0; i < a.rep.length(); i++)
+    write_raw_int(str, rep(a.rep[i]));
+}
+
+static void readTable(std::istream& str, NTL::zz_pX& a)
+{
+  long n = read_raw_int(str);
+  assertInRange<RuntimeError>(n, 0l, 1l << 30, "Bad Cmodulus table length", true);
+  a.rep.SetLength(n);
+  for (long i = 0; i < n; i++)
+    a.rep[i].LoopHole() = read_raw_int(str);
+}
+
+static void makeAux(NTL::Vec<NTL::mulmod_precon_t>& aux,
+                    const NTL::zz_pX& a,
+                    long q)
+{
+  aux.SetLength(a.rep.length());
+  for (long i = 0; i < a.rep.length(); i++)
+    aux[i] = NTL::PrepMulModPrecon(rep(a.rep[i]), q);
+}
+
+// DIRT: like getScratch_fftRep, this uses NTL's internal fftRep fields
+static long fftRepLength(const NTL::fftRep& R)
+{
+#ifdef NTL_PROVIDES_TRUNC_FFT
+  return R.len;
+#else
+  return 1L << R.k;
+#endif
+}
+
+static void writeTable(std::ostream& str, const NTL::fftRep& R)
+{
+  long len = fftRepLength(R);
+  write_raw_int(str, R.k);
+  write_raw_int(str, len);
+  write_raw_int(str, R.NumPrimes);
+  for (long i = 0; i < R.NumPrimes; i++)
+    for (long j = 0; j < len; j++)
+      write_raw_int(str, R.tbl[i][j]);
+}
+
+static void readTable(std::istream& str, NTL::fftRep& R)
+{
+  long k = read_raw_int(str);
+  long len = read_raw_int(str);
+  long numPrimes = read_raw_int(str);
+  assertInRange<RuntimeError>(k, 0l, long(NTL_FFTMaxRoot), "Bad fftRep size", true);
+  assertInRange<RuntimeError>(len, 0l, 1l << k, "Bad fftRep length", true);
+  assertEq<RuntimeError>(numPrimes,
+                    NTL::zz_pInfo->NumPrimes,
+                    "fftRep does not match the current modulus");
+  R.SetSize(k);
+#ifdef NTL_PROVIDES_TRUNC_FFT
+  R.len = len;
+#endif
+  for (long i = 0; i < numPrimes; i++)
+    for (long j = 0; j < len; j++)
+      R.tbl[i][j] = read_raw_int(str);
+}
+
+Cmodulus::Cmodulus(const PAlgebra& zms, std::istream& str)
+{
+  assertTrue<InvalidArgument>(zms.getM() > 1,
+                              "Bad Z_m^* modulus m (must be greater than 1)");
+  zMStar = &zms;
+  q = read_raw_int(str);
+  root = read_raw_int(str);
+  assertInRange<RuntimeError>(q, 2l, long(NTL_SP_BOUND), "Bad Cmodulus prime");
+
+  qinv = NTL::PrepMulMod(q);
+  m_inv = NTL::InvMod(long(zms.getM()), q);
+  rInv = (root == 0) ? 0 : NTL::InvMod(root, q); // root is unused if m = 2^k
+
+  NTL::zz_pBak bak;
+  bak.save();
+  if (zms.getPow2())
+    context = BuildPow2Context(q);
+  else
+    context = BuildContext(q, zms.fftSizeNeeded());
+  context.restore();
+
+  powers.set_ptr(new NTL::zz_pX);
+  ipowers.set_ptr(new NTL::zz_pX);
+  readTable(str, *powers);
+  readTable(str, *ipowers);
+  makeAux(powers_aux, *powers, q);
+  makeAux(ipowers_aux, *ipowers, q);
+
+  if (zms.getPow2()) {
+#ifdef HELIB_OPENCL
+    altFFTInfo = MakeSmart<AltFFTPrimeInfo>();
+    InitAltFFTPrimeInfo(*altFFTInfo, *zz_pInfo->p_info, zms.getPow2() - 1);
+#endif
+    return;
+  }
+
+  Rb.set_ptr(new NTL::fftRep);
+  iRb.set_ptr(new NTL::fftRep);
+  readTable(str, *Rb);
+  readTable(str, *iRb);
+
+  NTL::zz_pX phimx_poly;
+  conv(phimx_poly, zms.getPhimX());
+  phimx.set_ptr(new zz_pXModulus1(zms.getM(), phimx_poly));
+}
+
+void Cmodulus::writeTables(std::ostream& str) const
+{
+  write_raw_int(str, q);
+  write_raw_int(str, root);
+
+  NTL::zz_pBak bak;
+  bak.save();
+  context.restore();
+
+  writeTable(str, *powers);
+  writeTable(str, *ipowers);
+  if (zMStar->getPow2())
+    return;
+  writeTable(str, *Rb);
+  writeTable(str, *iRb);
+}
+
 //==================================================================
 // Starting with NTL 11.1.0, the NTL FFT routines do not do any bit reversal.
 // Specifically, FFTFwd leaves its outputs bit reversed, and FFTInv1
@@ -345,6 +482,7 @@ static void BitReverseCopy(long* NTL_RESTRICT B,
 void Cmodulus::FFT_aux(NTL::vec_long& y, NTL::zz_pX& tmp) const
 {
   HELIB_TIMER_START;
+  HELIB_COUNT_OP(ntts);
 
   if (zMStar->getPow2()) {
     // special case when m is a power of 2
@@ -450,6 +588,7 @@ void Cmodulus::FFT(NTL::vec_long& y, const zzX& x) const
 void Cmodulus::iFFT(NTL::zz_pX& x, const NTL::vec_long& y) const
 {
   HELIB_TIMER_START;
+  HELIB_COUNT_OP(ntts);
   NTL::zz_pBak bak;
   bak.save();
   context.restore();
@@ -11,6 +11,8 @@
  */
 #include <cstring>
 #include <algorithm>
+#include <sstream>
+#include <string>
 #include <helib/Context.h>
 #include <helib/EvalMap.h>
 #include <helib/powerful.h>
@@ -19,6 +21,8 @@
 #include <helib/EncryptedArray.h>
 #include <helib/PolyModRing.h>
 
+#include <NTL/BasicThreadPool.h>
+
 namespace helib {
 
 long FindM(long k,
@@ -281,7 +285,9 @@ std::unique_ptr<Context> buildContextFromBinary(std::istream& str)
   return std::unique_ptr<Context>(new Context(m, p, r, gens, ords));
 }
 
-void writeContextBinary(std::ostream& str, const Context& context)
+void writeContextBinary(std::ostream& str,
+                        const Context& context,
+                        bool withTables)
 {
 
   writeEyeCatcher(str, BINIO_EYE_CONTEXT_BEGIN);
@@ -326,6 +332,30 @@ void writeContextBinary(std::ostream& str, const Context& context)
 
   write_raw_int(str, context.rcData.skHwt);
 
+  // The optional tables come in their own block, which readers that do not
+  // expect it see as a missing end eye catcher
+  if (withTables) {
+    writeEyeCatcher(str, BINIO_EYE_CONTEXT_TABLES_BEGIN);
+    context.modSizes.write(str);
+
+    // Serialize the primes in parallel, then write them out in order
+    long nPrimes = context.moduli.size();
+    std::vector<std::string> tables(nPrimes);
+    NTL_EXEC_RANGE(nPrimes, first, last)
+    for (long i = first; i < last; i++) {
+      std::ostringstream ss;
+      context.moduli[i].writeTables(ss);
+      tables[i] = ss.str();
+    }
+    NTL_EXEC_RANGE_END
+
+    for (const std::string& table : tables) {
+      write_raw_int(str, table.size());
+      str.write(table.data(), table.size());
+    }
+    writeEyeCatcher(str, BINIO_EYE_CONTEXT_TABLES_END);
+  }
+
   writeEyeCatcher(str, BINIO_EYE_CONTEXT_END);
 }
 
@@ -360,11 +390,9 @@ void readContextBinary(std::istream& str, Context& context)
   context.ctxtPrimes.clear();
 
   long nPrimes = read_raw_int(str);
-
-  for (long p, i = 0; i < nPrimes; i++) {
-    p = read_raw_int(str);
-
-    context.moduli.push_back(Cmodulus(context.zMStar, p, 0));
+  std::vector<long> qs(nPrimes);
+  for (long i = 0; i < nPrimes; i++) {
+    qs[i] = read_raw_int(str);
 
     if (smallPrimes.contains(i))
       context.smallPrimes.insert(i); // small prime
@@ -386,20 +414,70 @@ void readContextBinary(std::istream& str, Context& context)
     }
   }
 
-  endBuildModChain(context);
-
   // Read in the partition of m into co-prime factors (if bootstrappable)
   NTL::Vec<long> mv;
   read_ntl_vec_long(str, mv);
 
   long t = read_raw_int(str);
 
+  // Then the optional block of precomputed tables
+  bool haveTables = false;
+  std::vector<std::string> tables;
+  char eye[BINIO_EYE_SIZE];
+  str.read(eye, BINIO_EYE_SIZE);
+  if (memcmp(eye, BINIO_EYE_CONTEXT_TABLES_BEGIN, BINIO_EYE_SIZE) == 0) {
+    haveTables = true;
+    context.modSizes.read(str);
+
+    tables.resize(nPrimes);
+    for (std::string& table : tables) {
+      long len = read_raw_int(str);
+      assertTrue<RuntimeError>(len > 0, "Bad size of Cmodulus tables");
+      table.resize(len);
+      str.read(&table[0], len);
+    }
+
+    int eyeCatcherFound = readEyeCatcher(str, BINIO_EYE_CONTEXT_TABLES_END);
+    assertEq(eyeCatcherFound,
+             0,
+             "Could not find post-context-tables eye catcher");
+    eyeCatcherFound = readEyeCatcher(str, BINIO_EYE_CONTEXT_END);
+    assertEq(eyeCatcherFound, 0, "Could not find post-context eye catcher");
+  } else {
+    // No tables, what was read must be the end eye catcher
+    int eyeCatcherFound = memcmp(eye, BINIO_EYE_CONTEXT_END, BINIO_EYE_SIZE);
+    assertEq(eyeCatcherFound, 0, "Could not find post-context eye catcher");
+  }
+
+  if (haveTables) {
+    context.moduli.resize(nPrimes);
+    NTL_EXEC_RANGE(nPrimes, first, last)
+    for (long i = first; i < last; i++) {
+      std::istringstream ss(tables[i]);
+      context.moduli[i] = Cmodulus(context.zMStar, ss);
+    }
+    NTL_EXEC_RANGE_END
+
+    for (long i = 0; i < nPrimes; i++)
+      assertEq<RuntimeError>(context.moduli[i].getQ(),
+                             qs[i],
+                             "Cmodulus tables do not match the primes");
+
+    // The moduli sizes table was read above, only the powerful basis
+    // converter is left to build
+    std::vector<long> mvec;
+    pp_factorize(mvec, context.zMStar.getM());
+    NTL::Vec<long> mmvec;
+    convert(mmvec, mvec);
+    context.pwfl_converter = std::make_shared<PowerfulDCRT>(context, mmvec);
+  } else {
+    context.addModuli(qs);
+    endBuildModChain(context);
+  }
+
   if (mv.length() > 0) {
     context.makeBootstrappable(mv, t);
   }
-
-  eyeCatcherFound = readEyeCatcher(str, BINIO_EYE_CONTEXT_END);
-  assertEq(eyeCatcherFound, 0, "Could not find post-context eye catcher");
 }
 
 void writeContextBase(std::ostream& str, const Context& context)
@@ -508,11 +586,9 @@ std::istream& operator>>(std::istream& str, Context& context)
 
   long nPrimes;
   str >> nPrimes;
+  std::vector<long> qs(nPrimes);
   for (long i = 0; i < nPrimes; i++) {
-    long p;
-    str >> p;
-
-    context.moduli.push_back(Cmodulus(context.zMStar, p, 0));
+    str >> qs[i];
 
     if (smallPrimes.contains(i))
       context.smallPrimes.insert(i); // small prime
@@ -529,6 +605,7 @@ std::istream& operator>>(std::istream& str, Context& context)
   for (long i = 0; i < (long)context.digits.size(); i++)
     str >> context.digits[i];
 
+  context.addModuli(qs);
   endBuildModChain(context);
 
   // Read in the partition of m into co-prime factors (if bootstrappable)
@@ -573,7 +650,6 @@ Context::Context(unsigned long m,
                  const std::vector<long>& ords) :
     zMStar(m, p, gens, ords),
     alMod(zMStar, r),
-    ea(std::make_shared<EncryptedArray>(*this, alMod)),
     pwfl_converter(nullptr),
     stdev(3.2),
     scale(10.0)
@@ -581,9 +657,26 @@ Context::Context(unsigned long m,
   // NOTE: pwfl_converter will be set in buildModChain (or endBuildModChain),
   // after the prime chain has been built, as it depends on the primeChain
 
-  if (this->alMod.getTag() != PA_cx_tag) {
-    slotRing =
-        std::make_shared<PolyModRing>(zMStar.getP(), alMod.getR(), getG(*ea));
+  // ea and slotRing are built on first use, with the dry-run flag as it is
+  // now (see PAlgebraMod)
+  bool dryRun = isDryRun();
+  ea = LazyPtr<const EncryptedArray>([this, dryRun] {
+    assertFalse<LogicError>(slotsDisabled(),
+                            "Context slots are disabled (no-slots mode)");
+    DryRunGuard guard(dryRun);
+    return std::make_shared<const EncryptedArray>(*this, alMod);
+  });
+  slotRing = LazyPtr<PolyModRing>([this]() -> std::shared_ptr<PolyModRing> {
+    if (alMod.getTag() == PA_cx_tag)
+      return nullptr;
+    return std::make_shared<PolyModRing>(zMStar.getP(),
+                                         alMod.getR(),
+                                         getG(*ea));
+  });
+
+  if (dryRun) {
+    ea.shared();
+    slotRing.shared();
   }
 }
 
@@ -19,6 +19,7 @@
 #include <helib/CtPtrs.h>
 #include <helib/EncryptedArray.h>
 #include <helib/Ptxt.h>
+#include <helib/EncodedPtxt.h>
 
 #include <helib/debugging.h>
 #include <helib/norms.h>
@@ -111,7 +112,10 @@ bool Ctxt::verifyPrimeSet() const
 // It is assumed that W has at least as many b[i]'s as there are digits.
 // The vector of digits is modified in place.
 void Ctxt::keySwitchDigits(const KeySwitch& W, std::vector<DoubleCRT>& digits)
-{ // An object to hold the pseudorandom ai's, note that it must be defined
+{
+  HELIB_COUNT_OP(keySwitches);
+
+  // An object to hold the pseudorandom ai's, note that it must be defined
   // with the maximum number of levels, else the PRG will go out of sync.
   // FIXME: This is a bug waiting to happen.
 
@@ -787,6 +791,21 @@ void Ctxt::addConstant(const NTL::ZZX& poly, double size)
   addConstant(DoubleCRT(poly, context, primeSet), size);
 }
 
+void Ctxt::addConstant(const EncodedPtxt& ptxt, bool negative)
+{
+  assertEq(&context,
+           &ptxt.getContext(),
+           "Cannot add EncodedPtxt with different context");
+  std::shared_ptr<const DoubleCRT> dcrt = ptxt.getDCRT(primeSet);
+  if (!negative) {
+    addConstant(*dcrt, ptxt.getSize());
+    return;
+  }
+  DoubleCRT tmp = *dcrt;
+  tmp.Negate();
+  addConstant(tmp, ptxt.getSize());
+}
+
 // Add a constant polynomial
 void Ctxt::addConstant(const NTL::ZZ& c)
 {
@@ -869,6 +888,24 @@ Ctxt& Ctxt::operator+=(const Ptxt<BGV>& other)
   return *this;
 }
 
+Ctxt& Ctxt::operator+=(const EncodedPtxt& other)
+{
+  addConstant(other);
+  return *this;
+}
+
+Ctxt& Ctxt::operator-=(const EncodedPtxt& other)
+{
+  addConstant(other, /*negative=*/true);
+  return *this;
+}
+
+Ctxt& Ctxt::operator*=(const EncodedPtxt& other)
+{
+  multByConstant(other);
+  return *this;
+}
+
 Ctxt& Ctxt::operator+=(const Ptxt<CKKS>& other)
 {
   addConstantCKKS(other);
@@ -1375,6 +1412,18 @@ void Ctxt::multiplyBy(const Ctxt& other)
     return;
   }
 
+  // Under an auto-bootstrap policy, first bootstrap the operands that need
+  // it, together (see PubKey::setAutoBootstrap)
+  if (pubKey.getAutoBootstrap().enabled()) {
+    if (&other != this && pubKey.needsAutoReCrypt(other)) {
+      Ctxt tmp = other;
+      pubKey.autoReCrypt({this, &tmp});
+      multiplyBy(tmp);
+      return;
+    }
+    pubKey.autoReCrypt({this});
+  }
+
   *this *= other; // perform the multiplication
   reLinearize();  // re-linearize
 #ifdef HELIB_DEBUG
@@ -1399,6 +1448,33 @@ void Ctxt::multiplyBy2(const Ctxt& other1, const Ctxt& other2)
     return;
   }
 
+  // Under an auto-bootstrap policy, first bootstrap the operands that need
+  // it, together, keeping any aliasing between them
+  if (pubKey.getAutoBootstrap().enabled()) {
+    const Ctxt* op1 = &other1;
+    const Ctxt* op2 = &other2;
+    Ctxt tmp1(ZeroCtxtLike, other1);
+    Ctxt tmp2(ZeroCtxtLike, other2);
+    std::vector<Ctxt*> due{this};
+    if (op1 != this && pubKey.needsAutoReCrypt(*op1)) {
+      tmp1 = *op1;
+      op1 = &tmp1;
+      due.push_back(&tmp1);
+    }
+    if (op2 == &other1)
+      op2 = op1;
+    else if (op2 != this && pubKey.needsAutoReCrypt(*op2)) {
+      tmp2 = *op2;
+      op2 = &tmp2;
+      due.push_back(&tmp2);
+    }
+    pubKey.autoReCrypt(due);
+    if (op1 != &other1 || op2 != &other2) {
+      multiplyBy2(*op1, *op2);
+      return;
+    }
+  }
+
   long cap = capacity();
   long cap1 = other1.capacity();
   long cap2 = other2.capacity();
@@ -1563,6 +1639,31 @@ void Ctxt::multByConstant(const zzX& poly, double size)
   multByConstant(dcrt, size);
 }
 
+void Ctxt::multByConstant(const EncodedPtxt& ptxt)
+{
+  HELIB_TIMER_START;
+  if (this->isEmpty())
+    return;
+  assertEq(&context,
+           &ptxt.getContext(),
+           "Cannot multiply by EncodedPtxt with different context");
+  multByConstant(*ptxt.getDCRT(primeSet), ptxt.getSize());
+}
+
+void Ctxt::multByConstant(const std::vector<const long*>& rows, double size)
+{
+  HELIB_TIMER_START;
+  if (this->isEmpty())
+    return;
+  assertFalse(isCKKS(),
+              "Cannot multiply a CKKS ciphertext by external DoubleCRT rows");
+
+  for (long i : range(parts.size()))
+    parts[i].Mul(rows);
+
+  noiseBound *= size;
+}
+
 void Ctxt::multByConstantCKKS(const std::vector<std::complex<double>>& other)
 {
   // NOTE: some replicated logic here and in addConstantCKKS...
@@ -1674,6 +1775,7 @@ void Ctxt::automorph(long k) // Apply automorphism F(X)->F(X^k) (gcd(k,m)=1)
   // Sanity check: verify that k \in Zm*
   assertTrue(context.zMStar.inZmStar(k), "k must be in Zm*");
   long m = context.zMStar.getM();
+  HELIB_COUNT_OP(automorphisms);
 
   // Apply this automorphism to all the parts
   for (auto& part : parts) {
@@ -1852,6 +1954,72 @@ void Ctxt::read(std::istream& str)
   assertEq(eyeCatcherFound, 0, "Could not find post-ciphertext eye catcher");
 }
 
+void SeededCtxt::expand(Ctxt& out) const
+{
+  HELIB_TIMER_START;
+  out = ctxt;
+  if (ctxt.isEmpty())
+    return;
+
+  DoubleCRT a(ctxt.getContext(), ctxt.getPrimeSet());
+  {
+    RandomState state;
+    SetSeed(prgSeed);
+    a.randomize();
+  } // restore state upon destruction of state
+  out.addPart(a, randHandle);
+}
+
+void expandSeededCtxts(std::vector<Ctxt>& out,
+                       const std::vector<SeededCtxt>& in)
+{
+  long n = in.size();
+  if (n == 0) {
+    out.clear();
+    return;
+  }
+  out.resize(n, Ctxt(in[0].getPubKey()));
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long i = first; i < last; i++)
+    in[i].expand(out[i]);
+  NTL_EXEC_RANGE_END
+}
+
+void SeededCtxt::write(std::ostream& str) const
+{
+  writeEyeCatcher(str, BINIO_EYE_SEEDCTXT_BEGIN);
+
+  /*  Writing out in binary:
+    1.  Ctxt ctxt (without the random part)
+    2.  SKHandle randHandle
+    3.  NTL::ZZ prgSeed
+  */
+
+  ctxt.write(str);
+  randHandle.write(str);
+  write_raw_ZZ(str, prgSeed);
+
+  writeEyeCatcher(str, BINIO_EYE_SEEDCTXT_END);
+}
+
+void SeededCtxt::read(std::istream& str)
+{
+  int eyeCatcherFound = readEyeCatcher(str, BINIO_EYE_SEEDCTXT_BEGIN);
+  assertEq(eyeCatcherFound,
+           0,
+           "Could not find pre-seeded-ciphertext eye catcher");
+
+  ctxt.read(str);
+  randHandle.read(str);
+  read_raw_ZZ(str, prgSeed);
+
+  eyeCatcherFound = readEyeCatcher(str, BINIO_EYE_SEEDCTXT_END);
+  assertEq(eyeCatcherFound,
+           0,
+           "Could not find post-seeded-ciphertext eye catcher");
+}
+
 void CtxtPart::write(std::ostream& str) const
 {
   this->DoubleCRT::write(str); // CtxtPart is a child.
@@ -2062,6 +2230,20 @@ void innerProduct(Ctxt& result,
 // additive mod switching noise)
 
 double Ctxt::rawModSwitch(std::vector<NTL::ZZX>& zzParts, long q) const
+{
+  std::vector<NTL::Vec<long>> pwrflParts;
+  double scaledNoise = rawModSwitch(pwrflParts, q);
+
+  zzParts.resize(pwrflParts.size());
+  const PowerfulDCRT& p2d_conv = *context.rcData.p2dConv;
+  for (long i : range(pwrflParts.size()))
+    p2d_conv.powerfulToZZX(zzParts[i], pwrflParts[i]); // convert to ZZX
+
+  return scaledNoise;
+}
+
+double Ctxt::rawModSwitch(std::vector<NTL::Vec<long>>& pwrflParts,
+                          long q) const
 {
   // Ensure that new modulus is co-prime with plaintext space
   const long p2r = getPtxtSpace();
@@ -2090,71 +2272,80 @@ double Ctxt::rawModSwitch(std::vector<NTL::ZZX>& zzParts, long q) const
   // prime that divide q.  With this assumption, the probabilistic
   // analysis is a bit cleaner
 
-  // Scale and round all the integers in all the parts
-  zzParts.resize(parts.size());
+  // Convert all the parts to the powerful basis
+  long nParts = parts.size();
   const PowerfulDCRT& p2d_conv = *context.rcData.p2dConv;
-  for (long i : range(parts.size())) {
-
-    NTL::Vec<NTL::ZZ> pwrfl;
-    p2d_conv.dcrtToPowerful(pwrfl, parts[i]); // convert to powerful rep
-
-    // vecRed(pwrfl, pwrfl, Q, false);
-    // reduce to interval [-Q/2,+Q/2]
-    // FIXME: it looks like the coefficients should already be reduced
-
-    NTL::ZZ c, X, Y, cq;
-
-    for (long j : range(pwrfl.length())) {
-      c = pwrfl[j];
-      mul(cq, c, q);
-      DivRem(X, Y, cq, Q);
-      if (Y > Q_half) {
-        sub(Y, Y, Q);
-        add(X, X, 1);
-      }
-
-      // c*q = Q*X + Y, where X = round(c*q/Q)
-      // in other words: c*q/Q = X + Y/Q
+  std::vector<NTL::Vec<NTL::ZZ>> pwrfl(nParts);
+  NTL_EXEC_RANGE(nParts, first, last)
+  for (long i = first; i < last; i++)
+    p2d_conv.dcrtToPowerful(pwrfl[i], parts[i]); // convert to powerful rep
+  NTL_EXEC_RANGE_END
+
+  // vecRed(pwrfl, pwrfl, Q, false);
+  // reduce to interval [-Q/2,+Q/2]
+  // FIXME: it looks like the coefficients should already be reduced
+
+  // Scale and round all the integers in all the parts. The results fit in
+  // a word, only the intermediate values c*q need multi-precision.
+  long phim = nParts ? pwrfl[0].length() : 0;
+  pwrflParts.resize(nParts);
+  for (long i : range(nParts))
+    pwrflParts[i].SetLength(phim);
+
+  NTL_EXEC_RANGE(nParts * phim, first, last)
+  NTL::ZZ c, X, Y, cq;
+  for (long idx = first; idx < last; idx++) {
+    long i = idx / phim;
+    long j = idx % phim;
+
+    c = pwrfl[i][j];
+    mul(cq, c, q);
+    DivRem(X, Y, cq, Q);
+    if (Y > Q_half) {
+      sub(Y, Y, Q);
+      add(X, X, 1);
+    }
 
-      long x = NTL::conv<long>(X);
+    // c*q = Q*X + Y, where X = round(c*q/Q)
+    // in other words: c*q/Q = X + Y/Q
 
-      long delta = NTL::MulMod(rem(Y, p2r), Q_inv_mod_p, p2r);
-      // delta = Y*Q^{-1} mod p^r
-      // so we have c*q*Q^{-1} = X + Y*Q^{-1} = x + delta (mod p^r)
+    long x = NTL::conv<long>(X);
 
-      // c' = c*q/Q - Y/Q + delta
-      // this logic makes sure that -Y/Q + delta is essentially
-      // uniformly distributed over [-p2r/2,p2r/2].
+    long delta = NTL::MulMod(rem(Y, p2r), Q_inv_mod_p, p2r);
+    // delta = Y*Q^{-1} mod p^r
+    // so we have c*q*Q^{-1} = X + Y*Q^{-1} = x + delta (mod p^r)
 
-      if (delta > p2r / 2 ||
-          (p2r % 2 == 0 && delta == p2r / 2 &&
-           ((sign(Y) < 0) || (sign(Y) == 0 && NTL::RandomBnd(2)))))
-        delta -= p2r;
+    // c' = c*q/Q - Y/Q + delta
+    // this logic makes sure that -Y/Q + delta is essentially
+    // uniformly distributed over [-p2r/2,p2r/2].
 
-      x += delta;
+    if (delta > p2r / 2 ||
+        (p2r % 2 == 0 && delta == p2r / 2 &&
+         ((sign(Y) < 0) || (sign(Y) == 0 && NTL::RandomBnd(2)))))
+      delta -= p2r;
 
-      // sanity check: |c*q/Q - x| <= p^r/2
-      NTL::xdouble diff =
-          NTL::fabs(NTL::conv<NTL::xdouble>(c) * NTL::conv<NTL::xdouble>(q) /
-                        NTL::conv<NTL::xdouble>(Q) -
-                    NTL::conv<NTL::xdouble>(x));
-      if (diff > NTL::conv<NTL::xdouble>(p2r) / 2.0 + 0.0001) {
-        std::stringstream ss;
-        ss << "\n***BAD rawModSwitch: diff=" << diff << ", p2r=" << p2r;
-        throw RuntimeError(ss.str());
-      }
+    x += delta;
 
-      // reduce symmetrically mod q, randomizing if necessary for even q
-      if (x > q / 2 || (q % 2 == 0 && x == q / 2 && NTL::RandomBnd(2)))
-        x -= q;
-      else if (x < -q / 2 || (q % 2 == 0 && x == -q / 2 && NTL::RandomBnd(2)))
-        x += q;
-
-      pwrfl[j] = x; // store back in the powerful vector
+    // sanity check: |c*q/Q - x| <= p^r/2
+    NTL::xdouble diff =
+        NTL::fabs(NTL::conv<NTL::xdouble>(c) * NTL::conv<NTL::xdouble>(q) /
+                      NTL::conv<NTL::xdouble>(Q) -
+                  NTL::conv<NTL::xdouble>(x));
+    if (diff > NTL::conv<NTL::xdouble>(p2r) / 2.0 + 0.0001) {
+      std::stringstream ss;
+      ss << "\n***BAD rawModSwitch: diff=" << diff << ", p2r=" << p2r;
+      throw RuntimeError(ss.str());
     }
 
-    p2d_conv.powerfulToZZX(zzParts[i], pwrfl); // convert to ZZX
+    // reduce symmetrically mod q, randomizing if necessary for even q
+    if (x > q / 2 || (q % 2 == 0 && x == q / 2 && NTL::RandomBnd(2)))
+      x -= q;
+    else if (x < -q / 2 || (q % 2 == 0 && x == -q / 2 && NTL::RandomBnd(2)))
+      x += q;
+
+    pwrflParts[i][j] = x; // store in the powerful vector
   }
+  NTL_EXEC_RANGE_END
 
   // Return an estimate for the noise
   double scaledNoise = NTL::conv<double>(noiseBound * ratio);
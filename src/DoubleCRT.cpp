@@ -206,6 +206,29 @@ DoubleCRT& DoubleCRT::do_mul(const DoubleCRT& other, bool matchIndexSets)
   return *this;
 }
 
+void DoubleCRT::Mul(const std::vector<const long*>& rows)
+{
+  HELIB_TIMER_START;
+
+  if (isDryRun())
+    return;
+
+  const IndexSet& s = map.getIndexSet();
+  long phim = context.zMStar.getPhiM();
+
+  for (long i : s) {
+    assertTrue(i < lsize(rows) && rows[i] != nullptr,
+               "DoubleCRT::Mul: no row for prime " + std::to_string(i));
+    long pi = context.ithPrime(i);
+    NTL::mulmod_t pi_inv = context.ithModulus(i).getQInv();
+    long* row = map[i].elts();
+    const long* other_row = rows[i];
+
+    for (long j : range(phim))
+      row[j] = MulMod(row[j], other_row[j], pi, pi_inv);
+  }
+}
+
 #if 0
 template
 DoubleCRT& DoubleCRT::Op<DoubleCRT::MulFun>(const DoubleCRT &other, MulFun fun,
@@ -149,6 +149,52 @@ double EncryptedArrayCx::encode(zzX& ptxt,
   return factor;
 }
 
+void EncryptedArrayCx::encodeMany(
+    std::vector<zzX>& ptxts,
+    std::vector<double>& factors,
+    const std::vector<std::vector<cx_double>>& arrays,
+    double useThisSize,
+    long precision) const
+{
+  HELIB_TIMER_START;
+  long n = arrays.size();
+  double scalingFactor = encodeScalingFactor(precision);
+
+  factors.resize(n);
+  for (long i : range(n)) {
+    double size = useThisSize;
+    if (size < 0)
+      for (auto& x : arrays[i]) {
+        if (size < std::abs(x))
+          size = std::abs(x);
+      }
+    if (size <= 0)
+      size = 1.0;
+    factors[i] = scalingFactor / size;
+  }
+
+  CKKS_embedInSlots(ptxts, arrays, getPAlgebra(), factors);
+}
+
+void EncryptedArrayCx::decodeMany(std::vector<std::vector<cx_double>>& arrays,
+                                  const std::vector<zzX>& ptxts,
+                                  const std::vector<double>& scalings) const
+{
+  HELIB_TIMER_START;
+  long n = ptxts.size();
+  assertEq<InvalidArgument>(long(scalings.size()),
+                            n,
+                            "Need one scaling factor per polynomial");
+  for (double scaling : scalings)
+    assertTrue<InvalidArgument>(scaling > 0,
+                                "Scaling must be positive to decode");
+
+  CKKS_canonicalEmbedding(arrays, ptxts, getPAlgebra());
+  for (long i : range(n))
+    for (auto& x : arrays[i])
+      x /= scalings[i];
+}
+
 double EncryptedArrayCx::encode(zzX& ptxt,
                                 double num,
                                 double useThisSize,
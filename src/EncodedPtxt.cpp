@@ -0,0 +1,222 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#include <helib/EncodedPtxt.h>
+#include <helib/NumbTh.h>
+#include <helib/Ptxt.h>
+#include <helib/norms.h>
+#include <helib/timing.h>
+
+namespace helib {
+
+EncodedPtxt::EncodedPtxt(const Context& _context, const Ptxt<BGV>& ptxt) :
+    context(_context), size(0.0), upgraded(false)
+{
+  HELIB_TIMER_START;
+  // Reduce the encoding to the symmetric interval mod p^r, which is still
+  // correct for ciphertexts with any plaintext space p^r' with r' <= r
+  NTL::ZZX repr = ptxt.getPolyRepr();
+  PolyRed(repr, context.alMod.getPPowR(), /*abs=*/false);
+  convert(poly, repr);
+  init();
+}
+
+EncodedPtxt::EncodedPtxt(const Context& _context, const zzX& _poly) :
+    context(_context), poly(_poly), size(0.0), upgraded(false)
+{
+  init();
+}
+
+EncodedPtxt::EncodedPtxt(const Context& _context, const NTL::ZZX& _poly) :
+    context(_context), size(0.0), upgraded(false)
+{
+  convert(poly, _poly);
+  init();
+}
+
+EncodedPtxt::EncodedPtxt(const EncodedPtxt& other) :
+    context(other.context), poly(other.poly), size(other.size)
+{
+  HELIB_MUTEX_GUARD(other.mtx);
+  upgraded = other.upgraded;
+  dcrts = other.dcrts;
+}
+
+void EncodedPtxt::init()
+{
+  assertFalse<LogicError>(context.alMod.getTag() == PA_cx_tag,
+                          "EncodedPtxt only supports BGV");
+  normalize(poly);
+  size = embeddingLargestCoeff(poly, context.zMStar);
+}
+
+std::shared_ptr<const DoubleCRT> EncodedPtxt::getDCRT(const IndexSet& s) const
+{
+  {
+    HELIB_MUTEX_GUARD(mtx);
+    for (const auto& entry : dcrts)
+      if (entry.first >= s)
+        return entry.second;
+    if (!upgraded)
+      return std::make_shared<const DoubleCRT>(poly, context, s);
+  }
+
+  // Do the conversion without holding the lock. Two threads may both
+  // compute the same form, in which case only the first one is kept.
+  auto dcrt = std::make_shared<const DoubleCRT>(poly, context, s);
+
+  HELIB_MUTEX_GUARD(mtx);
+  if (!upgraded)
+    return dcrt; // downgraded in the meantime
+  for (const auto& entry : dcrts)
+    if (entry.first >= s)
+      return entry.second;
+  dcrts.emplace_back(s, dcrt);
+  return dcrt;
+}
+
+void EncodedPtxt::upgrade()
+{
+  HELIB_MUTEX_GUARD(mtx);
+  upgraded = true;
+}
+
+void EncodedPtxt::upgrade(const IndexSet& s)
+{
+  upgrade();
+  getDCRT(s);
+}
+
+void EncodedPtxt::downgrade()
+{
+  HELIB_MUTEX_GUARD(mtx);
+  upgraded = false;
+  dcrts.clear();
+}
+
+bool EncodedPtxt::isUpgraded() const
+{
+  HELIB_MUTEX_GUARD(mtx);
+  return upgraded;
+}
+
+std::size_t EncodedPtxt::memoryUsage() const
+{
+  std::size_t bytes = sizeof(*this) + poly.length() * sizeof(long);
+
+  // Each DoubleCRT holds phi(m) words per prime
+  std::size_t phim = context.zMStar.getPhiM();
+  HELIB_MUTEX_GUARD(mtx);
+  for (const auto& entry : dcrts)
+    bytes += entry.first.card() * phim * sizeof(long);
+  return bytes;
+}
+
+EncodedPtxtCache::EncodedPtxtCache(std::size_t _limit) :
+    limit(_limit), total(0), useCount(0)
+{}
+
+EncodedPtxtCache::EncodedPtxtCache(const EncodedPtxtCache& other) :
+    limit(other.getLimit()), total(0), useCount(0)
+{}
+
+std::shared_ptr<const EncodedPtxt> EncodedPtxtCache::get(
+    const Key& key,
+    const IndexSet& s,
+    const std::function<zzX()>& build,
+    const Context& context)
+{
+  std::shared_ptr<EncodedPtxt> ptxt;
+  bool enabled;
+  {
+    HELIB_MUTEX_GUARD(mtx);
+    enabled = (limit != 0);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      it->second.lastUse = ++useCount;
+      ptxt = it->second.ptxt;
+    }
+  }
+
+  if (!enabled) // caching disabled, the DoubleCRT is computed on the fly
+    return std::make_shared<const EncodedPtxt>(context, build());
+
+  if (!ptxt) {
+    // Build the entry without holding the lock. Two threads may both build
+    // the same entry, in which case only the first one is kept.
+    ptxt = std::make_shared<EncodedPtxt>(context, build());
+    ptxt->upgrade();
+
+    HELIB_MUTEX_GUARD(mtx);
+    auto res = entries.emplace(key, Entry{ptxt, 0, 0});
+    ptxt = res.first->second.ptxt;
+  }
+
+  // Compute the DoubleCRT form (if not already there), then account for it
+  ptxt->upgrade(s);
+  std::size_t bytes = ptxt->memoryUsage();
+
+  HELIB_MUTEX_GUARD(mtx);
+  auto it = entries.find(key);
+  if (it != entries.end() && it->second.ptxt == ptxt) {
+    total += bytes - it->second.bytes;
+    it->second.bytes = bytes;
+    it->second.lastUse = ++useCount;
+    evict();
+  }
+  return ptxt;
+}
+
+void EncodedPtxtCache::evict()
+{
+  while (total > limit && !entries.empty()) {
+    auto lru = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+      if (it->second.lastUse < lru->second.lastUse)
+        lru = it;
+    total -= lru->second.bytes;
+    entries.erase(lru);
+  }
+}
+
+void EncodedPtxtCache::setLimit(std::size_t _limit)
+{
+  HELIB_MUTEX_GUARD(mtx);
+  limit = _limit;
+  evict();
+}
+
+std::size_t EncodedPtxtCache::getLimit() const
+{
+  HELIB_MUTEX_GUARD(mtx);
+  return limit;
+}
+
+std::size_t EncodedPtxtCache::memoryUsage() const
+{
+  HELIB_MUTEX_GUARD(mtx);
+  return total;
+}
+
+long EncodedPtxtCache::size() const
+{
+  HELIB_MUTEX_GUARD(mtx);
+  return entries.size();
+}
+
+void EncodedPtxtCache::clear()
+{
+  HELIB_MUTEX_GUARD(mtx);
+  entries.clear();
+  total = 0;
+}
+
+} // namespace helib
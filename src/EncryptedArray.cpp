@@ -12,8 +12,10 @@
 /* EncryptedArray.cpp - Data-movement operations on arrays of slots
  */
 #include <algorithm>
+#include <NTL/BasicThreadPool.h>
 #include <helib/zzX.h>
 #include <helib/EncryptedArray.h>
+#include <helib/matmul.h>
 #include <helib/timing.h>
 #include <helib/clonedPtr.h>
 #include <helib/norms.h>
@@ -54,11 +56,50 @@ template <typename type>
 EncryptedArrayDerived<type>::EncryptedArrayDerived(const Context& _context,
                                                    const RX& _G,
                                                    const PAlgebraMod& alMod) :
-    context(_context), tab(alMod.getDerived(type()))
+    context(_context),
+    tab(alMod.getDerived(type())),
+    maskCache(/*limit=*/1UL << 28) // 256MiB
 {
   tab.mapToSlots(mappingData, _G); // Compute the base-G representation maps
 }
 
+// Keys of the masks in maskCache
+enum
+{
+  MASK_ROTATE,  // {MASK_ROTATE, amt, i}: rotationMask(amt, i)
+  MASK_BAD_DIM, // {MASK_BAD_DIM, i, amt}: maskTable[i][amt]
+  MASK_SHIFT1D  // {MASK_SHIFT1D, i, amt, k<0}: the mask of shift1D
+};
+
+template <typename type>
+std::shared_ptr<const EncodedPtxt> EncryptedArrayDerived<type>::getMask(
+    const EncodedPtxtCache::Key& key,
+    const IndexSet& s,
+    const std::function<RX()>& build) const
+{
+  // NOTE: build() runs in this thread, with the NTL context of the caller
+  return maskCache.get(
+      key, s, [&build]() { return balanced_zzX(build()); }, context);
+}
+
+template <typename type>
+typename EncryptedArrayDerived<type>::RX
+EncryptedArrayDerived<type>::rotationMask(long amt, long i) const
+{
+  const PAlgebra& al = getPAlgebra();
+  const std::vector<std::vector<RX>>& maskTable = tab.getMaskTable();
+  const RXModulus& PhimXmod = tab.getPhimXMod();
+
+  long j = al.numOfGens() - 1;
+  RX mask = maskTable[j][al.coordinate(j, amt)];
+  for (j--; j > i; j--) {
+    long v = al.coordinate(j, amt);
+    mask = ((mask * (maskTable[j][v] - maskTable[j][v + 1])) % PhimXmod) +
+           maskTable[j][v + 1];
+  }
+  return mask;
+}
+
 // Correction function for automorph in bad dimensions
 template <typename type>
 void EncryptedArrayDerived<type>::badDimensionAutomorphCorrection(
@@ -81,16 +122,17 @@ void EncryptedArrayDerived<type>::badDimensionAutomorphCorrection(
   // assumption that we have the key switch matrix
   // for \rho_i^{-ord}
 
-  const RX& mask = maskTable[i][amt];
-  zzX mask_poly = balanced_zzX(mask);
-  double sz = embeddingLargestCoeff(mask_poly, zMStar);
-  DoubleCRT m1(mask_poly, context, ctxt.getPrimeSet() | T.getPrimeSet());
+  IndexSet s = ctxt.getPrimeSet() | T.getPrimeSet();
+  std::shared_ptr<const EncodedPtxt> mask =
+      getMask({MASK_BAD_DIM, i, amt}, s, [&]() { return maskTable[i][amt]; });
+  std::shared_ptr<const DoubleCRT> m1 = mask->getDCRT(s);
+  double sz = mask->getSize();
   // m1 will be used to multiply both ctxt and T
 
   // Compute ctxt = ctxt*m1 + T - T*m1
-  ctxt.multByConstant(m1, sz);
+  ctxt.multByConstant(*m1, sz);
   ctxt += T;
-  T.multByConstant(m1, sz);
+  T.multByConstant(*m1, sz);
   ctxt -= T;
 }
 
@@ -159,17 +201,19 @@ void EncryptedArrayDerived<type>::shift1D(Ctxt& ctxt, long i, long k) const
   if (amt < 0)
     amt += ord;
 
-  RX mask = maskTable[i][ord - amt];
-
   long val;
   if (k < 0)
     val = al.genToPow(i, amt - ord);
-  else {
-    mask = 1 - mask;
+  else
     val = al.genToPow(i, amt);
-  }
-  ctxt.multByConstant(balanced_zzX(mask)); // zero out slots where mask=0
-  ctxt.smartAutomorph(val);                // shift left by val
+
+  std::shared_ptr<const EncodedPtxt> mask =
+      getMask({MASK_SHIFT1D, i, amt, k < 0}, ctxt.getPrimeSet(), [&]() {
+        const RX& m = maskTable[i][ord - amt];
+        return (k < 0) ? m : RX(1 - m);
+      });
+  ctxt.multByConstant(*mask); // zero out slots where mask=0
+  ctxt.smartAutomorph(val);   // shift left by val
   HELIB_TIMER_STOP;
 }
 
@@ -184,8 +228,6 @@ void EncryptedArrayDerived<type>::rotate(Ctxt& ctxt, long amt) const
 
   const PAlgebra& al = getPAlgebra();
 
-  const std::vector<std::vector<RX>>& maskTable = tab.getMaskTable();
-
   RBak bak;
   bak.save();
   tab.restoreContext();
@@ -206,12 +248,17 @@ void EncryptedArrayDerived<type>::rotate(Ctxt& ctxt, long amt) const
   if (amt < 0)
     amt += al.getNSlots();
 
+  // The mask applied to dimension i, see rotationMask
+  auto getRotationMask = [&](long i, const IndexSet& s) {
+    return getMask({MASK_ROTATE, amt, i}, s, [&]() {
+      return rotationMask(amt, i);
+    });
+  };
+
   // rotate the ciphertext, one dimension at a time
   long i = al.numOfGens() - 1;
   long v = al.coordinate(i, amt);
-  RX mask = maskTable[i][v];
   Ctxt tmp(ctxt.getPubKey());
-  const RXModulus& PhimXmod = tab.getPhimXMod();
 
   // optimize for the common case where the last generator has order in
   // Zm*/(p) different than its order in Zm*. In this case we can combine
@@ -235,17 +282,17 @@ void EncryptedArrayDerived<type>::rotate(Ctxt& ctxt, long amt) const
     // assumption that we have the key switch matrix
     // for \rho_i^{-ord}
 
-    zzX mask_poly = balanced_zzX(mask);
-    double sz = embeddingLargestCoeff(mask_poly, al);
-
-    DoubleCRT m1(mask_poly, context, ctxt.getPrimeSet() | tmp.getPrimeSet());
+    IndexSet s = ctxt.getPrimeSet() | tmp.getPrimeSet();
+    std::shared_ptr<const EncodedPtxt> mask = getRotationMask(i - 1, s);
+    std::shared_ptr<const DoubleCRT> m1 = mask->getDCRT(s);
+    double sz = mask->getSize();
     // m1 will be used to multiply both ctxt and tmp
 
     // Compute ctxt = ctxt*m1, tmp = tmp*(1-m1)
-    ctxt.multByConstant(m1, sz);
+    ctxt.multByConstant(*m1, sz);
 
     Ctxt tmp1(tmp);
-    tmp1.multByConstant(m1, sz);
+    tmp1.multByConstant(*m1, sz);
     tmp -= tmp1;
 
     // apply rotation relative to next generator before combining the parts
@@ -258,29 +305,22 @@ void EncryptedArrayDerived<type>::rotate(Ctxt& ctxt, long amt) const
     if (i <= 0) {
       return;
     } // no more generators
-
-    // update the mask for next iteration
-    mask = ((mask * (maskTable[i][v] - maskTable[i][v + 1])) % PhimXmod) +
-           maskTable[i][v + 1];
   }
 
   // Handle rotation relative to all the other generators (if any)
   for (i--; i >= 0; i--) {
     v = al.coordinate(i, amt);
 
-    zzX mask_poly = balanced_zzX(mask);
+    std::shared_ptr<const EncodedPtxt> mask =
+        getRotationMask(i, ctxt.getPrimeSet());
 
     tmp = ctxt;
-    tmp.multByConstant(mask_poly); // only the slots in which mask=1
-    ctxt -= tmp;                   // only the slots in which mask=0
+    tmp.multByConstant(*mask); // only the slots in which mask=1
+    ctxt -= tmp;               // only the slots in which mask=0
 
     rotate1D(tmp, i, v);
     rotate1D(ctxt, i, v + 1);
     ctxt += tmp;
-    if (i > 0) {
-      mask = ((mask * (maskTable[i][v] - maskTable[i][v + 1])) % PhimXmod) +
-             maskTable[i][v + 1]; // update the mask for next iteration
-    }
   }
   HELIB_TIMER_STOP;
 }
@@ -292,8 +332,6 @@ void EncryptedArrayDerived<type>::shift(Ctxt& ctxt, long k) const
 
   const PAlgebra& al = getPAlgebra();
 
-  const std::vector<std::vector<RX>>& maskTable = tab.getMaskTable();
-
   RBak bak;
   bak.save();
   tab.restoreContext();
@@ -324,27 +362,26 @@ void EncryptedArrayDerived<type>::shift(Ctxt& ctxt, long k) const
   // rotate the ciphertext, one dimension at a time
   long i = al.numOfGens() - 1;
   long v = al.coordinate(i, amt);
-  RX mask = maskTable[i][v];
   Ctxt tmp(ctxt.getPubKey());
-  const RXModulus& PhimXmod = tab.getPhimXMod();
 
   rotate1D(ctxt, i, v);
   for (i--; i >= 0; i--) {
     v = al.coordinate(i, amt);
 
-    zzX mask_poly = balanced_zzX(mask);
+    // the same masks as for rotate
+    std::shared_ptr<const EncodedPtxt> mask =
+        getMask({MASK_ROTATE, amt, i}, ctxt.getPrimeSet(), [&]() {
+          return rotationMask(amt, i);
+        });
 
     tmp = ctxt;
-    tmp.multByConstant(mask_poly); // only the slots in which mask=1
-    ctxt -= tmp;                   // only the slots in which mask=0
+    tmp.multByConstant(*mask); // only the slots in which mask=1
+    ctxt -= tmp;               // only the slots in which mask=0
     if (i > 0) {
       rotate1D(ctxt, i, v + 1);
       rotate1D(tmp, i, v);
       ctxt += tmp; // combine the two parts
-
-      mask = ((mask * (maskTable[i][v] - maskTable[i][v + 1])) % PhimXmod) +
-             maskTable[i][v + 1]; // update the mask before next iteration
-    } else {                      // i == 0
+    } else {       // i == 0
       if (k < 0)
         v -= al.OrderOf(0);
       shift1D(tmp, 0, v);
@@ -561,36 +598,127 @@ void runningSums(const EncryptedArray& ea, Ctxt& ctxt)
   }
 }
 
-void totalSums(const EncryptedArray& ea, Ctxt& ctxt)
+// Rotate all the ciphertexts in src by amt along dimension dim. If precon is
+// not empty then it holds the hoisting data for each ciphertext in src, which
+// is only used for native dimensions.
+static void rotateValue1D(
+    std::vector<Ctxt>& out,
+    const std::vector<Ctxt>& src,
+    const std::vector<std::shared_ptr<BasicAutomorphPrecon>>& precon,
+    const EncryptedArray& ea,
+    long dim,
+    long amt)
 {
-  long n = ea.size();
+  const PAlgebra& zMStar = ea.getPAlgebra();
+  long n = src.size();
+  out.assign(n, Ctxt(ZeroCtxtLike, src[0]));
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long k = first; k < last; k++) {
+    if (precon.empty()) {
+      out[k] = src[k];
+      ea.rotate1D(out[k], dim, amt);
+    } else {
+      out[k] = *precon[k]->automorph(zMStar.genToPow(dim, amt));
+    }
+  }
+  NTL_EXEC_RANGE_END
+}
 
-  if (n == 1)
+void allSlotsReduce(
+    const EncryptedArray& ea,
+    std::vector<Ctxt>& v,
+    const std::function<void(std::vector<Ctxt>&, std::vector<Ctxt>&)>& op)
+{
+  HELIB_TIMER_START;
+  if (v.empty())
     return;
 
-  Ctxt orig = ctxt;
-
-  long k = NTL::NumBits(n);
-  long e = 1;
-
-  for (long i = k - 2; i >= 0; i--) {
-    Ctxt tmp1 = ctxt;
-    ea.rotate(tmp1, e);
-    ctxt += tmp1; // ctxt = ctxt + (ctxt >>> e)
-    e = 2 * e;
-
-    if (NTL::bit(n, i)) {
-      Ctxt tmp2 = orig;
-      ea.rotate(tmp2, e);
-      ctxt += tmp2; // ctxt = ctxt + (orig >>> e)
-                    // NOTE: we could have also computed
-                    // ctxt =  (ctxt >>> e) + orig, however,
-                    // this would give us greater depth/noise
-      e += 1;
+  const PubKey& pubKey = v[0].getPubKey();
+
+  for (long i = 0; i < ea.dimension(); i++) {
+    long n = ea.sizeOfDimension(i);
+    if (n <= 1)
+      continue;
+
+    // Hoisting only pays off when the key-switching matrices for all the
+    // rotations in this dimension are present, as in traceMap.
+    bool hoist =
+        ea.nativeDimension(i) && pubKey.getKSStrategy(i) == HELIB_KSS_FULL;
+
+    // Going over the bits of n from the bottom, acc holds the combination
+    // of a window of 2^j consecutive slots (computed with depth j), and res
+    // holds the combination of a window of resLen = (n mod 2^j) slots.
+    // When bit j of n is set we append a rotated copy of acc to res, so res
+    // never gets deeper than ceil(log n) applications of op.
+    std::vector<Ctxt> acc;
+    acc.swap(v);
+    std::vector<Ctxt> res;
+    long resLen = 0;
+    long k = NTL::NumBits(n);
+
+    for (long j = 0; j < k; j++) {
+      bool addToRes = NTL::bit(n, j);
+      bool doubling = (j < k - 1);
+
+      // If we need two rotations of acc, break it into digits only once
+      std::vector<std::shared_ptr<BasicAutomorphPrecon>> precon;
+      if (hoist && addToRes && resLen > 0 && doubling) {
+        precon.resize(acc.size());
+        NTL_EXEC_RANGE(lsize(acc), first, last)
+        for (long t = first; t < last; t++)
+          precon[t] = std::make_shared<BasicAutomorphPrecon>(acc[t]);
+        NTL_EXEC_RANGE_END
+      }
+
+      if (addToRes) {
+        if (resLen == 0) {
+          res = acc;
+        } else {
+          std::vector<Ctxt> tmp;
+          rotateValue1D(tmp, acc, precon, ea, i, resLen);
+          op(res, tmp); // res = res op (acc >>> resLen)
+        }
+        resLen += 1L << j;
+      }
+
+      if (doubling) {
+        std::vector<Ctxt> tmp;
+        rotateValue1D(tmp, acc, precon, ea, i, 1L << j);
+        op(acc, tmp); // acc = acc op (acc >>> 2^j)
+      }
     }
+    v.swap(res);
   }
 }
 
+void allSlotsReduce(const EncryptedArray& ea,
+                    Ctxt& ctxt,
+                    const std::function<void(Ctxt&, const Ctxt&)>& op)
+{
+  std::vector<Ctxt> v(1, ctxt);
+  allSlotsReduce(ea,
+                 v,
+                 [&op](std::vector<Ctxt>& acc, std::vector<Ctxt>& other) {
+                   op(acc[0], other[0]);
+                 });
+  ctxt = v[0];
+}
+
+void totalSums(const EncryptedArray& ea, Ctxt& ctxt)
+{
+  allSlotsReduce(ea, ctxt, [](Ctxt& acc, const Ctxt& other) {
+    acc += other;
+  });
+}
+
+void totalProducts(const EncryptedArray& ea, Ctxt& ctxt)
+{
+  allSlotsReduce(ea, ctxt, [](Ctxt& acc, const Ctxt& other) {
+    acc.multiplyBy(other);
+  });
+}
+
 // Linearized polynomials.
 // L describes a linear map M by describing its action on the standard
 // power basis: M(x^j mod G) = (L[j] mod G), for j = 0..d-1.
@@ -9,8 +9,11 @@
  * See the License for the specific language governing permissions and
  * limitations under the License. See accompanying LICENSE file.
  */
+#include <sstream>
 #include <helib/EvalMap.h>
 #include <helib/apiAttributes.h>
+#include <helib/binio.h>
+#include <NTL/BasicThreadPool.h>
 
 // needed to get NTL's TraceMap functions...needed for ThinEvalMap
 #include <NTL/lzz_pXFactoring.h>
@@ -37,6 +40,79 @@ static void init_representatives(NTL::Vec<long>& representatives,
                                  const NTL::Vec<long>& mvec,
                                  const PAlgebra& zMStar);
 
+// The on-disk cache of the constants
+
+static std::string evalMapCacheDir;
+
+void setEvalMapCacheDir(const std::string& dir) { evalMapCacheDir = dir; }
+
+const std::string& getEvalMapCacheDir() { return evalMapCacheDir; }
+
+NTL::ZZX getG(const EncryptedArray& ea); // defined in Context.cpp
+
+static bool useEvalMapCache(bool build_cache)
+{
+  return build_cache && !evalMapCacheDir.empty() && !isDryRun();
+}
+
+// Everything the constants of a map depend on
+static std::string evalMapCacheHeader(const std::string& kind,
+                                      const EncryptedArray& ea,
+                                      const NTL::Vec<long>& mvec,
+                                      bool invert,
+                                      bool minimal,
+                                      bool normal_basis)
+{
+  const PAlgebra& zMStar = ea.getPAlgebra();
+  const Context& context = ea.getContext();
+  std::ostringstream str;
+  str << kind;
+  write_raw_int(str, zMStar.getM());
+  write_raw_int(str, zMStar.getP());
+  write_raw_int(str, ea.getP2R());
+  write_raw_int(str, zMStar.numOfGens());
+  for (long i = 0; i < zMStar.numOfGens(); i++) {
+    write_raw_int(str, zMStar.ZmStarGen(i));
+    write_raw_int(str,
+                  zMStar.SameOrd(i) ? zMStar.OrderOf(i) : -zMStar.OrderOf(i));
+  }
+  write_raw_int(str, mvec.length());
+  for (long i = 0; i < mvec.length(); i++)
+    write_raw_int(str, mvec[i]);
+  write_raw_int(str, invert);
+  write_raw_int(str, minimal);
+  write_raw_int(str, normal_basis);
+  write_raw_int(str, fhe_test_force_bsgs); // changes the giant steps
+
+  NTL::ZZX G = getG(ea);
+  write_raw_int(str, deg(G) + 1);
+  for (long i = 0; i <= deg(G); i++)
+    write_raw_int(str, NTL::conv<long>(coeff(G, i)));
+
+  for (long i : context.allPrimes())
+    write_raw_int(str, context.ithPrime(i));
+  return str.str();
+}
+
+// The file name records the main parameters, and a hash of the header
+// to tell apart the maps of contexts that differ in other ways
+static std::string evalMapCacheFile(const std::string& kind,
+                                    const EncryptedArray& ea,
+                                    bool invert,
+                                    const std::string& header)
+{
+  unsigned long long hash = 14695981039346656037ULL; // 64-bit FNV-1a
+  for (unsigned char c : header) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  std::ostringstream name;
+  name << evalMapCacheDir << "/" << kind << "-m" << ea.getPAlgebra().getM()
+       << "-p" << ea.getP2R() << (invert ? "-inv-" : "-") << std::hex << hash
+       << ".bin";
+  return name.str();
+}
+
 // Constructor: initializing tables for the evaluation-map transformations
 
 EvalMap::EvalMap(const EncryptedArray& _ea,
@@ -107,6 +183,16 @@ EvalMap::EvalMap(const EncryptedArray& _ea,
   if (inertPrefix != nfactors - 1)
     throw LogicError("EvalMap: case not handled: bad inertPrefix");
 
+  // Look for the constants in the on-disk cache first
+  std::string cacheHeader, cacheFile;
+  if (useEvalMapCache(build_cache)) {
+    cacheHeader =
+        evalMapCacheHeader("evalmap", ea, mvec, invert, minimal, normal_basis);
+    cacheFile = evalMapCacheFile("evalmap", ea, invert, cacheHeader);
+    if (readCache(cacheFile, cacheHeader))
+      return;
+  }
+
   NTL::Vec<NTL::Vec<long>> local_reps(NTL::INIT_SIZE, nfactors);
   for (long i = 0; i < nfactors; i++)
     init_representatives(local_reps[i], i, mvec, zMStar);
@@ -156,7 +242,11 @@ EvalMap::EvalMap(const EncryptedArray& _ea,
     matvec[dim].reset(new MatMul1DExec(*mat_data, minimal));
   }
 
-  if (build_cache)
+  // With a cache, write the constants and map them back rather than
+  // upgrading them in private memory
+  if (build_cache &&
+      (cacheFile.empty() || !writeCache(cacheFile, cacheHeader) ||
+       !readCache(cacheFile, cacheHeader)))
     upgrade();
 }
 
@@ -167,6 +257,45 @@ void EvalMap::upgrade()
     matvec[i]->upgrade();
 }
 
+void EvalMap::setStreaming(long window)
+{
+  mat1->setStreaming(window);
+  for (long i = 0; i < matvec.length(); i++)
+    matvec[i]->setStreaming(window);
+}
+
+bool EvalMap::readCache(const std::string& fileName, const std::string& header)
+{
+  HELIB_NTIMER_START(readEvalMapCache);
+
+  // The file holds mat1 followed by matvec
+  auto execs = readMappedExecs(fileName, header, ea);
+  if (lsize(execs) != nfactors ||
+      !dynamic_cast<BlockMatMul1DExec*>(execs[0].get()))
+    return false;
+  for (long i = 1; i < nfactors; i++)
+    if (!dynamic_cast<MatMul1DExec*>(execs[i].get()))
+      return false;
+
+  mat1.reset(static_cast<BlockMatMul1DExec*>(execs[0].release()));
+  matvec.SetLength(nfactors - 1);
+  for (long i = 0; i < nfactors - 1; i++)
+    matvec[i].reset(static_cast<MatMul1DExec*>(execs[i + 1].release()));
+  mapped = true;
+  return true;
+}
+
+bool EvalMap::writeCache(const std::string& fileName,
+                         const std::string& header) const
+{
+  HELIB_NTIMER_START(writeEvalMapCache);
+
+  std::vector<const MatMulExecBase*> execs(1, mat1.get());
+  for (long i = 0; i < matvec.length(); i++)
+    execs.push_back(matvec[i].get());
+  return writeMappedExecs(fileName, header, execs);
+}
+
 // Applying the evaluation (or its inverse) map to a ciphertext
 void EvalMap::apply(Ctxt& ctxt) const
 {
@@ -183,6 +312,21 @@ void EvalMap::apply(Ctxt& ctxt) const
   }
 }
 
+void EvalMap::applyMany(std::vector<Ctxt>& v) const
+{
+  if (!invert) { // forward direction
+    mat1->mulMany(v);
+
+    for (long i = matvec.length() - 1; i >= 0; i--)
+      matvec[i]->mulMany(v);
+  } else { // inverse transformation
+    for (long i = 0; i < matvec.length(); i++)
+      matvec[i]->mulMany(v);
+
+    mat1->mulMany(v);
+  }
+}
+
 static void init_representatives(NTL::Vec<long>& representatives,
                                  long dim,
                                  const NTL::Vec<long>& mvec,
@@ -573,6 +717,20 @@ ThinEvalMap::ThinEvalMap(const EncryptedArray& _ea,
   if (inertPrefix != nfactors - 1)
     throw LogicError("ThinEvalMap: case not handled: bad inertPrefix");
 
+  // Look for the constants in the on-disk cache first
+  std::string cacheHeader, cacheFile;
+  if (useEvalMapCache(build_cache)) {
+    cacheHeader = evalMapCacheHeader("thinevalmap",
+                                     ea,
+                                     mvec,
+                                     invert,
+                                     minimal,
+                                     /*normal_basis=*/false);
+    cacheFile = evalMapCacheFile("thinevalmap", ea, invert, cacheHeader);
+    if (readCache(cacheFile, cacheHeader))
+      return;
+  }
+
   NTL::Vec<NTL::Vec<long>> local_reps(NTL::INIT_SIZE, nfactors);
   for (long i = 0; i < nfactors; i++)
     init_representatives(local_reps[i], i, mvec, zMStar);
@@ -634,7 +792,11 @@ ThinEvalMap::ThinEvalMap(const EncryptedArray& _ea,
     matvec[dim].reset(new MatMul1DExec(*mat_data, minimal));
   }
 
-  if (build_cache)
+  // With a cache, write the constants and map them back rather than
+  // upgrading them in private memory
+  if (build_cache &&
+      (cacheFile.empty() || !writeCache(cacheFile, cacheHeader) ||
+       !readCache(cacheFile, cacheHeader)))
     upgrade();
 }
 
@@ -645,6 +807,44 @@ void ThinEvalMap::upgrade()
       matvec[i]->upgrade();
 }
 
+void ThinEvalMap::setStreaming(long window)
+{
+  for (long i = 0; i < matvec.length(); i++)
+    if (matvec[i])
+      matvec[i]->setStreaming(window);
+}
+
+bool ThinEvalMap::readCache(const std::string& fileName,
+                            const std::string& header)
+{
+  HELIB_NTIMER_START(readThinEvalMapCache);
+
+  // Only the last entry of matvec may be null
+  auto execs = readMappedExecs(fileName, header, ea);
+  if (lsize(execs) != nfactors)
+    return false;
+  for (long i = 0; i < nfactors - 1; i++)
+    if (!execs[i])
+      return false;
+
+  matvec.SetLength(nfactors);
+  for (long i = 0; i < nfactors; i++)
+    matvec[i] = std::move(execs[i]);
+  mapped = true;
+  return true;
+}
+
+bool ThinEvalMap::writeCache(const std::string& fileName,
+                             const std::string& header) const
+{
+  HELIB_NTIMER_START(writeThinEvalMapCache);
+
+  std::vector<const MatMulExecBase*> execs;
+  for (long i = 0; i < matvec.length(); i++)
+    execs.push_back(matvec[i].get());
+  return writeMappedExecs(fileName, header, execs);
+}
+
 // Applying the evaluation (or its inverse) map to a ciphertext
 void ThinEvalMap::apply(Ctxt& ctxt) const
 {
@@ -659,6 +859,23 @@ void ThinEvalMap::apply(Ctxt& ctxt) const
   }
 }
 
+void ThinEvalMap::applyMany(std::vector<Ctxt>& v) const
+{
+  if (!invert) { // forward direction
+    for (long i = matvec.length() - 1; i >= 0; i--)
+      if (matvec[i])
+        matvec[i]->mulMany(v);
+  } else { // inverse transformation
+    for (long i = 0; i < matvec.length(); i++)
+      matvec[i]->mulMany(v);
+
+    NTL_EXEC_RANGE(lsize(v), first, last)
+    for (long i : range(first, last))
+      traceMap(v[i]);
+    NTL_EXEC_RANGE_END
+  }
+}
+
 // The callback interface for the matrix-multiplication routines.
 
 //! \cond FALSE (make doxygen ignore these classes)
@@ -14,6 +14,7 @@
 #include <cmath>
 
 #include <helib/PAlgebra.h>
+#include <helib/binio.h>
 #include <helib/hypercube.h>
 #include <helib/timing.h>
 
@@ -22,6 +23,11 @@
 #include <NTL/lzz_pEXFactoring.h>
 #include <NTL/BasicThreadPool.h>
 #include <mutex> // std::mutex, std::unique_lock
+#include <unordered_map>
+#include <cstdio>  // std::rename, std::remove
+#include <fstream>
+#include <random>
+#include <sstream>
 
 namespace helib {
 
@@ -644,6 +650,43 @@ PAlgebraModBase* buildPAlgebraMod(const PAlgebra& zMStar, long r)
     return new PAlgebraModDerived<PA_zz_p>(zMStar, r);
 }
 
+PAlgebraMod::PAlgebraMod(const PAlgebra& _zMStar, long _r) :
+    zMStar(&_zMStar), r(_r), disabled(false)
+{
+  long p = _zMStar.getP();
+
+  if (p == -1) { // complex plaintext space, nothing to precompute
+    rep = std::shared_ptr<const PAlgebraModBase>(buildPAlgebraMod(_zMStar, r));
+    tag = PA_cx_tag;
+    pPowR = rep->getPPowR();
+    return;
+  }
+
+  // The cheap checks are done right away, so that bad parameters are
+  // reported by the constructor and not on first use of the tables
+  assertTrue<InvalidArgument>(p >= 2,
+                              "Modulus p is less than 2 (nor -1 for CKKS)");
+  assertTrue<InvalidArgument>(r > 0, "Hensel lifting r is less than 1");
+  NTL::ZZ BigPPowR = NTL::power_ZZ(p, r);
+  assertTrue((bool)BigPPowR.SinglePrecision(),
+             "BigPPowR is not SinglePrecision");
+  pPowR = NTL::to_long(BigPPowR);
+  tag = (p == 2 && r == 1) ? PA_GF2_tag : PA_zz_p_tag;
+
+  // The tables are built with the dry-run flag as it is now, which
+  // matters for programs that turn it on after building their context
+  bool dryRun = isDryRun();
+  const PAlgebra* palg = zMStar;
+  long rr = r;
+  rep = LazyPtr<const PAlgebraModBase>([palg, rr, dryRun] {
+    DryRunGuard guard(dryRun);
+    return std::shared_ptr<const PAlgebraModBase>(buildPAlgebraMod(*palg, rr));
+  });
+
+  if (dryRun) // the dry-run tables are tiny, no point in waiting
+    rep.shared();
+}
+
 template <typename T>
 void PAlgebraLift(const NTL::ZZX& phimx,
                   const T& lfactors,
@@ -686,6 +729,24 @@ PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar, long _r) :
 
   RBak bak;
   bak.save();
+
+  // Look for the tables in the on-disk cache first
+  SetModulus(pPowR);
+  pPowRContext.save();
+  if (readTableCache()) {
+    RX phimxmod;
+    conv(phimxmod, zMStar.getPhimX());
+    build(PhimXMod, phimxmod);
+
+    resize(factorsOverZZ, nSlots);
+    for (long i = 0; i < nSlots; i++)
+      conv(factorsOverZZ[i], factors[i]);
+
+    buildTree(crtTree, 0, nSlots);
+    genNttTable();
+    return;
+  }
+
   SetModulus(p);
 
   // Compute the factors Ft of Phi_m(X) mod p, for all t \in T
@@ -710,13 +771,18 @@ PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar, long _r) :
   // The remaining factors are ordered according to their representatives.
 
   RXModulus F1(localFactors[0]);
-  for (long i = 1; i < nSlots; i++) {
+  RContext pContext;
+  pContext.save();
+  NTL_EXEC_RANGE(nSlots - 1, lo, hi)
+  pContext.restore();
+  for (long i = lo + 1; i < hi + 1; i++) {
     long t = zMStar.ith_rep(i);      // Ft is minimal poly of x^{1/t} mod F1
     long tInv = NTL::InvMod(t, m);   // tInv = t^{-1} mod m
     RX X2tInv = PowerXMod(tInv, F1); // X2tInv = X^{1/t} mod F1
     NTL::IrredPolyMod(localFactors[i], X2tInv, F1);
     // IrredPolyMod(X,P,Q) returns in X the minimal polynomial of P mod Q
   }
+  NTL_EXEC_RANGE_END
   /* Debugging sanity-check #1: we should have Ft= GCD(F1(X^t),Phi_m(X))
   for (i=1; i<nSlots; i++) {
     long t = T[i];
@@ -735,11 +801,14 @@ PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar, long _r) :
 
     // Compute the CRT coefficients for the Ft's
     resize(crtCoeffs, nSlots);
-    for (long i = 0; i < nSlots; i++) {
+    NTL_EXEC_RANGE(nSlots, first, last)
+    pPowRContext.restore();
+    for (long i = first; i < last; i++) {
       RX te = phimxmod / factors[i];        // \prod_{j\ne i} Fj
       te %= factors[i];                     // \prod_{j\ne i} Fj mod Fi
       InvMod(crtCoeffs[i], te, factors[i]); // \prod_{j\ne i} Fj^{-1} mod Fi
     }
+    NTL_EXEC_RANGE_END
   } else {
     PAlgebraLift(zMStar.getPhimX(), localFactors, factors, crtCoeffs, r);
     RX phimxmod1;
@@ -755,6 +824,187 @@ PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar, long _r) :
 
   genCrtTable();
   genMaskTable();
+  genNttTable();
+
+  writeTableCache();
+}
+
+// The on-disk cache of the PAlgebraMod tables
+
+// Bump this whenever the format of the cache files changes
+#define PALGEBRAMOD_CACHE_VERSION 1
+
+static std::string pAlgebraModCacheDir;
+
+void setPAlgebraModCacheDir(const std::string& dir)
+{
+  pAlgebraModCacheDir = dir;
+}
+
+const std::string& getPAlgebraModCacheDir() { return pAlgebraModCacheDir; }
+
+// The coefficients of a polynomial over GF2 or zz_p, lowest first
+template <typename RX>
+static void writeRX(std::ostream& str, const RX& f)
+{
+  long n = deg(f) + 1;
+  write_raw_int(str, n);
+  for (long i = 0; i < n; i++)
+    write_raw_int(str, rep(coeff(f, i)));
+}
+
+template <typename RX>
+static void readRX(std::istream& str, RX& f)
+{
+  long n = read_raw_int(str);
+  if (!str || n < 0 || n > (1L << 40))
+    throw RuntimeError("Bad polynomial length");
+  std::vector<long> c(n);
+  for (long i = 0; i < n; i++)
+    c[i] = read_raw_int(str);
+  clear(f);
+  for (long i = n - 1; i >= 0; i--) // high coefficients first
+    SetCoeff(f, i, c[i]);
+}
+
+// V is either vec_RX or std::vector<RX>
+template <typename V>
+static void writeVecRX(std::ostream& str, const V& v)
+{
+  write_raw_int(str, lsize(v));
+  for (long i = 0; i < lsize(v); i++)
+    writeRX(str, v[i]);
+}
+
+template <typename V>
+static void readVecRX(std::istream& str, V& v, long expected)
+{
+  long n = read_raw_int(str);
+  if (n != expected)
+    throw RuntimeError("Bad table length");
+  resize(v, n);
+  for (long i = 0; i < n; i++)
+    readRX(str, v[i]);
+}
+
+// Writes the key (m, p, r, gens, ords), with the orders of the bad
+// dimensions negated as in the Context constructor
+static void writeCacheKey(std::ostream& str,
+                          const PAlgebra& zMStar,
+                          long r,
+                          PA_tag tag)
+{
+  write_raw_int(str, PALGEBRAMOD_CACHE_VERSION);
+  write_raw_int(str, tag);
+  write_raw_int(str, zMStar.getM());
+  write_raw_int(str, zMStar.getP());
+  write_raw_int(str, r);
+  write_raw_int(str, zMStar.numOfGens());
+  for (long i = 0; i < zMStar.numOfGens(); i++) {
+    write_raw_int(str, zMStar.ZmStarGen(i));
+    write_raw_int(str, zMStar.SameOrd(i) ? zMStar.OrderOf(i)
+                                         : -zMStar.OrderOf(i));
+  }
+}
+
+template <typename type>
+std::string PAlgebraModDerived<type>::tableCacheFile() const
+{
+  std::ostringstream name;
+  name << pAlgebraModCacheDir << "/palgebramod-m" << zMStar.getM() << "-p"
+       << zMStar.getP() << "-r" << r << "-g";
+  for (long i = 0; i < zMStar.numOfGens(); i++)
+    name << (i ? "_" : "") << zMStar.ZmStarGen(i);
+  name << "-o";
+  for (long i = 0; i < zMStar.numOfGens(); i++)
+    name << (i ? "_" : "")
+         << (zMStar.SameOrd(i) ? zMStar.OrderOf(i) : -zMStar.OrderOf(i));
+  name << ".bin";
+  return name.str();
+}
+
+template <typename type>
+bool PAlgebraModDerived<type>::readTableCache()
+{
+  if (pAlgebraModCacheDir.empty() || isDryRun())
+    return false;
+  std::ifstream str(tableCacheFile(), std::ios::binary);
+  if (!str.is_open())
+    return false;
+  HELIB_NTIMER_START(readPAlgebraModCache);
+
+  // Compare with the key we would have written
+  std::ostringstream expectedKey;
+  writeCacheKey(expectedKey, zMStar, r, tag);
+  const std::string& key = expectedKey.str();
+  std::string fileKey(key.size(), '\0');
+  if (readEyeCatcher(str, BINIO_EYE_PALGEBRAMOD_BEGIN) != 0 ||
+      !str.read(&fileKey[0], fileKey.size()) || fileKey != key)
+    return false; // stale or corrupt file, it will be overwritten
+
+  long nSlots = zMStar.getNSlots();
+  vec_RX newFactors, newCrtCoeffs;
+  std::vector<RX> newCrtTable;
+  std::vector<std::vector<RX>> newMaskTable(zMStar.numOfGens());
+  try {
+    readVecRX(str, newFactors, nSlots);
+    readVecRX(str, newCrtCoeffs, nSlots);
+    readVecRX(str, newCrtTable, nSlots);
+    for (long i = 0; i < zMStar.numOfGens(); i++)
+      readVecRX(str, newMaskTable[i], zMStar.OrderOf(i) + 1);
+  } catch (const RuntimeError&) {
+    return false;
+  }
+  if (!str || readEyeCatcher(str, BINIO_EYE_PALGEBRAMOD_END) != 0)
+    return false;
+
+  // A cheap sanity check: the degrees of the factors must add up to phi(m)
+  long degSum = 0;
+  for (long i = 0; i < nSlots; i++)
+    degSum += deg(newFactors[i]);
+  if (degSum != zMStar.getPhiM())
+    return false;
+
+  factors.swap(newFactors);
+  crtCoeffs.swap(newCrtCoeffs);
+  crtTable.swap(newCrtTable);
+  maskTable.swap(newMaskTable);
+  return true;
+}
+
+template <typename type>
+void PAlgebraModDerived<type>::writeTableCache() const
+{
+  if (pAlgebraModCacheDir.empty() || isDryRun())
+    return;
+  HELIB_NTIMER_START(writePAlgebraModCache);
+
+  // Write to a temporary file then rename it, so that concurrent readers
+  // never see a partial file
+  std::string fileName = tableCacheFile();
+  std::ostringstream tmpName;
+  tmpName << fileName << ".tmp" << std::random_device{}();
+  {
+    std::ofstream str(tmpName.str(), std::ios::binary);
+    if (!str.is_open())
+      return; // the cache is best-effort
+
+    writeEyeCatcher(str, BINIO_EYE_PALGEBRAMOD_BEGIN);
+    writeCacheKey(str, zMStar, r, tag);
+    writeVecRX(str, factors);
+    writeVecRX(str, crtCoeffs);
+    writeVecRX(str, crtTable);
+    for (const auto& masks : maskTable)
+      writeVecRX(str, masks);
+    writeEyeCatcher(str, BINIO_EYE_PALGEBRAMOD_END);
+    if (!str.flush()) {
+      str.close();
+      std::remove(tmpName.str().c_str());
+      return;
+    }
+  }
+  if (std::rename(tmpName.str().c_str(), fileName.c_str()) != 0)
+    std::remove(tmpName.str().c_str());
 }
 
 // Assumes current zz_p modulus is p^r
@@ -858,12 +1108,17 @@ void PAlgebraLift(const NTL::ZZX& phimx,
 
   // Finally compute the CRT coefficients for the factors
   resize(crtc, nSlots);
-  for (long i = 0; i < nSlots; i++) {
+  NTL::zz_pContext context;
+  context.save();
+  NTL_EXEC_RANGE(nSlots, first, last)
+  context.restore();
+  for (long i = first; i < last; i++) {
     NTL::zz_pX& fct = factors[i];
     NTL::zz_pX te = phimxmod / fct;   // \prod_{j\ne i} Fj
     te %= fct;                        // \prod_{j\ne i} Fj mod Fi
     InvModpr(crtc[i], te, fct, p, r); // \prod_{j\ne i} Fj^{-1} mod Fi
   }
+  NTL_EXEC_RANGE_END
 }
 
 // Returns a vector crt[] such that crt[i] = p mod Ft (with t = T[i])
@@ -878,6 +1133,23 @@ void PAlgebraModDerived<type>::CRT_decompose(std::vector<RX>& crt,
     return;
   }
   resize(crt, nSlots);
+
+  if (!slotExps.empty()) { // crt[i] = H(omega^slotExps[i])
+    long m = zMStar.getM();
+    vec_R x, y;
+    if (deg(H) < m)
+      VectorCopy(x, H, m);
+    else {
+      RX tmp;
+      rem(tmp, H, PhimXMod);
+      VectorCopy(x, tmp, m);
+    }
+    slotDFT(y, x, /*inverse=*/false);
+    for (long i = 0; i < nSlots; i++)
+      conv(crt[i], y[slotExps[i]]);
+    return;
+  }
+
   for (long i = 0; i < nSlots; i++)
     rem(crt[i], H, factors[i]); // crt[i] = H % factors[i]
 }
@@ -1000,6 +1272,25 @@ void PAlgebraModDerived<type>::CRT_reconstruct(RX& H,
   HELIB_TIMER_START;
   long nslots = zMStar.getNSlots();
 
+  if (!slotExps.empty()) {
+    // Set the values at the primitive roots, and zero at the others, then
+    // interpolate with an inverse DFT and reduce mod Phi_m(X)
+    long m = zMStar.getM();
+    vec_R x, y;
+    x.SetLength(m); // initialized to zero
+    for (long i = 0; i < nslots; i++) {
+      R val;
+      eval(val, crt[i], -ConstTerm(factors[i])); // crt[i] mod factors[i]
+      x[slotExps[i]] = val;
+    }
+    slotDFT(y, x, /*inverse=*/true);
+    conv(H, y);
+    mul(H, H, mInv);
+    rem(H, H, PhimXMod);
+    HELIB_TIMER_STOP;
+    return;
+  }
+
   const std::vector<RX>& ctab = crtTable;
 
   clear(H);
@@ -1298,21 +1589,30 @@ void PAlgebraModDerived<type>::genMaskTable()
 {
   // This is only called by the constructor, which has already
   // set the zz_p context and the crtTable
-  resize(maskTable, zMStar.numOfGens());
-  for (long i = 0; i < (long)zMStar.numOfGens(); i++) {
+  long nGens = zMStar.numOfGens();
+  long nSlots = zMStar.getNSlots();
+  resize(maskTable, nGens);
+  for (long i = 0; i < nGens; i++) {
     long ord = zMStar.OrderOf(i);
     resize(maskTable[i], ord + 1);
-    maskTable[i][ord] = 0;
-    for (long j = ord - 1; j >= 1; j--) {
-      // initialize mask that is 1 whenever the ith coordinate is at least j
-      // Note: maskTable[i][0] = constant 1, maskTable[i][ord] = constant 0
-      maskTable[i][j] = maskTable[i][j + 1];
-      for (long k = 0; k < (long)zMStar.getNSlots(); k++) {
-        if (zMStar.coordinate(i, k) == j) {
+
+    // First the mask that is 1 exactly when the ith coordinate is j, for all
+    // j in parallel (each slot only contributes to one of them)
+    NTL_EXEC_RANGE(ord - 1, first, last)
+    pPowRContext.restore();
+    for (long j = first + 1; j < last + 1; j++) {
+      clear(maskTable[i][j]);
+      for (long k = 0; k < nSlots; k++)
+        if (zMStar.coordinate(i, k) == j)
           add(maskTable[i][j], maskTable[i][j], crtTable[k]);
-        }
-      }
     }
+    NTL_EXEC_RANGE_END
+
+    // Then the mask that is 1 whenever the ith coordinate is at least j
+    // Note: maskTable[i][0] = constant 1, maskTable[i][ord] = constant 0
+    maskTable[i][ord] = 0;
+    for (long j = ord - 2; j >= 1; j--)
+      add(maskTable[i][j], maskTable[i][j], maskTable[i][j + 1]);
     maskTable[i][0] = 1;
   }
 }
@@ -1328,15 +1628,104 @@ void PAlgebraModDerived<type>::genCrtTable()
 
   long nslots = zMStar.getNSlots();
   resize(crtTable, nslots);
-  for (long i = 0; i < nslots; i++) {
+  NTL_EXEC_RANGE(nslots, first, last)
+  pPowRContext.restore();
+  for (long i = first; i < last; i++) {
     RX allBut_i = PhimXMod / factors[i]; // = \prod_{j \ne i }Fj
     allBut_i *= crtCoeffs[i]; // = 1 mod Fi and = 0 mod Fj for j \ne i
     crtTable[i] = allBut_i;
   }
+  NTL_EXEC_RANGE_END
 
   buildTree(crtTree, 0, nslots);
 }
 
+template <typename type>
+void PAlgebraModDerived<type>::genNttTable()
+{
+  // This is only called by the constructor, which has already
+  // set the zz_p context to p^r and computed the factors
+
+  long m = zMStar.getM();
+  long nslots = zMStar.getNSlots();
+
+  slotExps.clear();
+  if (isDryRun() || zMStar.getOrdP() != 1 || m < 2)
+    return;
+  for (long i = 0; i < nslots; i++)
+    if (deg(factors[i]) != 1)
+      return;
+
+  // The root of F1 is a primitive m-th root of unity mod p^r, and the roots
+  // of all the other factors are powers of it.
+  R omega = -ConstTerm(factors[0]);
+  vec_R pows;
+  pows.SetLength(m);
+  std::unordered_map<long, long> expOf; // rep(omega^e) -> e
+  R pw;
+  set(pw);
+  for (long e = 0; e < m; e++) {
+    pows[e] = pw;
+    expOf[rep(pw)] = e;
+    mul(pw, pw, omega);
+  }
+
+  std::vector<long> exps(nslots);
+  for (long i = 0; i < nslots; i++) {
+    R root = -ConstTerm(factors[i]);
+    auto it = expOf.find(rep(root));
+    if (it == expOf.end())
+      return; // should not happen, use the generic code
+    exps[i] = it->second;
+  }
+
+  nttTwist.SetLength(m);
+  nttTwistInv.SetLength(m);
+  clear(nttChirp);
+  clear(nttChirpInv);
+  for (long n = 2 * m - 2; n >= 0; n--) { // high coefficients first
+    long c = ((n * (n - 1)) / 2) % m;     // C(n,2) mod m
+    long cNeg = (m - c) % m;
+    if (n < m) {
+      nttTwist[n] = pows[cNeg];
+      nttTwistInv[n] = pows[c];
+    }
+    SetCoeff(nttChirp, n, pows[c]);
+    SetCoeff(nttChirpInv, n, pows[cNeg]);
+  }
+
+  // p does not divide m, since p^r splits Phi_m(X)
+  conv(mInv, m);
+  inv(mInv, mInv);
+
+  slotExps.swap(exps);
+}
+
+template <typename type>
+void PAlgebraModDerived<type>::slotDFT(vec_R& y,
+                                       const vec_R& x,
+                                       bool inverse) const
+{
+  HELIB_TIMER_START;
+  long m = zMStar.getM();
+  const vec_R& twist = inverse ? nttTwistInv : nttTwist;
+  const RX& chirp = inverse ? nttChirpInv : nttChirp;
+
+  // With omega^{jk} = omega^{C(j+k,2)} omega^{-C(j,2)} omega^{-C(k,2)},
+  // y[k] = twist[k] * sum_j (x[j] twist[j]) chirp[j+k], which is the
+  // coefficient of X^{m-1+k} in a(X)*chirp(X), a(X) = sum_j x[j] twist[j]
+  // X^{m-1-j}.
+  RX a, c;
+  long n = std::min(x.length(), m);
+  for (long j = 0; j < n; j++) // high coefficients first
+    SetCoeff(a, m - 1 - j, x[j] * twist[j]);
+  mul(c, a, chirp);
+
+  y.SetLength(m);
+  for (long k = 0; k < m; k++)
+    y[k] = coeff(c, m - 1 + k) * twist[k];
+}
+
 template <typename type>
 void PAlgebraModDerived<type>::buildTree(std::shared_ptr<TNode<RX>>& res,
                                          long offset,
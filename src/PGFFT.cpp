@@ -36,18 +36,11 @@ See below for more details.
 
 #ifndef PGFFT_DISABLE_SIMD
 
-#ifdef __AVX__
-#define HAVE_AVX
-//#warning "HAVE_AVX"
-#endif
-
-#ifdef __AVX2__
-#define HAVE_AVX2
-//#warning "HAVE_AVX2"
-#endif
-
-#if defined(HAVE_AVX) || defined(HAVE_AVX2)
-#define USE_PD4
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+#define PGFFT_SIMD
+// The AVX2 and AVX-512 kernels are compiled through target attributes,
+// whatever the -m flags, and the ones to use are chosen at runtime
+// according to the CPU (see simd_detect below).
 #endif
 
 #endif
@@ -59,9 +52,21 @@ See below for more details.
 #include <cassert>
 #include <cstdlib>
 #include <limits>
+#include <atomic>
+#include <algorithm>
+
+#include <NTL/BasicThreadPool.h>
 
-#ifdef USE_PD4
+#ifdef HELIB_THREADS
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#ifdef PGFFT_SIMD
 #include <immintrin.h>
+
+#define PGFFT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define PGFFT_TARGET_AVX512 __attribute__((target("avx512f")))
 #endif
 
 namespace helib {
@@ -76,11 +81,35 @@ typedef complex<double> cmplx_t;
 typedef long double ldbl;
 //typedef double ldbl;
 
-#ifdef USE_PD4
-bool PGFFT::simd_enabled() { return true; }
-#else
-bool PGFFT::simd_enabled() { return false; }
+static PGFFT::simd_path
+simd_detect()
+{
+#ifdef PGFFT_SIMD
+   // NOTE: besides CPUID, this checks that the OS saves the
+   // corresponding registers
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f"))
+      return PGFFT::SIMD_AVX512;
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return PGFFT::SIMD_AVX2;
 #endif
+   return PGFFT::SIMD_NONE;
+}
+
+// the best path supported by the CPU, and the one in use
+static const int simd_max = simd_detect();
+static std::atomic<int> simd_level(simd_max);
+
+PGFFT::simd_path PGFFT::simd_enabled()
+{
+   return simd_path(simd_level.load(std::memory_order_relaxed));
+}
+
+PGFFT::simd_path PGFFT::set_simd_path(simd_path path)
+{
+   simd_level.store(std::min(int(path), simd_max), std::memory_order_relaxed);
+   return simd_enabled();
+}
 
 
 #if (PGFFT_USE_EXPLICIT_MUL)
@@ -126,7 +155,7 @@ CMUL(cmplx_t a, cmplx_t b)
 
 **************************************************************/
 
-#ifdef USE_PD4
+#ifdef PGFFT_SIMD
 
 #define PGFFT_ALIGN (64)
 
@@ -195,149 +224,211 @@ namespace {
 
 //=================== PD4 implementation ===============
 
-#if defined(USE_PD4)
+// PD4 (4 doubles, or 2 complex numbers) is implemented with AVX2 and FMA,
+// and PD8 (8 doubles, or 4 complex numbers) with AVX-512F.
+// Every function using them is compiled for the corresponding target,
+// and may only be called if simd_level says that the CPU supports it.
+
+#if defined(PGFFT_SIMD)
 
 struct PD4 {
    __m256d data;
 
 
    PD4() = default;
-   PD4(double x) : data(_mm256_set1_pd(x)) { }
-   PD4(__m256d _data) : data(_data) { }
-   PD4(double d0, double d1, double d2, double d3)
+   PGFFT_TARGET_AVX2 PD4(double x) : data(_mm256_set1_pd(x)) { }
+   PGFFT_TARGET_AVX2 PD4(__m256d _data) : data(_data) { }
+   PGFFT_TARGET_AVX2 PD4(double d0, double d1, double d2, double d3)
       : data(_mm256_set_pd(d3, d2, d1, d0)) { }
 
+   PGFFT_TARGET_AVX2
    static PD4 load(const double *p) { return _mm256_load_pd(p); }
 
    // load from unaligned address
+   PGFFT_TARGET_AVX2
    static PD4 loadu(const double *p) { return _mm256_loadu_pd(p); }
 };
 
-inline void
+PGFFT_TARGET_AVX2 inline void
 load(PD4& x, const double *p)
 { x = PD4::load(p); }
 
 // load from unaligned address
-inline void
+PGFFT_TARGET_AVX2 inline void
 loadu(PD4& x, const double *p)
 { x = PD4::loadu(p); }
 
-inline void
+PGFFT_TARGET_AVX2 inline void
 store(double *p, PD4 a)
 { _mm256_store_pd(p, a.data); }
 
 // store to unaligned address
-inline void
+PGFFT_TARGET_AVX2 inline void
 storeu(double *p, PD4 a)
 { _mm256_storeu_pd(p, a.data); }
 
 
 // swap even/odd slots
 // e.g., 0123 -> 1032
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 swap2(PD4 a)
 { return _mm256_permute_pd(a.data, 0x5); }
 
 // 0123 -> 0022
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 dup2even(PD4 a)
 { return _mm256_permute_pd(a.data, 0);   }
 
 // 0123 -> 1133
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 dup2odd(PD4 a)
 { return _mm256_permute_pd(a.data, 0xf);   }
 
 // blend even/odd slots
 // 0123, 4567 -> 0527
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 blend2(PD4 a, PD4 b)
 { return _mm256_blend_pd(a.data, b.data, 0xa); }
 
 // 0123, 4567 -> 0426
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 blend_even(PD4 a, PD4 b)
 { return _mm256_unpacklo_pd(a.data, b.data); }
 
 
 // 0123, 4567 -> 1537
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 blend_odd(PD4 a, PD4 b)
 { return _mm256_unpackhi_pd(a.data, b.data); }
 
 
-inline void
+PGFFT_TARGET_AVX2 inline void
 clear(PD4& x)
 { x.data = _mm256_setzero_pd(); }
 
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 operator+(PD4 a, PD4 b)
 { return _mm256_add_pd(a.data, b.data); }
 
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 operator-(PD4 a, PD4 b)
 { return _mm256_sub_pd(a.data, b.data); }
 
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 operator*(PD4 a, PD4 b)
 { return _mm256_mul_pd(a.data, b.data); }
 
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 operator/(PD4 a, PD4 b)
 { return _mm256_div_pd(a.data, b.data); }
 
-inline PD4&
+PGFFT_TARGET_AVX2 inline PD4&
 operator+=(PD4& a, PD4 b)
 { a = a + b; return a; }
 
-inline PD4&
+PGFFT_TARGET_AVX2 inline PD4&
 operator-=(PD4& a, PD4 b)
 { a = a - b; return a; }
 
-inline PD4&
+PGFFT_TARGET_AVX2 inline PD4&
 operator*=(PD4& a, PD4 b)
 { a = a * b; return a; }
 
-inline PD4&
+PGFFT_TARGET_AVX2 inline PD4&
 operator/=(PD4& a, PD4 b)
 { a = a / b; return a; }
 
-#ifdef HAVE_AVX2
-
 // a*b+c (fused)
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 fused_muladd(PD4 a, PD4 b, PD4 c)
 { return _mm256_fmadd_pd(a.data, b.data, c.data); }
-// NEEDS: FMA
 
 // a*b-c (fused)
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 fused_mulsub(PD4 a, PD4 b, PD4 c)
 { return _mm256_fmsub_pd(a.data, b.data, c.data); }
-// NEEDS: FMA
 
 // -a*b+c (fused)
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 fused_negmuladd(PD4 a, PD4 b, PD4 c)
 { return _mm256_fnmadd_pd(a.data, b.data, c.data); }
-// NEEDS: FMA
 
 // (a0,a1,a2,a3), (b0,b1,b2,b3), (c0,c1,c2,c3) ->
 // (a0*b0-c0, a1*b1+c1, a2*b2-c2, a3*b3+c3)
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 fmaddsub(PD4 a, PD4 b, PD4 c)
 { return _mm256_fmaddsub_pd(a.data, b.data, c.data); }
-// NEEDS: FMA
-// (plain addsub only needs AVX)
 
 // (a0,a1,a2,a3), (b0,b1,b2,b3), (c0,c1,c2,c3) ->
 // (a0*b0+c0, a1*b1-c1, a2*b2+c2, a3*b3-c3)
-inline PD4
+PGFFT_TARGET_AVX2 inline PD4
 fmsubadd(PD4 a, PD4 b, PD4 c)
 { return _mm256_fmsubadd_pd(a.data, b.data, c.data); }
-// NEEDS: FMA
-// (there is no plain subadd)
-#endif
+
+
+
+//=================== PD8 implementation ===============
+
+// Only what the kernels below need.
+// In some versions of gcc, the unmasked forms of loadu, shuffle, movedup
+// and unpackhi pass _mm512_undefined_pd() as the source of the masked-off
+// lanes, which -Wmaybe-uninitialized reports. The masked forms below, with
+// all the lanes selected, compute the same thing from defined sources.
+
+struct PD8 {
+   __m512d data;
+
+
+   PD8() = default;
+   PGFFT_TARGET_AVX512 PD8(__m512d _data) : data(_data) { }
+
+   // NOTE: PD8 loads and stores do not require alignment, as the
+   // kernels only guarantee 32-byte alignment
+   PGFFT_TARGET_AVX512
+   static PD8 load(const double *p) { return _mm512_maskz_loadu_pd(0xff, p); }
+};
+
+PGFFT_TARGET_AVX512 inline void
+store(double *p, PD8 a)
+{ _mm512_storeu_pd(p, a.data); }
+
+// swap even/odd slots
+// 01234567 -> 10325476
+PGFFT_TARGET_AVX512 inline PD8
+swap2(PD8 a)
+{ return _mm512_mask_shuffle_pd(a.data, 0xff, a.data, a.data, 0x55); }
+
+// 01234567 -> 00224466
+PGFFT_TARGET_AVX512 inline PD8
+dup2even(PD8 a)
+{ return _mm512_mask_movedup_pd(a.data, 0xff, a.data); }
+
+// 01234567 -> 11335577
+PGFFT_TARGET_AVX512 inline PD8
+dup2odd(PD8 a)
+{ return _mm512_mask_unpackhi_pd(a.data, 0xff, a.data, a.data); }
+
+PGFFT_TARGET_AVX512 inline PD8
+operator+(PD8 a, PD8 b)
+{ return _mm512_add_pd(a.data, b.data); }
+
+PGFFT_TARGET_AVX512 inline PD8
+operator-(PD8 a, PD8 b)
+{ return _mm512_sub_pd(a.data, b.data); }
+
+PGFFT_TARGET_AVX512 inline PD8
+operator*(PD8 a, PD8 b)
+{ return _mm512_mul_pd(a.data, b.data); }
+
+// (a0*b0-c0, a1*b1+c1, ...)
+PGFFT_TARGET_AVX512 inline PD8
+fmaddsub(PD8 a, PD8 b, PD8 c)
+{ return _mm512_fmaddsub_pd(a.data, b.data, c.data); }
+
+// (a0*b0+c0, a1*b1-c1, ...)
+PGFFT_TARGET_AVX512 inline PD8
+fmsubadd(PD8 a, PD8 b, PD8 c)
+{ return _mm512_fmsubadd_pd(a.data, b.data, c.data); }
 
 
 #endif
@@ -510,11 +601,9 @@ do  \
 
 
 
-#ifdef USE_PD4
-
-#ifdef HAVE_AVX2
+#ifdef PGFFT_SIMD
 
-static inline PD4
+PGFFT_TARGET_AVX2 static inline PD4
 complex_mul(PD4 ab, PD4 cd)
 {
    PD4 cc = dup2even(cd);
@@ -523,7 +612,7 @@ complex_mul(PD4 ab, PD4 cd)
    return fmaddsub(ab, cc, ba*dd);
 }
 
-static inline PD4
+PGFFT_TARGET_AVX2 static inline PD4
 complex_conj_mul(PD4 ab, PD4 cd)
 // (ac+bd,bc-ad)
 {
@@ -533,6 +622,25 @@ complex_conj_mul(PD4 ab, PD4 cd)
    return fmsubadd(ab, cc, ba*dd);
 }
 
+PGFFT_TARGET_AVX512 static inline PD8
+complex_mul(PD8 ab, PD8 cd)
+{
+   PD8 cc = dup2even(cd);
+   PD8 dd = dup2odd(cd);
+   PD8 ba = swap2(ab);
+   return fmaddsub(ab, cc, ba*dd);
+}
+
+PGFFT_TARGET_AVX512 static inline PD8
+complex_conj_mul(PD8 ab, PD8 cd)
+// (ac+bd,bc-ad)
+{
+   PD8 cc = dup2even(cd);
+   PD8 dd = dup2odd(cd);
+   PD8 ba = swap2(ab);
+   return fmsubadd(ab, cc, ba*dd);
+}
+
 
 #define MUL2(x_0, x_1, a_0, a_1, b_0, b_1) \
 do { \
@@ -546,44 +654,10 @@ do { \
    x_1 = complex_conj_mul(a_1, b_1); \
 } while (0)
 
-#else
-// This code sequence works without FMA
-#define MUL2(x_0, x_1, a_0, a_1, b_0, b_1) \
-do { \
-    PD4 a_re_ = blend_even(a_0, a_1); \
-    PD4 a_im_ = blend_odd(a_0, a_1); \
- \
-    PD4 b_re_ = blend_even(b_0, b_1); \
-    PD4 b_im_ = blend_odd(b_0, b_1); \
- \
-    PD4 x_re_ = a_re_*b_re_ - a_im_*b_im_; \
-    PD4 x_im_ = a_re_*b_im_ + a_im_*b_re_; \
- \
-    x_0 = blend_even(x_re_, x_im_); \
-    x_1 = blend_odd(x_re_, x_im_); \
-} while (0)
-
-#define CMUL2(x_0, x_1, a_0, a_1, b_0, b_1) \
-do { \
-    PD4 a_re_ = blend_even(a_0, a_1); \
-    PD4 a_im_ = blend_odd(a_0, a_1); \
- \
-    PD4 b_re_ = blend_even(b_0, b_1); \
-    PD4 b_im_ = blend_odd(b_0, b_1); \
- \
-    PD4 x_re_ = a_re_*b_re_ + a_im_*b_im_; \
-    PD4 x_im_ = a_im_*b_re_ - a_re_*b_im_; \
- \
-    x_0 = blend_even(x_re_, x_im_); \
-    x_1 = blend_odd(x_re_, x_im_); \
-} while (0)
-
-#endif
-
 
 
-static inline void
-fwd_butterfly_loop_simd(
+PGFFT_TARGET_AVX2 static void
+fwd_butterfly_loop_avx2(
    long size,
    double * RESTRICT xp0,
    double * RESTRICT xp1,
@@ -613,23 +687,8 @@ fwd_butterfly_loop_simd(
   }
 }
 
-static inline void
-fwd_butterfly_loop(
-   long size,
-   cmplx_t * RESTRICT xp0,
-   cmplx_t * RESTRICT xp1,
-   const cmplx_t * RESTRICT wtab)
-{
-   // NOTE: C++11 guarantees that these reinterpret_cast's work as expected
-   fwd_butterfly_loop_simd(
-      size,
-      reinterpret_cast<double*>(xp0),
-      reinterpret_cast<double*>(xp1),
-      reinterpret_cast<const double*>(wtab));
-}
-
-static inline void
-inv_butterfly_loop_simd(
+PGFFT_TARGET_AVX2 static void
+inv_butterfly_loop_avx2(
    long size,
    double * RESTRICT xp0,
    double * RESTRICT xp1,
@@ -659,25 +718,87 @@ inv_butterfly_loop_simd(
   }
 }
 
-static inline void
-inv_butterfly_loop(
+PGFFT_TARGET_AVX2 static void
+mul_loop_avx2(
    long size,
-   cmplx_t * RESTRICT xp0,
-   cmplx_t * RESTRICT xp1,
-   const cmplx_t * RESTRICT wtab)
+   double * RESTRICT xp,
+   const double * yp)
 {
-   // NOTE: C++11 guarantees that these reinterpret_cast's work as expected
-   inv_butterfly_loop_simd(
-      size,
-      reinterpret_cast<double*>(xp0),
-      reinterpret_cast<double*>(xp1),
-      reinterpret_cast<const double*>(wtab));
+  long j;
+  for (j = 0; j < size; j += 4) {
+    PD4 x_0 = PD4::load(xp+2*(j+0));
+    PD4 x_1 = PD4::load(xp+2*(j+2));
+    PD4 y_0 = PD4::load(yp+2*(j+0));
+    PD4 y_1 = PD4::load(yp+2*(j+2));
+
+    PD4 z_0, z_1;
+    MUL2(z_0, z_1, x_0, x_1, y_0, y_1);
+
+    store(xp+2*(j+0), z_0);
+    store(xp+2*(j+2), z_1);
+  }
 }
 
-#else
+
+// The AVX-512 kernels process 4 complex numbers (one PD8) at a time, so
+// they have the same requirement on size (a multiple of 4) as the
+// AVX2 ones.
+
+PGFFT_TARGET_AVX512 static void
+fwd_butterfly_loop_avx512(
+   long size,
+   double * RESTRICT xp0,
+   double * RESTRICT xp1,
+   const double * RESTRICT wtab)
+{
+  for (long j = 0; j < size; j += 4) {
+    PD8 x0 = PD8::load(xp0+2*j);
+    PD8 x1 = PD8::load(xp1+2*j);
+    PD8 w  = PD8::load(wtab+2*j);
+
+    store(xp0+2*j, x0 + x1);
+    store(xp1+2*j, complex_mul(x0 - x1, w));
+  }
+}
+
+PGFFT_TARGET_AVX512 static void
+inv_butterfly_loop_avx512(
+   long size,
+   double * RESTRICT xp0,
+   double * RESTRICT xp1,
+   const double * RESTRICT wtab)
+{
+  for (long j = 0; j < size; j += 4) {
+    PD8 x0 = PD8::load(xp0+2*j);
+    PD8 x1 = PD8::load(xp1+2*j);
+    PD8 w  = PD8::load(wtab+2*j);
+
+    PD8 t = complex_conj_mul(x1, w);
+
+    store(xp0+2*j, x0 + t);
+    store(xp1+2*j, x0 - t);
+  }
+}
+
+PGFFT_TARGET_AVX512 static void
+mul_loop_avx512(
+   long size,
+   double * RESTRICT xp,
+   const double * yp)
+{
+  for (long j = 0; j < size; j += 4) {
+    PD8 x = PD8::load(xp+2*j);
+    PD8 y = PD8::load(yp+2*j);
+    store(xp+2*j, complex_mul(x, y));
+  }
+}
+
+#endif
+
+
 
 static inline void
-fwd_butterfly_loop(
+fwd_butterfly_loop_scalar(
    long size,
    cmplx_t * RESTRICT xp0,
    cmplx_t * RESTRICT xp1,
@@ -696,7 +817,7 @@ fwd_butterfly_loop(
 }
 
 static inline void
-inv_butterfly_loop(
+inv_butterfly_loop_scalar(
    long size,
    cmplx_t * RESTRICT xp0,
    cmplx_t * RESTRICT xp1,
@@ -714,50 +835,65 @@ inv_butterfly_loop(
    }
 }
 
-#endif
+static inline void
+mul_loop_scalar(
+   long size,
+   cmplx_t * xp,
+   const cmplx_t * yp)
+{
+  for (long j = 0; j < size; j++)
+    xp[j] = MUL(xp[j], yp[j]);
+}
 
 
-#if (defined(USE_PD4))
 
+// The kernels used by the rest of the code, which dispatch on simd_level.
+// NOTE: C++11 guarantees that the reinterpret_cast's work as expected
 
-static inline void
-mul_loop_simd(
-   long size,
-   double * RESTRICT xp,
-   const double * yp)
-{
-  long j;
-  for (j = 0; j < size; j += 4) {
-    PD4 x_0 = PD4::load(xp+2*(j+0));
-    PD4 x_1 = PD4::load(xp+2*(j+2));
-    PD4 y_0 = PD4::load(yp+2*(j+0));
-    PD4 y_1 = PD4::load(yp+2*(j+2));
+#ifdef PGFFT_SIMD
 
-    PD4 z_0, z_1;
-    MUL2(z_0, z_1, x_0, x_1, y_0, y_1);
+#define PGFFT_DISPATCH(kernel, ...) \
+do { \
+   switch (simd_level.load(std::memory_order_relaxed)) { \
+   case PGFFT::SIMD_AVX512: kernel##_avx512(__VA_ARGS__); return; \
+   case PGFFT::SIMD_AVX2:   kernel##_avx2(__VA_ARGS__);   return; \
+   default: ; \
+   } \
+} while (0)
 
-    store(xp+2*(j+0), z_0);
-    store(xp+2*(j+2), z_1);
-  }
-}
+#define PGFFT_D(p) reinterpret_cast<double*>(p)
+#define PGFFT_CD(p) reinterpret_cast<const double*>(p)
+
+#else
+
+#define PGFFT_DISPATCH(kernel, ...) do { } while (0)
+
+#endif
 
 
 static inline void
-mul_loop(
+fwd_butterfly_loop(
    long size,
-   cmplx_t * xp,
-   const cmplx_t * yp)
+   cmplx_t * RESTRICT xp0,
+   cmplx_t * RESTRICT xp1,
+   const cmplx_t * RESTRICT wtab)
 {
-   // NOTE: C++11 guarantees that these reinterpret_cast's work as expected
-   mul_loop_simd(
-      size,
-      reinterpret_cast<double*>(xp),
-      reinterpret_cast<const double*>(yp));
+   PGFFT_DISPATCH(fwd_butterfly_loop,
+                  size, PGFFT_D(xp0), PGFFT_D(xp1), PGFFT_CD(wtab));
+   fwd_butterfly_loop_scalar(size, xp0, xp1, wtab);
 }
 
-
-#else
-
+static inline void
+inv_butterfly_loop(
+   long size,
+   cmplx_t * RESTRICT xp0,
+   cmplx_t * RESTRICT xp1,
+   const cmplx_t * RESTRICT wtab)
+{
+   PGFFT_DISPATCH(inv_butterfly_loop,
+                  size, PGFFT_D(xp0), PGFFT_D(xp1), PGFFT_CD(wtab));
+   inv_butterfly_loop_scalar(size, xp0, xp1, wtab);
+}
 
 static inline void
 mul_loop(
@@ -765,12 +901,10 @@ mul_loop(
    cmplx_t * xp,
    const cmplx_t * yp)
 {
-  for (long j = 0; j < size; j++)
-    xp[j] = MUL(xp[j], yp[j]);
+   PGFFT_DISPATCH(mul_loop, size, PGFFT_D(xp), PGFFT_CD(yp));
+   mul_loop_scalar(size, xp, yp);
 }
 
-#endif
-
 
 // requires size divisible by 8
 static void
@@ -1242,16 +1376,7 @@ COBRA(cmplx_t * RESTRICT B, const cmplx_t * RESTRICT A, long k,
          long a1 = rev_q[a];
          cmplx_t *T_p = &T[a1 << q];
          const cmplx_t *A_p = &A[(a << (k1+q)) + (b << q)];
-#ifdef USE_PD4
-         for (long c = 0; c < (1 << q); c += 4) {
-            PD4 x0 = PD4::load(reinterpret_cast<const double*>(&A_p[c+0]));
-            PD4 x1 = PD4::load(reinterpret_cast<const double*>(&A_p[c+2]));
-            store(reinterpret_cast<double*>(&T_p[c+0]), x0);
-            store(reinterpret_cast<double*>(&T_p[c+2]), x1);
-         }
-#else
          for (long c = 0; c < (1L << q); c++) T_p[c] = A_p[c];
-#endif
       }
 
       for (long c = 0; c < (1L << q); c++) {
@@ -1289,23 +1414,131 @@ pow2_precomp(long n, vector<long>& rev, vector<long>& rev1, vector<aligned_vecto
    return k;
 }
 
+// x is an aligned scratch buffer of size n
 static void
 pow2_comp(const cmplx_t* src, cmplx_t* dst,
                   long n, long k, const vector<long>& rev, const vector<long>& rev1,
-                  const vector<aligned_vector<cmplx_t>>& tab)
+                  const vector<aligned_vector<cmplx_t>>& tab, cmplx_t* x)
 {
-   aligned_vector<cmplx_t> x;
-   x.assign(src, src+n);
+   for (long i = 0; i < n; i++) x[i] = src[i];
 
-   new_fft(&x[0], k, tab);
+   new_fft(x, k, tab);
 #if 0
    for (long i = 0; i < n; i++) dst[i] = x[i];
 #else
    if (k <= PGFFT_BRC_THRESH)
-      BasicBitReverseCopy(&dst[0], &x[0], k, rev);
+      BasicBitReverseCopy(&dst[0], x, k, rev);
    else
-      COBRA(&dst[0], &x[0], k, rev, rev1);
+      COBRA(&dst[0], x, k, rev, rev1);
+#endif
+}
+
+
+#define PGFFT_MT_THRESH (14)
+// apply_mt only splits power-of-two transforms of at least
+// 2^PGFFT_MT_THRESH points
+
+#define PGFFT_MT_MAX_LOG_THREADS (4)
+// and never uses more than 2^PGFFT_MT_MAX_LOG_THREADS threads
+
+
+#ifdef HELIB_THREADS
+// Blocks each of nthreads threads in wait() until all of them are there.
+class Barrier {
+public:
+   explicit Barrier(long _nthreads) :
+      nthreads(_nthreads), count(0), gen(0) { }
+
+   void wait()
+   {
+      std::unique_lock<std::mutex> lck(mtx);
+      long my_gen = gen;
+      if (++count == nthreads) {
+         count = 0;
+         gen++;
+         cv.notify_all();
+      }
+      else
+         cv.wait(lck, [&] { return gen != my_gen; });
+   }
+
+private:
+   const long nthreads;
+   long count;
+   long gen;
+   std::mutex mtx;
+   std::condition_variable cv;
+};
+#endif
+
+
+// Same as fwd_butterfly_loop, restricted to the indices [first, first+size).
+// first and size should be multiples of 4.
+static inline void
+fwd_butterfly_range(long first, long size,
+                    cmplx_t* xp0, cmplx_t* xp1, const cmplx_t* wtab)
+{
+   // the scalar loop assumes wtab[0] == 1
+   if (first == 0 || simd_level.load(std::memory_order_relaxed)) {
+      fwd_butterfly_loop(size, xp0+first, xp1+first, wtab+first);
+      return;
+   }
+
+   for (long j = first; j < first+size; j++)
+      fwd_butterfly(xp0[j], xp1[j], wtab[j]);
+}
+
+
+// Multi-threaded version of pow2_comp, with 2^t threads of NTL's pool.
+// The first t layers of the FFT are split evenly between the threads, after
+// which the 2^t blocks of size 2^(k-t) are independent, and each thread
+// transforms one of them. The same threads do all the layers, waiting for
+// each other at a barrier between two layers.
+// REQUIREMENT: k-2*t >= 2, and the pool is idle with at least 2^t threads,
+// so that the tasks of NTL_EXEC_INDEX all run at the same time
+static void
+pow2_comp_mt(const cmplx_t* src, cmplx_t* dst,
+                  long n, long k, const vector<long>& rev, const vector<long>& rev1,
+                  const vector<aligned_vector<cmplx_t>>& tab, long t)
+{
+   long nthreads = 1L << t;
+
+   aligned_vector<cmplx_t> x;
+   x.assign(src, src+n);
+   cmplx_t* xp = &x[0];
+
+   // thread i's share of layer j, which has 2^(k-j) blocks
+   auto layer = [&](long i, long j) {
+      long half = 1L << (j-1);
+      long chunk = half >> t;
+      const cmplx_t* wtab = &tab[j][0];
+      for (long b = 0; b < (1L << (k-j)); b++) {
+         cmplx_t* xp0 = xp + 2*half*b;
+         fwd_butterfly_range(chunk*i, chunk, xp0, xp0+half, wtab);
+      }
+   };
+
+   long k1 = k-t;
+
+#ifdef HELIB_THREADS
+   Barrier barrier(nthreads);
+   NTL_EXEC_INDEX(nthreads, i)
+      for (long j = k; j > k-t; j--) {
+         layer(i, j);
+         barrier.wait();
+      }
+      new_fft(xp + (i << k1), k1, tab);
+   NTL_EXEC_INDEX_END
+#else
+   for (long j = k; j > k-t; j--)
+      for (long i = 0; i < nthreads; i++) layer(i, j);
+   for (long i = 0; i < nthreads; i++) new_fft(xp + (i << k1), k1, tab);
 #endif
+
+   if (k <= PGFFT_BRC_THRESH)
+      BasicBitReverseCopy(&dst[0], xp, k, rev);
+   else
+      COBRA(&dst[0], xp, k, rev, rev1);
 }
 
 static long
@@ -1355,16 +1588,15 @@ bluestein_precomp(long n, aligned_vector<cmplx_t>& powers,
 }
 
 
+// x is an aligned scratch buffer of size 2^k
 static void
 bluestein_comp(const cmplx_t* src, cmplx_t* dst,
                   long n, long k, const aligned_vector<cmplx_t>& powers,
                   const aligned_vector<cmplx_t>& Rb,
-                  const vector<aligned_vector<cmplx_t>>& tab)
+                  const vector<aligned_vector<cmplx_t>>& tab, cmplx_t* x)
 {
    long N = 1L << k;
 
-   aligned_vector<cmplx_t> x(N);
-
    for (long i = 0; i < n; i++)
       x[i] = MUL(src[i], powers[i]);
 
@@ -1457,16 +1689,15 @@ bluestein_precomp1(long n, aligned_vector<cmplx_t>& powers,
 }
 
 
+// x is an aligned scratch buffer of size 2^k
 static void
 bluestein_comp1(const cmplx_t* src, cmplx_t* dst,
                   long n, long k, const aligned_vector<cmplx_t>& powers,
                   const aligned_vector<cmplx_t>& Rb,
-                  const vector<aligned_vector<cmplx_t>>& tab)
+                  const vector<aligned_vector<cmplx_t>>& tab, cmplx_t* x)
 {
    long N = 1L << k;
 
-   aligned_vector<cmplx_t> x(N);
-
    for (long i = 0; i < n; i++)
       x[i] = MUL(src[i], powers[i]);
 
@@ -1548,23 +1779,41 @@ PGFFT::PGFFT(long n_)
    }
 }
 
-void PGFFT::apply(const cmplx_t* src, cmplx_t* dst) const
+long PGFFT::scratch_size() const
+{
+   switch (strategy) {
+
+   case PGFFT_STRATEGY_POW2:
+      return n;
+
+   case PGFFT_STRATEGY_BLUE:
+   case PGFFT_STRATEGY_TBLUE:
+      return 1L << k;
+
+   default:
+      return 0;
+
+   }
+}
+
+void PGFFT::apply_buf(const cmplx_t* src, cmplx_t* dst, cmplx_t* x) const
 {
    switch (strategy) {
 
    case PGFFT_STRATEGY_NULL:
+      dst[0] = src[0];
       break;
 
    case PGFFT_STRATEGY_POW2:
-      pow2_comp(src, dst, n, k, rev, rev1, tab);
+      pow2_comp(src, dst, n, k, rev, rev1, tab, x);
       break;
 
    case PGFFT_STRATEGY_BLUE:
-      bluestein_comp(src, dst, n, k, powers, Rb, tab);
+      bluestein_comp(src, dst, n, k, powers, Rb, tab, x);
       break;
 
    case PGFFT_STRATEGY_TBLUE:
-      bluestein_comp1(src, dst, n, k, powers, Rb, tab);
+      bluestein_comp1(src, dst, n, k, powers, Rb, tab, x);
       break;
 
    default: ;
@@ -1572,6 +1821,44 @@ void PGFFT::apply(const cmplx_t* src, cmplx_t* dst) const
    }
 }
 
+void PGFFT::apply(const cmplx_t* src, cmplx_t* dst) const
+{
+   aligned_vector<cmplx_t> x(scratch_size());
+   apply_buf(src, dst, x.data());
+}
+
+void PGFFT::apply_batch(const cmplx_t* src, cmplx_t* dst,
+                        long count, long stride) const
+{
+   assert(count >= 0 && stride >= n);
+
+   // one scratch buffer for the whole batch
+   aligned_vector<cmplx_t> x(scratch_size());
+   for (long i = 0; i < count; i++)
+      apply_buf(src + i*stride, dst + i*stride, x.data());
+}
+
+void PGFFT::apply_mt(const cmplx_t* src, cmplx_t* dst, long nthreads) const
+{
+   // The threads come from NTL's pool, which has only one available
+   // thread while it is busy
+   nthreads = std::min(nthreads, NTL::AvailableThreads());
+
+   // t = floor(log2(nthreads)), capped so that k-2*t >= 2 for
+   // all k >= PGFFT_MT_THRESH
+   long t = 0;
+   while (t < PGFFT_MT_MAX_LOG_THREADS && (2L << t) <= nthreads) t++;
+
+#ifdef HELIB_THREADS
+   if (strategy == PGFFT_STRATEGY_POW2 && k >= PGFFT_MT_THRESH && t > 0) {
+      pow2_comp_mt(src, dst, n, k, rev, rev1, tab, t);
+      return;
+   }
+#endif
+
+   apply(src, dst);
+}
+
 }
 
 
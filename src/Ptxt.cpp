@@ -29,22 +29,156 @@ std::complex<double> Ptxt<CKKS>::convertToSlot(const Context&, long slot)
   return {static_cast<double>(slot), 0};
 }
 
+namespace {
+
+// The value of a BGV slot as an integer in [0, p^r), when d = 1
+long compactOf(const PolyMod& slot)
+{
+  return mcMod(static_cast<long>(slot), slot.getp2r());
+}
+
+long compactOf(UNUSED const std::complex<double>& slot)
+{
+  throw LogicError("CKKS Ptxt has no compact form");
+}
+
+// Slot-wise kernels mod q on the compact form, all values are in [0, q)
+void addModVec(long* x, const long* y, long n, long q)
+{
+  for (long i = 0; i < n; i++)
+    x[i] = NTL::AddMod(x[i], y[i], q);
+}
+
+void subModVec(long* x, const long* y, long n, long q)
+{
+  for (long i = 0; i < n; i++)
+    x[i] = NTL::SubMod(x[i], y[i], q);
+}
+
+void mulModVec(long* x, const long* y, long n, long q)
+{
+  NTL::mulmod_t qinv = NTL::PrepMulMod(q);
+  for (long i = 0; i < n; i++)
+    x[i] = NTL::MulMod(x[i], y[i], q, qinv);
+}
+
+void addModScalar(long* x, long c, long n, long q)
+{
+  for (long i = 0; i < n; i++)
+    x[i] = NTL::AddMod(x[i], c, q);
+}
+
+void mulModScalar(long* x, long c, long n, long q)
+{
+  NTL::mulmod_precon_t cqinv = NTL::PrepMulModPrecon(c, q);
+  for (long i = 0; i < n; i++)
+    x[i] = NTL::MulModPrecon(x[i], c, q, cqinv);
+}
+
+} // namespace
+
+template <>
+bool Ptxt<BGV>::compactable() const
+{
+  return context->zMStar.getOrdP() == 1 &&
+         context->slotRing->p2r < NTL_SP_BOUND;
+}
+
+template <>
+bool Ptxt<CKKS>::compactable() const
+{
+  return false;
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::makeCompact()
+{
+  if (compact || !compactable())
+    return;
+  std::vector<long> data(slots.size());
+  for (std::size_t i = 0; i < slots.size(); ++i)
+    data[i] = compactOf(slots[i]);
+  setCompactData(std::move(data));
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::expand()
+{
+  if (!compact)
+    return;
+  if (view.valid) {
+    slots = std::move(view.slots);
+  } else {
+    slots.reserve(compactSlots.size());
+    for (long x : compactSlots)
+      slots.push_back(Ptxt<Scheme>::convertToSlot(*context, x));
+  }
+  view.clear();
+  std::vector<long>().swap(compactSlots);
+  compact = false;
+}
+
+template <typename Scheme>
+const std::vector<long>& Ptxt<Scheme>::compactData(
+    std::vector<long>& tmp) const
+{
+  if (compact)
+    return compactSlots;
+  tmp.resize(slots.size());
+  for (std::size_t i = 0; i < slots.size(); ++i)
+    tmp[i] = compactOf(slots[i]);
+  return tmp;
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::setCompactData(std::vector<long>&& data)
+{
+  compactSlots = std::move(data);
+  std::vector<SlotType>().swap(slots);
+  compact = true;
+  view.clear();
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::permute(const std::vector<long>& src)
+{
+  makeCompact();
+  if (compact) {
+    std::vector<long> new_slots(src.size());
+    for (std::size_t i = 0; i < src.size(); ++i)
+      new_slots[i] = (src[i] < 0) ? 0 : compactSlots[src[i]];
+    compactSlots = std::move(new_slots);
+    view.clear();
+    return;
+  }
+  // Copying in slots to avoid default PolyMod issues.
+  std::vector<SlotType> new_slots(slots);
+  for (std::size_t i = 0; i < src.size(); ++i) {
+    if (src[i] < 0)
+      new_slots[i] = 0;
+    else
+      new_slots[i] = slots[src[i]];
+  }
+  slots = std::move(new_slots);
+}
+
 template <typename Scheme>
 Ptxt<Scheme>::Ptxt() : context(nullptr)
 {}
 
 template <typename Scheme>
-Ptxt<Scheme>::Ptxt(const Context& context) :
-    context(&context),
-    slots(context.ea->size(),
-          SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)})
-{}
+Ptxt<Scheme>::Ptxt(const Context& context) : context(&context)
+{
+  if (compactable())
+    setCompactData(std::vector<long>(context.ea->size(), 0));
+  else
+    slots.assign(context.ea->size(),
+                 SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)});
+}
 
 template <typename Scheme>
 Ptxt<Scheme>::Ptxt(const Context& context, const SlotType& value) :
-    context(std::addressof(context)),
-    slots(context.ea->size(),
-          SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)})
+    Ptxt<Scheme>(context)
 {
   setData(value);
 }
@@ -63,18 +197,14 @@ void Ptxt<BGV>::setData(const NTL::ZZX& value)
 template <>
 template <>
 Ptxt<BGV>::Ptxt(const Context& context, const NTL::ZZX& value) :
-    context(&context),
-    slots(context.ea->size(),
-          SlotType{Ptxt<BGV>::convertToSlot(*(this->context), 0L)})
+    Ptxt<BGV>(context)
 {
   setData(value);
 }
 
 template <typename Scheme>
 Ptxt<Scheme>::Ptxt(const Context& context, const std::vector<SlotType>& data) :
-    context(std::addressof(context)),
-    slots(context.ea->size(),
-          SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)})
+    Ptxt<Scheme>(context)
 {
   setData(data);
 }
@@ -90,7 +220,7 @@ size_t Ptxt<Scheme>::size() const
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call size on default-constructed Ptxt");
-  return this->slots.size();
+  return compact ? compactSlots.size() : slots.size();
 }
 
 template <typename Scheme>
@@ -112,6 +242,14 @@ void Ptxt<Scheme>::setData(const std::vector<SlotType>& data)
   // Need to verify that they all match
   assertSlotsCompatible(data);
 
+  if (compactable()) {
+    std::vector<long> values(context->ea->size(), 0);
+    for (std::size_t i = 0; i < data.size(); ++i)
+      values[i] = compactOf(data[i]);
+    setCompactData(std::move(values));
+    return;
+  }
+
   slots = data;
   if (helib::lsize(slots) < context->ea->size()) {
     slots.resize(context->ea->size(),
@@ -124,6 +262,11 @@ void Ptxt<Scheme>::setData(const SlotType& value)
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call setData on default-constructed Ptxt");
+  if (compactable()) {
+    assertSlotsCompatible(std::vector<SlotType>(1, value));
+    setCompactData(std::vector<long>(context->ea->size(), compactOf(value)));
+    return;
+  }
   setData(std::vector<SlotType>(context->ea->size(), value));
 }
 
@@ -134,6 +277,12 @@ void Ptxt<BGV>::decodeSetData(const NTL::ZZX& data)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call decodeSetData on default-constructed Ptxt");
+  if (compactable()) {
+    std::vector<long> values;
+    context->ea->decode(values, data);
+    setCompactData(std::move(values));
+    return;
+  }
   PolyMod poly(context->slotRing);
   std::vector<PolyMod> poly_vec(context->ea->size(), poly);
   std::vector<NTL::ZZX> ptxt(context->ea->size());
@@ -147,6 +296,10 @@ void Ptxt<BGV>::decodeSetData(const NTL::ZZX& data)
 template <typename Scheme>
 void Ptxt<Scheme>::clear()
 {
+  if (compactable()) {
+    setCompactData(std::vector<long>(size(), 0));
+    return;
+  }
   for (auto& slot : this->slots) {
     slot = 0;
   }
@@ -175,6 +328,12 @@ CKKS::SlotType randomSlot<CKKS>(UNUSED const Context& context)
 template <typename Scheme>
 Ptxt<Scheme>& Ptxt<Scheme>::random()
 {
+  if (compactable()) {
+    std::vector<long> values(size());
+    NTL::VectorRandomBnd(values.size(), values.data(), context->slotRing->p2r);
+    setCompactData(std::move(values));
+    return *this;
+  }
   for (auto& slot : slots)
     slot = randomSlot<Scheme>(*context);
   return *this;
@@ -187,7 +346,16 @@ const std::vector<typename Ptxt<Scheme>::SlotType>& Ptxt<Scheme>::getSlotRepr()
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call getSlotRepr on default-constructed Ptxt");
-  return slots;
+  if (!compact)
+    return slots;
+  HELIB_MUTEX_GUARD(view.mtx);
+  if (!view.valid) {
+    view.slots.reserve(compactSlots.size());
+    for (long x : compactSlots)
+      view.slots.push_back(Ptxt<Scheme>::convertToSlot(*context, x));
+    view.valid = true;
+  }
+  return view.slots;
 }
 
 /**
@@ -201,6 +369,10 @@ NTL::ZZX Ptxt<BGV>::getPolyRepr() const
   assertTrue<LogicError>(isValid(),
                          "Cannot call getPolyRepr on default-constructed Ptxt");
   NTL::ZZX repr;
+  if (compact) {
+    context->ea->encode(repr, compactSlots);
+    return repr;
+  }
   std::vector<NTL::ZZX> slots_data(context->ea->size());
   for (std::size_t i = 0; i < slots_data.size(); ++i) {
     slots_data[i] = slots[i].getData();
@@ -230,6 +402,7 @@ typename Ptxt<Scheme>::SlotType& Ptxt<Scheme>::operator[](long i)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot access elements of default-constructed Ptxt");
+  expand();
   return this->slots[i];
 }
 
@@ -239,6 +412,8 @@ typename Ptxt<Scheme>::SlotType Ptxt<Scheme>::operator[](long i) const
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot access elements of default-constructed Ptxt");
+  if (compact)
+    return Ptxt<Scheme>::convertToSlot(*context, compactSlots[i]);
   return this->slots[i];
 }
 
@@ -259,8 +434,13 @@ typename Ptxt<Scheme>::SlotType Ptxt<Scheme>::at(long i) const
 template <typename Scheme>
 bool Ptxt<Scheme>::operator==(const Ptxt<Scheme>& other) const
 {
-  return (!isValid() && !other.isValid()) ||
-         (this->slots == other.slots && *(this->context) == *(other.context));
+  if (!isValid() || !other.isValid())
+    return !isValid() && !other.isValid();
+  if (!(*(this->context) == *(other.context)))
+    return false;
+  if (compact && other.compact)
+    return compactSlots == other.compactSlots;
+  return getSlotRepr() == other.getSlotRepr();
 }
 
 template <typename Scheme>
@@ -333,6 +513,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator*=(const Ptxt<Scheme>& otherPtxt)
   assertEq<LogicError>(*context,
                        *(otherPtxt.context),
                        "Ptxts must have matching contexts");
+  makeCompact();
+  if (compact) {
+    std::vector<long> tmp;
+    const std::vector<long>& other = otherPtxt.compactData(tmp);
+    mulModVec(compactSlots.data(), other.data(), lsize(), context->slotRing->p2r);
+    view.clear();
+    return *this;
+  }
   for (unsigned i = 0; i < this->slots.size(); i++) {
     this->slots[i] *= otherPtxt.slots[i];
   }
@@ -345,6 +533,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator*=(const SlotType& scalar)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call operator*= on default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    assertSlotsCompatible(std::vector<SlotType>(1, scalar));
+    long q = context->slotRing->p2r;
+    mulModScalar(compactSlots.data(), compactOf(scalar), lsize(), q);
+    view.clear();
+    return *this;
+  }
   for (auto& x : this->slots)
     x *= scalar;
   return *this;
@@ -363,6 +559,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator+=(const Ptxt<Scheme>& otherPtxt)
   assertEq<LogicError>(*context,
                        *(otherPtxt.context),
                        "Ptxts must have matching contexts");
+  makeCompact();
+  if (compact) {
+    std::vector<long> tmp;
+    const std::vector<long>& other = otherPtxt.compactData(tmp);
+    addModVec(compactSlots.data(), other.data(), lsize(), context->slotRing->p2r);
+    view.clear();
+    return *this;
+  }
   for (unsigned i = 0; i < this->slots.size(); i++) {
     this->slots[i] += otherPtxt.slots[i];
   }
@@ -375,6 +579,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator+=(const SlotType& scalar)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call operator+= on default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    assertSlotsCompatible(std::vector<SlotType>(1, scalar));
+    long q = context->slotRing->p2r;
+    addModScalar(compactSlots.data(), compactOf(scalar), lsize(), q);
+    view.clear();
+    return *this;
+  }
   for (auto& x : this->slots)
     x += scalar;
   return *this;
@@ -393,6 +605,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator-=(const Ptxt<Scheme>& otherPtxt)
   assertEq<LogicError>(*context,
                        *(otherPtxt.context),
                        "Ptxts must have matching contexts");
+  makeCompact();
+  if (compact) {
+    std::vector<long> tmp;
+    const std::vector<long>& other = otherPtxt.compactData(tmp);
+    subModVec(compactSlots.data(), other.data(), lsize(), context->slotRing->p2r);
+    view.clear();
+    return *this;
+  }
   for (unsigned i = 0; i < this->slots.size(); i++) {
     this->slots[i] -= otherPtxt.slots[i];
   }
@@ -405,6 +625,17 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator-=(const SlotType& scalar)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call operator-= on default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    assertSlotsCompatible(std::vector<SlotType>(1, scalar));
+    long q = context->slotRing->p2r;
+    addModScalar(compactSlots.data(),
+                 NTL::NegateMod(compactOf(scalar), q),
+                 lsize(),
+                 q);
+    view.clear();
+    return *this;
+  }
   for (auto& x : this->slots)
     x -= scalar;
   return *this;
@@ -415,6 +646,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::negate()
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call negate on default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    long q = context->slotRing->p2r;
+    for (long& x : compactSlots)
+      x = NTL::NegateMod(x, q);
+    view.clear();
+    return *this;
+  }
   for (auto& slot : slots) {
     slot = -slot;
   }
@@ -468,6 +707,22 @@ Ptxt<Scheme>& Ptxt<Scheme>::multiplyBy2(const Ptxt& otherPtxt1,
                          otherPtxt2.size(),
                          "Cannot multiply by plaintext of different size - "
                          "second argument has wrong size");
+  makeCompact();
+  if (compact) {
+    std::vector<long> tmp1, tmp2;
+    const std::vector<long>& other1 = otherPtxt1.compactData(tmp1);
+    const std::vector<long>& other2 = otherPtxt2.compactData(tmp2);
+    long q = context->slotRing->p2r;
+    NTL::mulmod_t qinv = NTL::PrepMulMod(q);
+    // The operands may alias this, so slot i is read before it is written
+    for (std::size_t i = 0; i < size(); ++i)
+      compactSlots[i] = NTL::MulMod(compactSlots[i],
+                                    NTL::MulMod(other1[i], other2[i], q, qinv),
+                                    q,
+                                    qinv);
+    view.clear();
+    return *this;
+  }
   for (std::size_t i = 0; i < size(); ++i)
     slots[i] *= otherPtxt1.slots[i] * otherPtxt2.slots[i];
 
@@ -498,6 +753,13 @@ Ptxt<Scheme>& Ptxt<Scheme>::power(long e)
   if (e < 1) {
     throw InvalidArgument("Cannot raise a Ptxt to a non positive "
                           "exponent");
+  }
+  makeCompact();
+  if (e > 1 && compact) {
+    long q = context->slotRing->p2r;
+    for (long& x : compactSlots)
+      x = NTL::PowerMod(x, e, q);
+    view.clear();
   } else if (e > 1) {
     // exponentiation through squaring.
     std::vector<SlotType> multiplier(slots);
@@ -525,11 +787,10 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate(long amount)
   amount = mcMod(amount, size());
   if (amount == 0)
     return *this;
-  std::vector<SlotType> rotated_slots(size());
-  for (long i = 0; i < lsize(); ++i) {
-    rotated_slots[i] = slots[mcMod(i - amount, size())];
-  }
-  slots = std::move(rotated_slots);
+  std::vector<long> src(size());
+  for (long i = 0; i < lsize(); ++i)
+    src[i] = mcMod(i - amount, size());
+  permute(src);
   return *this;
 }
 
@@ -538,7 +799,7 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate1D(long dim, long amount)
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call rotate1D on default-constructed Ptxt");
-  if (slots.size() == 1)
+  if (size() == 1)
     return *this; // Nothing to do (only one slot)
   const PAlgebra& zMStar = context->zMStar;
   long num_gens = zMStar.numOfGens();
@@ -547,8 +808,6 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate1D(long dim, long amount)
                             num_gens,
                             "Dimension must be between 0 and "
                             "number of generators");
-  // Copying in slots to avoid default PolyMod issues.
-  std::vector<SlotType> new_slots(slots);
   long ord = context->ea->sizeOfDimension(dim);
   amount = mcMod(amount, ord); // Make amount smallest positive integer < ord
   if (amount == 0)
@@ -561,6 +820,7 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate1D(long dim, long amount)
   // After the conversion the relevant generator (specified by dim) is
   // incremented by amount.  This new set of coordinates is then converted back
   // to the new index of the slot.
+  std::vector<long> src(size());
   for (long index = 0; index < lsize(); ++index) {
     // Vector to hold the coordinate representation of the current index.
     std::vector<long> coord(indexToCoord(index));
@@ -569,10 +829,10 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate1D(long dim, long amount)
     coord[dim] = mcMod(amount + coord[dim], ord);
     // Convert the new coordinates post rotation into the correct index.
     long new_index = coordToIndex(coord);
-    // Set the new index of the current slot.
-    new_slots[new_index] = slots[index];
+    // The current slot moves to the new index.
+    src[new_index] = index;
   }
-  slots = std::move(new_slots);
+  permute(src);
   return *this;
 }
 
@@ -588,10 +848,10 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift(long amount)
     return *this;
   }
 
-  rotate(amount);
+  std::vector<long> src(size());
   for (long i = 0; i < lsize(); ++i)
-    if ((i - amount) < 0 || (i - amount) >= lsize())
-      slots[i] = 0;
+    src[i] = ((i - amount) < 0 || (i - amount) >= lsize()) ? -1 : i - amount;
+  permute(src);
 
   return *this;
 }
@@ -603,7 +863,7 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift1D(long dim, long amount)
                            "Cannot call shift1D on default-constructed Ptxt");
   if (amount == 0)
     return *this;
-  if (slots.size() == 1 ||
+  if (size() == 1 ||
       std::abs(amount) >= context->ea->sizeOfDimension(dim)) {
     clear();
     return *this;
@@ -616,8 +876,6 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift1D(long dim, long amount)
                             num_gens,
                             "Dimension must be between 0 and "
                             "number of generators");
-  // Copying in slots to avoid default PolyMod issues.
-  std::vector<SlotType> new_slots(slots);
   long ord = context->ea->sizeOfDimension(dim);
 
   // This for loop performs similar logic in rotate1D to obtain the new index
@@ -625,6 +883,7 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift1D(long dim, long amount)
   // representation.
   // An extra check is then performed to see if the shift operation caused an
   // element to wrap around in which case it is replaced with 0.
+  std::vector<long> src(size());
   for (long new_index = 0; new_index < lsize(); ++new_index) {
     // Vector to hold the coordinate representation of the current index.
     std::vector<long> coord(indexToCoord(new_index));
@@ -634,13 +893,12 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift1D(long dim, long amount)
     // If the coordinate exceeds the bounds of the order of the generator then
     // set the new slot to 0.
     if (coord[dim] < 0 || coord[dim] >= ord) {
-      new_slots[new_index] = 0;
+      src[new_index] = -1;
     } else { // Otherwise set the old index to the value of the new index.
-      long old_index = coordToIndex(coord);
-      new_slots[new_index] = slots[old_index];
+      src[new_index] = coordToIndex(coord);
     }
   }
-  slots = std::move(new_slots);
+  permute(src);
   return *this;
 }
 
@@ -697,6 +955,12 @@ Ptxt<Scheme>& Ptxt<Scheme>::replicate(long pos)
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call replicate on default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    std::fill(compactSlots.begin(), compactSlots.end(), compactSlots[pos]);
+    view.clear();
+    return *this;
+  }
   for (auto& slot : slots)
     slot = slots[pos];
   return *this;
@@ -757,6 +1021,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::runningSums()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call runningSums on "
                            "default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    long q = context->slotRing->p2r;
+    for (std::size_t i = 1; i < size(); ++i)
+      compactSlots[i] = NTL::AddMod(compactSlots[i], compactSlots[i - 1], q);
+    view.clear();
+    return *this;
+  }
   for (std::size_t i = 1; i < size(); ++i)
     slots[i] += slots[i - 1];
   return *this;
@@ -768,6 +1040,15 @@ Ptxt<Scheme>& Ptxt<Scheme>::totalSums()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call totalSums on "
                            "default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    long q = context->slotRing->p2r;
+    long sum = 0;
+    for (long x : compactSlots)
+      sum = NTL::AddMod(sum, x, q);
+    setCompactData(std::vector<long>(size(), sum));
+    return *this;
+  }
   SlotType sum = slots[0];
   for (std::size_t i = 1; i < size(); ++i)
     sum += slots[i];
@@ -781,6 +1062,16 @@ Ptxt<Scheme>& Ptxt<Scheme>::incrementalProduct()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call incrementalProduct on "
                            "default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    long q = context->slotRing->p2r;
+    NTL::mulmod_t qinv = NTL::PrepMulMod(q);
+    for (std::size_t i = 1; i < size(); ++i)
+      compactSlots[i] =
+          NTL::MulMod(compactSlots[i], compactSlots[i - 1], q, qinv);
+    view.clear();
+    return *this;
+  }
   for (std::size_t i = 1; i < size(); ++i)
     slots[i] *= slots[i - 1];
   return *this;
@@ -792,6 +1083,16 @@ Ptxt<Scheme>& Ptxt<Scheme>::totalProduct()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call totalProduct on "
                            "default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    long q = context->slotRing->p2r;
+    NTL::mulmod_t qinv = NTL::PrepMulMod(q);
+    long product = 1 % q;
+    for (long x : compactSlots)
+      product = NTL::MulMod(product, x, q, qinv);
+    setCompactData(std::vector<long>(size(), product));
+    return *this;
+  }
   SlotType product = slots[0];
   for (std::size_t i = 1; i < size(); ++i)
     product *= slots[i];
@@ -804,6 +1105,13 @@ Ptxt<Scheme>& Ptxt<Scheme>::mapTo01()
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call mapTo01 on default-constructed Ptxt");
+  makeCompact();
+  if (compact) {
+    for (long& x : compactSlots)
+      x = (x != 0);
+    view.clear();
+    return *this;
+  }
   for (auto& slot : slots)
     if (slot != Ptxt<Scheme>::convertToSlot(*context, 0l))
       slot = 1;
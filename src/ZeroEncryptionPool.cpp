@@ -0,0 +1,180 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#include <helib/ZeroEncryptionPool.h>
+#include <helib/keys.h>
+#include <helib/timing.h>
+
+namespace helib {
+
+ZeroEncryptionPool::ZeroEncryptionPool(const PubKey& _pubKey,
+                                       long _depth,
+                                       long numThreads,
+                                       const IndexSet& _primeSet) :
+    pubKey(_pubKey),
+    depth(_depth),
+    ptxtSpace(_pubKey.getPtxtSpace()),
+    primeSet(empty(_primeSet) ? _pubKey.getContext().ctxtPrimes : _primeSet),
+    startTime(std::chrono::steady_clock::now()),
+    pending(0),
+    produced(0),
+    consumed(0),
+    starved(0),
+    failed(0),
+    stopping(false)
+{
+  if (pubKey.isCKKS())
+    throw LogicError("ZeroEncryptionPool only supports BGV");
+  if (depth <= 0)
+    throw InvalidArgument("ZeroEncryptionPool depth must be positive");
+  if (numThreads < 0)
+    throw InvalidArgument("ZeroEncryptionPool numThreads must be non-negative");
+  assertTrue(primeSet <= pubKey.getContext().ctxtPrimes,
+             "Target prime set must be a subset of the ctxtPrimes");
+
+#ifdef HELIB_THREADS
+  for (long i = 0; i < numThreads; i++)
+    workers.emplace_back(&ZeroEncryptionPool::worker, this);
+#endif
+}
+
+ZeroEncryptionPool::~ZeroEncryptionPool()
+{
+#ifdef HELIB_THREADS
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    stopping = true;
+  }
+  notFull.notify_all();
+  for (auto& t : workers)
+    t.join();
+#endif
+}
+
+void ZeroEncryptionPool::makeZero(Ctxt& ctxt) const
+{
+  HELIB_TIMER_START;
+  pubKey.encryptZero(ctxt, ptxtSpace, /*highNoise=*/false);
+  if (primeSet != ctxt.getPrimeSet())
+    ctxt.bringToSet(primeSet);
+}
+
+bool ZeroEncryptionPool::pop(Ctxt& ctxt)
+{
+  {
+    HELIB_MUTEX_GUARD(mtx);
+    if (queue.empty()) {
+      starved++;
+      return false;
+    }
+    ctxt = queue.front();
+    queue.pop_front();
+    consumed++;
+  }
+#ifdef HELIB_THREADS
+  notFull.notify_one();
+#endif
+  return true;
+}
+
+void ZeroEncryptionPool::refill()
+{
+  {
+    HELIB_MUTEX_GUARD(mtx);
+    if (error) {
+      std::exception_ptr e = error;
+      error = nullptr;
+      std::rethrow_exception(e);
+    }
+  }
+
+  for (;;) {
+    {
+      HELIB_MUTEX_GUARD(mtx);
+      if (stopping || long(queue.size()) + pending >= depth)
+        return;
+      pending++;
+    }
+
+    Ctxt ctxt(pubKey);
+    try {
+      makeZero(ctxt);
+    } catch (...) {
+      HELIB_MUTEX_GUARD(mtx);
+      pending--;
+      throw;
+    }
+
+    {
+      HELIB_MUTEX_GUARD(mtx);
+      pending--;
+      queue.push_back(ctxt);
+      produced++;
+    }
+  }
+}
+
+#ifdef HELIB_THREADS
+void ZeroEncryptionPool::worker()
+{
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lck(mtx);
+      notFull.wait(lck, [this] {
+        return stopping || long(queue.size()) + pending < depth;
+      });
+      if (stopping)
+        return;
+      pending++; // reserve a place in the queue
+    }
+
+    Ctxt ctxt(pubKey);
+    try {
+      makeZero(ctxt);
+    } catch (...) {
+      // The pool no longer refills in the background. Encrypt falls back
+      // to computing the encryptions itself, refill() reports the error.
+      std::lock_guard<std::mutex> lck(mtx);
+      pending--;
+      failed++;
+      error = std::current_exception();
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lck(mtx);
+      pending--;
+      queue.push_back(ctxt);
+      produced++;
+    }
+  }
+}
+#endif
+
+ZeroEncryptionPool::Metrics ZeroEncryptionPool::getMetrics() const
+{
+  Metrics metrics;
+  {
+    HELIB_MUTEX_GUARD(mtx);
+    metrics.produced = produced;
+    metrics.consumed = consumed;
+    metrics.starved = starved;
+    metrics.failed = failed;
+    metrics.queued = long(queue.size());
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - startTime;
+  metrics.refillRate =
+      (elapsed.count() > 0) ? metrics.produced / elapsed.count() : 0.0;
+  return metrics;
+}
+
+} // namespace helib
@@ -294,4 +294,53 @@ void compareTwoNumbers(Ctxt& mu,
                                   true);
 }
 
+// Replace num by max/min of its values over all the slots
+static void totalMinMax(const EncryptedArray& ea,
+                        CtPtrs& num,
+                        bool wantMax,
+                        bool twosComplement,
+                        std::vector<zzX>* unpackSlotEncoding)
+{
+  HELIB_TIMER_START;
+  if (lsize(num) < 1)
+    return;
+
+  std::vector<Ctxt> v;
+  vecCopy(v, num);
+  allSlotsReduce(
+      ea,
+      v,
+      [&](std::vector<Ctxt>& acc, std::vector<Ctxt>& other) {
+        std::vector<Ctxt> eMax, eMin;
+        CtPtrs_vectorCt wMax(eMax), wMin(eMin);
+        Ctxt mu(ZeroCtxtLike, acc[0]), ni(ZeroCtxtLike, acc[0]);
+        compareTwoNumbers(wMax,
+                          wMin,
+                          mu,
+                          ni,
+                          CtPtrs_vectorCt(acc),
+                          CtPtrs_vectorCt(other),
+                          twosComplement,
+                          unpackSlotEncoding);
+        acc.swap(wantMax ? eMax : eMin);
+      });
+  vecCopy(num, v);
+}
+
+void totalMax(const EncryptedArray& ea,
+              CtPtrs& num,
+              bool twosComplement,
+              std::vector<zzX>* unpackSlotEncoding)
+{
+  totalMinMax(ea, num, true, twosComplement, unpackSlotEncoding);
+}
+
+void totalMin(const EncryptedArray& ea,
+              CtPtrs& num,
+              bool twosComplement,
+              std::vector<zzX>* unpackSlotEncoding)
+{
+  totalMinMax(ea, num, false, twosComplement, unpackSlotEncoding);
+}
+
 } // namespace helib
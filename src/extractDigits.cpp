@@ -13,6 +13,7 @@
  */
 #include <NTL/ZZ.h>
 #include <NTL/ZZ_p.h>
+#include <NTL/BasicThreadPool.h>
 #include <helib/EncryptedArray.h>
 #include <helib/polyEval.h>
 #include <helib/debugging.h>
@@ -55,6 +56,17 @@ static void buildDigitPolynomial(NTL::ZZX& result, long p, long e)
   HELIB_TIMER_STOP;
 }
 
+// "in spirit" digit = digit^p, x2p is the result of buildDigitPolynomial
+static void raiseDigit(Ctxt& digit, long p, const NTL::ZZX& x2p)
+{
+  if (p == 2)
+    digit.square();
+  else if (p == 3)
+    digit.cube();
+  else
+    polyEval(digit, x2p, digit);
+}
+
 // extractDigits assumes that the slots of *this contains integers mod p^r
 // i.e., that only the free terms are nonzero. (If that assumptions does
 // not hold then the result will not be a valid ciphertext anymore.)
@@ -88,17 +100,15 @@ void extractDigits(std::vector<Ctxt>& digits, const Ctxt& c, long r)
   fprintf(stderr, "***\n");
 #endif
   for (long i = 0; i < r; i++) {
+    // The digits computed so far are raised to the p'th power
+    // independently of each other
+    NTL_EXEC_RANGE(i, first, last)
+    for (long j : range(first, last))
+      raiseDigit(digits[j], p, x2p);
+    NTL_EXEC_RANGE_END
+
     tmp = c;
     for (long j = 0; j < i; j++) {
-
-      if (p == 2)
-        digits[j].square();
-      else if (p == 3)
-        digits[j].cube();
-      else
-        polyEval(digits[j], x2p, digits[j]);
-        // "in spirit" digits[j] = digits[j]^p
-
 #ifdef HELIB_DEBUG
       fprintf(stderr, "%5ld", digits[j].bitCapacity());
 #endif
@@ -239,9 +249,11 @@ void extendExtractDigits(std::vector<Ctxt>& digits,
   // for i = 0..r-1, entry i is G_{e+r-i} in Chen and Han
   NTL::Vec<NTL::ZZX> G;
   G.SetLength(r);
-  for (long i : range(r)) {
+  NTL_EXEC_RANGE(r, first, last)
+  for (long i : range(first, last)) {
     compute_magic_poly(G[i], p, e + r - i);
   }
+  NTL_EXEC_RANGE_END
 
   std::vector<Ctxt> digits0;
 
@@ -250,30 +262,88 @@ void extendExtractDigits(std::vector<Ctxt>& digits,
   digits.resize(r, tmp); // allocate space
   digits0.resize(r, tmp);
 
+  // Round i computes digits0[i], and digits[i-1] = G[i-1](digits0[i-1]).
+  // The latter, and the choice between digits[j] and digits0[j]^p for
+  // j < i-1, are independent and done in parallel. The choice for j = i-1
+  // needs digits[i-1], so with more than one thread digits0[i-1]^p is
+  // computed in parallel with it, in case it is the better one.
+  bool speculate = NTL::AvailableThreads() > 1;
+  std::vector<char> useDigit(r); // subtract digits[j] rather than digits0[j]
+  Ctxt raised(tmp);              // digits0[i-1]^p
+
 #ifdef HELIB_DEBUG
   fprintf(stderr, "***\n");
 #endif
-  for (long i : range(r)) {
+  for (long i : range(r + 1)) {
+    long lower = (i < r) ? std::max(i - 1, 0L) : 0; // choices for j < i-1
+    long first_task = (i > 0) ? 0 : 2;
+    long last_task = 2 + lower;
+
+    NTL_EXEC_RANGE(last_task - first_task, first, last)
+    for (long t : range(first + first_task, last + first_task)) {
+      if (t == 0)
+        polyEval(digits[i - 1], G[i - 1], digits0[i - 1]);
+      else if (t == 1) {
+        if (speculate && i < r) {
+          raised = digits0[i - 1];
+          raiseDigit(raised, p, x2p);
+        }
+      } else {
+        long j = t - 2;
+        // optimization: if digits[j] is better than digits0[j],
+        // just use it
+        useDigit[j] = digits[j].capacity() >= digits0[j].capacity();
+        if (!useDigit[j])
+          raiseDigit(digits0[j], p, x2p);
+      }
+    }
+    NTL_EXEC_RANGE_END
+
+#ifdef HELIB_DEBUG
+    if (i > 0) {
+      if (dbgKey) {
+        double ratio = log(embeddingLargestCoeff(digits[i - 1], *dbgKey) /
+                           digits[i - 1].getNoiseBound()) /
+                       log(2.0);
+        fprintf(stderr,
+                "%5ld  --- %5ld",
+                digits0[i - 1].bitCapacity(),
+                digits[i - 1].bitCapacity());
+        fprintf(stderr, " [%f]", ratio);
+        if (ratio > 0)
+          fprintf(stderr, " BAD-BOUND");
+        fprintf(stderr, "\n");
+      } else {
+        fprintf(stderr,
+                "%5ld  --- %5ld\n",
+                digits0[i - 1].bitCapacity(),
+                digits[i - 1].bitCapacity());
+      }
+    }
+#endif
+
+    if (i == r)
+      break;
+
+    if (i > 0) {
+      long j = i - 1;
+      useDigit[j] = digits[j].capacity() >= digits0[j].capacity();
+      if (!useDigit[j]) {
+        if (speculate)
+          digits0[j] = raised;
+        else
+          raiseDigit(digits0[j], p, x2p);
+      }
+    }
+
     tmp = c;
     for (long j : range(i)) {
-      if (digits[j].capacity() >= digits0[j].capacity()) {
-        // optimization: digits[j] is better than digits0[j],
-        // so just use it
-
+      if (useDigit[j]) {
         tmp -= digits[j];
 #ifdef HELIB_DEBUG
         fprintf(stderr, "%5ld*", digits[j].bitCapacity());
 #endif
       } else {
-        if (p == 2)
-          digits0[j].square();
-        else if (p == 3)
-          digits0[j].cube();
-        else
-          polyEval(digits0[j],
-                   x2p,
-                   digits0[j]); // "in spirit" digits0[j] = digits0[j]^p
-
         tmp -= digits0[j];
 #ifdef HELIB_DEBUG
         fprintf(stderr, "%5ld ", digits0[j].bitCapacity());
@@ -282,28 +352,6 @@ void extendExtractDigits(std::vector<Ctxt>& digits,
       tmp.divideByP();
     }
     digits0[i] = tmp; // needed in the next round
-    polyEval(digits[i], G[i], tmp);
-
-#ifdef HELIB_DEBUG
-    if (dbgKey) {
-      double ratio = log(embeddingLargestCoeff(digits[i], *dbgKey) /
-                         digits[i].getNoiseBound()) /
-                     log(2.0);
-      fprintf(stderr,
-              "%5ld  --- %5ld",
-              digits0[i].bitCapacity(),
-              digits[i].bitCapacity());
-      fprintf(stderr, " [%f]", ratio);
-      if (ratio > 0)
-        fprintf(stderr, " BAD-BOUND");
-      fprintf(stderr, "\n");
-    } else {
-      fprintf(stderr,
-              "%5ld  --- %5ld\n",
-              digits0[i].bitCapacity(),
-              digits[i].bitCapacity());
-    }
-#endif
   }
 }
 
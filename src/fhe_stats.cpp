@@ -20,6 +20,8 @@ namespace helib {
 
 bool fhe_stats = false;
 
+OpCounters opCounters;
+
 static std::vector<fhe_stats_record*> stats_map;
 static HELIB_MUTEX_TYPE stats_mutex;
 
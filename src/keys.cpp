@@ -9,8 +9,10 @@
  * See the License for the specific language governing permissions and
  * limitations under the License. See accompanying LICENSE file.
  */
+#include <algorithm>
 #include <queue>
 
+#include <NTL/BasicThreadPool.h>
 #include <helib/keys.h>
 #include <helib/timing.h>
 #include <helib/EncryptedArray.h>
@@ -20,6 +22,7 @@
 #include <helib/norms.h>
 #include <helib/apiAttributes.h>
 #include <helib/fhe_stats.h>
+#include <helib/ZeroEncryptionPool.h>
 
 namespace helib {
 
@@ -98,7 +101,8 @@ PubKey::PubKey(const PubKey& other) :
     keySwitchMap(other.keySwitchMap),
     KS_strategy(other.KS_strategy),
     recryptKeyID(other.recryptKeyID),
-    recryptEkey(*this)
+    recryptEkey(*this),
+    autoBootstrap(other.autoBootstrap)
 { // copy pubEncrKey,recryptEkey w/o checking the ref to the public key
   pubEncrKey.privateAssign(other.pubEncrKey);
   recryptEkey.privateAssign(other.recryptEkey);
@@ -112,6 +116,8 @@ void PubKey::clear()
   keySwitchMap.clear();
   recryptKeyID = -1;
   recryptEkey.clear();
+  zeroPool.reset(); // any pre-computed encryptions are now stale
+  autoBootstrap = AutoBootstrapPolicy();
 }
 
 void PubKey::setKeySwitchMap(long keyId)
@@ -327,6 +333,35 @@ long PubKey::getKSStrategy(long dim) const
   return KS_strategy[index];
 }
 
+void PubKey::setZeroEncryptionPool(std::shared_ptr<ZeroEncryptionPool> pool)
+{
+  if (pool)
+    assertEq(this,
+             &pool->getPubKey(),
+             "ZeroEncryptionPool was built for a different public key");
+  zeroPool = std::move(pool);
+}
+
+const std::shared_ptr<ZeroEncryptionPool>& PubKey::getZeroEncryptionPool() const
+{
+  return zeroPool;
+}
+
+void PubKey::setAutoBootstrap(const AutoBootstrapPolicy& policy)
+{
+  if (policy.enabled()) {
+    assertTrue(isBootstrappable(),
+               "Auto-bootstrapping needs a bootstrappable key");
+    assertFalse(isCKKS(), "Auto-bootstrapping is only supported for BGV");
+  }
+  autoBootstrap = policy;
+}
+
+const AutoBootstrapPolicy& PubKey::getAutoBootstrap() const
+{
+  return autoBootstrap;
+}
+
 void PubKey::setKSStrategy(long dim, int val)
 {
   long index = dim + 1;
@@ -371,6 +406,97 @@ long PubKey::Encrypt(Ctxt& ctxt,
       throw RuntimeError("Plaintext-space mismatch on encryption");
   }
 
+  // The plaintext-independent part: a random encryption of zero, either
+  // precomputed by an attached ZeroEncryptionPool or computed right here.
+  bool pooled = !highNoise && popZero(ctxt, ptxtSpace);
+  if (!pooled)
+    encryptZero(ctxt, ptxtSpace, highNoise);
+
+  // The pool promises an online phase of a single addition, so the size
+  // of the plaintext is then only checked when collecting statistics
+  addPlaintext(ctxt, ptxt, ptxtSpace, /*checkSize=*/!pooled || fhe_stats);
+  return ptxtSpace;
+}
+
+bool PubKey::popZero(Ctxt& ctxt, long ptxtSpace) const
+{
+  return zeroPool && &zeroPool->getPubKey() == this &&
+         ptxtSpace == zeroPool->getPtxtSpace() && zeroPool->pop(ctxt);
+}
+
+void PubKey::addPlaintext(Ctxt& ctxt,
+                          const NTL::ZZX& ptxt,
+                          long ptxtSpace,
+                          bool checkSize) const
+{
+  // add in the plaintext
+  // FIXME: we should really randomize ptxt, so that each coefficient
+  //    has expected value 0
+  // NOTE: This relies on the first part, ctxt[0], to have handle to 1
+
+  // Q mod p, one prime at a time rather than through the product Q
+  long QmodP = 1 % ptxtSpace;
+  for (long i : ctxt.primeSet)
+    QmodP = NTL::MulMod(QmodP, context.ithPrime(i) % ptxtSpace, ptxtSpace);
+  // A pre-computed encryption of zero may have been mod-switched down
+  QmodP = NTL::MulMod(QmodP, mcMod(ctxt.intFactor, ptxtSpace), ptxtSpace);
+  NTL::ZZX ptxt_fixed;
+  balanced_MulMod(ptxt_fixed, ptxt, QmodP, ptxtSpace);
+  ctxt.parts[0] += ptxt_fixed;
+
+  // NOTE: this is a heuristic, as the ptxt is not really random.
+  // although, when ptxtSpace == 2, the balanced_MulMod will
+  // randomize it
+  double ptxt_bound =
+      context.noiseBoundForMod(ptxtSpace, context.zMStar.getPhiM());
+
+  // FIXME: for now, we print out a warning, but we can consider
+  // implementing a more robust randomization and rejection sampling
+  // strategy.
+  if (checkSize) {
+    double ptxt_sz =
+        NTL::conv<double>(embeddingLargestCoeff(ptxt_fixed, context.zMStar));
+
+    if (ptxt_sz > ptxt_bound) {
+      Warning("noise bound exceeded in encryption");
+    }
+
+    double ptxt_rat = ptxt_sz / ptxt_bound;
+    HELIB_STATS_UPDATE("ptxt_rat", ptxt_rat);
+  }
+
+  ctxt.noiseBound += ptxt_bound;
+
+  // std::cerr << "*** ptxt_bound " << ptxt_bound << "\n";
+
+  // std::cerr << "*** ctxt.noiseBound " << ctxt.noiseBound << "\n";
+
+  // CheckCtxt(ctxt, "after encryption");
+}
+
+PubKey::EncryptionNoise::EncryptionNoise(const Context& context) :
+    stdev(to_double(context.stdev)),
+    r(context, context.ctxtPrimes),
+    e(context, context.ctxtPrimes)
+{
+  if (context.zMStar.getPow2() == 0) // not power of two
+    stdev *= sqrt(context.zMStar.getM());
+}
+
+// Sets ctxt to a fresh random encryption of zero with respect to the
+// plaintext space ptxtSpace, relative to all the ctxtPrimes.
+void PubKey::encryptZero(Ctxt& ctxt, long ptxtSpace, bool highNoise) const
+{
+  EncryptionNoise noise(context);
+  encryptZero(ctxt, ptxtSpace, highNoise, noise);
+}
+
+void PubKey::encryptZero(Ctxt& ctxt,
+                         long ptxtSpace,
+                         bool highNoise,
+                         EncryptionNoise& noise) const
+{
+  HELIB_TIMER_START;
   // generate a random encryption of zero from the public encryption key
   ctxt = pubEncrKey; // already an encryption of zero, just not a random one
                      // ctxt with two parts, each with all the ctxtPrimes
@@ -393,8 +519,8 @@ long PubKey::Encrypt(Ctxt& ctxt,
   //  that the coefficients of the ciphertext are uniformly
   //  and independently chosen from the interval [-p/2, p/2].
 
-  DoubleCRT e(context, context.ctxtPrimes);
-  DoubleCRT r(context, context.ctxtPrimes);
+  DoubleCRT& e = noise.e;
+  DoubleCRT& r = noise.r;
   double r_bound = r.sampleSmallBounded();
 
   ctxt.noiseBound += r_bound * pubEncrKey.noiseBound;
@@ -402,9 +528,7 @@ long PubKey::Encrypt(Ctxt& ctxt,
   // std::cerr << "*** r_bound*pubEncrKey.noiseBound " << r_bound *
   // pubEncrKey.noiseBound << "\n";
 
-  double stdev = to_double(context.stdev);
-  if (context.zMStar.getPow2() == 0) // not power of two
-    stdev *= sqrt(context.zMStar.getM());
+  double stdev = noise.stdev;
 
   for (size_t i = 0; i < ctxt.parts.size(); i++) { // add noise to all the parts
     ctxt.parts[i] *= r;
@@ -438,49 +562,9 @@ long PubKey::Encrypt(Ctxt& ctxt,
     // std::cerr << "*** e_bound " << e_bound << "\n";
   }
 
-  // add in the plaintext
-  // FIXME: we should really randomize ptxt, so that each coefficient
-  //    has expected value 0
-  // NOTE: This relies on the first part, ctxt[0], to have handle to 1
-
-  // This code sequence could be optimized, but there is no point
-  long QmodP = rem(context.productOfPrimes(ctxt.primeSet), ptxtSpace);
-  NTL::ZZX ptxt_fixed;
-  balanced_MulMod(ptxt_fixed, ptxt, QmodP, ptxtSpace);
-  ctxt.parts[0] += ptxt_fixed;
-
-  // NOTE: this is a heuristic, as the ptxt is not really random.
-  // although, when ptxtSpace == 2, the balanced_MulMod will
-  // randomize it
-  double ptxt_bound =
-      context.noiseBoundForMod(ptxtSpace, context.zMStar.getPhiM());
-
-  // FIXME: for now, we print out a warning, but we can consider
-  // implementing a more robust randomization and rejection sampling
-  // strategy.
-  double ptxt_sz =
-      NTL::conv<double>(embeddingLargestCoeff(ptxt_fixed, context.zMStar));
-
-  if (ptxt_sz > ptxt_bound) {
-    Warning("noise bound exceeded in encryption");
-  }
-
-  double ptxt_rat = ptxt_sz / ptxt_bound;
-  HELIB_STATS_UPDATE("ptxt_rat", ptxt_rat);
-
-  ctxt.noiseBound += ptxt_bound;
-
-  // std::cerr << "*** ptxt_bound " << ptxt_bound << "\n";
-
   // fill in the other ciphertext data members
   ctxt.ptxtSpace = ptxtSpace;
   ctxt.intFactor = 1;
-
-  // std::cerr << "*** ctxt.noiseBound " << ctxt.noiseBound << "\n";
-
-  // CheckCtxt(ctxt, "after encryption");
-
-  return ptxtSpace;
 }
 
 long PubKey::Encrypt(Ctxt& ciphertxt,
@@ -498,6 +582,16 @@ void PubKey::CKKSencrypt(Ctxt& ctxt,
                          const NTL::ZZX& ptxt,
                          double ptxtSize,
                          double scaling) const
+{
+  EncryptionNoise noise(context);
+  CKKSencrypt(ctxt, ptxt, ptxtSize, scaling, noise);
+}
+
+void PubKey::CKKSencrypt(Ctxt& ctxt,
+                         const NTL::ZZX& ptxt,
+                         double ptxtSize,
+                         double scaling,
+                         EncryptionNoise& noise) const
 {
   assertEq(this, &ctxt.pubKey, "Public key and context public key mismatch");
 
@@ -506,7 +600,6 @@ void PubKey::CKKSencrypt(Ctxt& ctxt,
   if (scaling <= 0) // assume the default scaling factor
     scaling = getContext().ea->getCx().encodeScalingFactor() / ptxtSize;
 
-  long m = context.zMStar.getM();
   long prec = getContext().alMod.getPPowR();
 
   // generate a random encryption of zero from the public encryption key
@@ -530,16 +623,14 @@ void PubKey::CKKSencrypt(Ctxt& ctxt,
   // factor. The extra factor ef is set as ceil(error_bound*prec/f),
   // so that we have ef*f >= error_bound*prec.
 
-  DoubleCRT e(context, context.ctxtPrimes);
-  DoubleCRT r(context, context.ctxtPrimes);
+  DoubleCRT& e = noise.e;
+  DoubleCRT& r = noise.r;
 
   double r_bound = r.sampleSmallBounded(); // r is a {0,+-1} polynomial
 
   NTL::xdouble error_bound = r_bound * pubEncrKey.noiseBound;
 
-  double stdev = to_double(context.stdev);
-  if (context.zMStar.getPow2() == 0) // not power of two
-    stdev *= sqrt(m);
+  double stdev = noise.stdev;
 
   for (size_t i = 0; i < ctxt.parts.size(); i++) {
     // add noise to all the parts
@@ -620,6 +711,67 @@ long PubKey::Encrypt(Ctxt& ciphertxt,
             // CKKS does not have one
 }
 
+template <typename Scheme>
+long PubKey::EncryptMany(std::vector<Ctxt>& ciphertxts,
+                         const std::vector<Ptxt<Scheme>>& plaintxts,
+                         long ptxtSpace) const
+{
+  HELIB_TIMER_START;
+  long n = plaintxts.size();
+  ciphertxts.clear();
+  ciphertxts.resize(n, Ctxt(*this));
+
+  if (n == 0)
+    return ptxtSpace;
+
+  // All the ciphertexts get the same plaintext space, which the first
+  // encryption checks
+  long space = Encrypt(ciphertxts[0], plaintxts[0], ptxtSpace);
+
+  NTL_EXEC_RANGE(n - 1, first, last)
+  EncryptionNoise noise(context);
+  for (long i = first + 1; i < last + 1; i++)
+    encryptWith(ciphertxts[i], plaintxts[i], space, noise);
+  NTL_EXEC_RANGE_END
+
+  return space;
+}
+
+void PubKey::encryptWith(Ctxt& ciphertxt,
+                         const Ptxt<BGV>& plaintxt,
+                         long ptxtSpace,
+                         EncryptionNoise& noise) const
+{
+  bool pooled = popZero(ciphertxt, ptxtSpace);
+  if (!pooled)
+    encryptZero(ciphertxt, ptxtSpace, /*highNoise=*/false, noise);
+  addPlaintext(ciphertxt,
+               plaintxt.getPolyRepr(),
+               ptxtSpace,
+               /*checkSize=*/!pooled || fhe_stats);
+}
+
+void PubKey::encryptWith(Ctxt& ciphertxt,
+                         const Ptxt<CKKS>& plaintxt,
+                         UNUSED long ptxtSpace,
+                         EncryptionNoise& noise) const
+{
+  // As the Encrypt specialisation for Ptxt<CKKS>
+  NTL::ZZX poly = plaintxt.getPolyRepr();
+  double f = ciphertxt.getContext().ea->getCx().encode(poly,
+                                                       plaintxt,
+                                                       /*useThisSize*/ -1.0,
+                                                       /*precision*/ -1);
+  CKKSencrypt(ciphertxt, poly, /*useThisSize*/ -1.0, /*scaling*/ f, noise);
+}
+
+template long PubKey::EncryptMany(std::vector<Ctxt>& ciphertxts,
+                                  const std::vector<Ptxt<BGV>>& plaintxts,
+                                  long ptxtSpace) const;
+template long PubKey::EncryptMany(std::vector<Ctxt>& ciphertxts,
+                                  const std::vector<Ptxt<CKKS>>& plaintxts,
+                                  long ptxtSpace) const;
+
 bool PubKey::isCKKS() const
 {
   return (getContext().alMod.getTag() == PA_cx_tag);
@@ -1123,12 +1275,206 @@ void SecKey::Decrypt(NTL::ZZX& plaintxt,
   }
 }
 
+// The integer polynomial x=<c,s> has coefficients much smaller than the
+// modulus Q of the ciphertext, so it can be recovered from its residues
+// modulo any subset of the primes whose product is larger than 2|x|. We
+// choose the fewest such primes, compute x modulo each of them, and then
+// use Garner's mixed-radix CRT to get x mod ptxtSpace directly, with no
+// multi-precision arithmetic.
+void SecKey::fastDecrypt(NTL::ZZX& plaintxt, const Ctxt& ciphertxt) const
+{
+  HELIB_TIMER_START;
+
+  assertEq(getContext(), ciphertxt.getContext(), "Context mismatch");
+
+  if (isCKKS() || ciphertxt.isEmpty()) {
+    Decrypt(plaintxt, ciphertxt);
+    return;
+  }
+
+  const IndexSet& primeSet = ciphertxt.getPrimeSet();
+
+  // We need |x| < Q'/2 for the product Q' of the chosen primes. Bound x on
+  // the polynomial basis, and leave a few bits of slack since noiseBound is
+  // only a high-probability bound.
+  double logBound = log(ciphertxt.getNoiseBound()) +
+                    log(getContext().zMStar.getPolyNormBnd()) + 4 * log(2.0);
+
+  // Prefer primes over which the secret keys are defined, largest first
+  IndexSet candidates = primeSet & context.ctxtPrimes;
+  if (context.logOfProduct(candidates) <= logBound)
+    candidates = primeSet;
+  std::vector<long> order;
+  for (long i : candidates)
+    order.push_back(i);
+  std::sort(order.begin(), order.end(), [this](long i, long j) {
+    return context.ithPrime(i) > context.ithPrime(j);
+  });
+
+  IndexSet target;
+  double logQ = 0.0;
+  for (long i : order) {
+    if (logQ > logBound)
+      break;
+    target.insert(i);
+    logQ += context.logOfPrime(i);
+  }
+  if (logQ <= logBound || target == primeSet) { // nothing to gain
+    Decrypt(plaintxt, ciphertxt);
+    return;
+  }
+
+  // Compute x modulo the primes in target only
+  DoubleCRT ptxt(context, target); // Set to zero
+  for (const CtxtPart& part : ciphertxt.parts) {
+    DoubleCRT tmp = part;
+    tmp.setPrimes(target); // only removes primes
+
+    if (part.skHandle.isOne()) { // No need to multiply
+      ptxt += tmp;
+      continue;
+    }
+
+    long keyIdx = part.skHandle.getSecretKeyID();
+    DoubleCRT key = sKeys.at(keyIdx); // copy object, not a reference
+    key.setPrimes(target);
+
+    long xPower = part.skHandle.getPowerOfX();
+    long sPower = part.skHandle.getPowerOfS();
+    if (xPower > 1) {
+      key.automorph(xPower); // s(X^t)
+    }
+    if (sPower > 1) {
+      key.Exp(sPower); // s^r(X^t)
+    }
+
+    key *= tmp;
+    ptxt += key;
+  }
+
+  long ptxtSpace = ciphertxt.getPtxtSpace();
+  long phim = context.zMStar.getPhiM();
+  long k = target.card();
+
+  // Residues of x modulo each of the q_i's, in [0,q_i)
+  std::vector<long> q(k);
+  std::vector<NTL::Vec<long>> rows(k);
+  {
+    long i = 0;
+    for (long idx : target) {
+      q[i] = ptxt.getOneRow(rows[i], idx, /*positive=*/true);
+      i++;
+    }
+  }
+
+  // Precomputed constants for Garner's algorithm: for each j,
+  // qInv[j] = (q_0*...*q_{j-1})^{-1} mod q_j, and the mixed-radix digits of
+  // half = floor(Q'/2) (so that we can tell when x >= Q'/2 and need to be
+  // shifted to the symmetric interval), together with the q_i's and Q' mod
+  // ptxtSpace.
+  std::vector<long> qInv(k), halfDigits(k), qModP(k);
+  NTL::ZZ half = context.productOfPrimes(target) / 2;
+  long QmodP = rem(context.productOfPrimes(target), ptxtSpace);
+  for (long j : range(k)) {
+    long prod = 1;
+    for (long i : range(j))
+      prod = NTL::MulMod(prod, q[i] % q[j], q[j]);
+    qInv[j] = NTL::InvMod(prod, q[j]);
+    qModP[j] = q[j] % ptxtSpace;
+    halfDigits[j] = NTL::DivRem(half, half, q[j]);
+  }
+
+  plaintxt.SetLength(phim);
+  std::vector<long> digits(k);
+  for (long c : range(phim)) {
+    // Mixed-radix digits of x in [0,Q'), x = d_0 + q_0*(d_1 + q_1*(d_2 ...))
+    for (long j : range(k)) {
+      long a = (c < rows[j].length()) ? rows[j][c] : 0;
+      long t = 0;
+      for (long i = j - 1; i >= 0; i--)
+        t = NTL::AddMod(NTL::MulMod(t, q[i] % q[j], q[j]),
+                        digits[i] % q[j],
+                        q[j]);
+      digits[j] = NTL::MulMod(NTL::SubMod(a, t, q[j]), qInv[j], q[j]);
+    }
+
+    // Reduce x modulo ptxtSpace, Horner-style from the top digit
+    long x = 0;
+    for (long j = k - 1; j >= 0; j--)
+      x = NTL::AddMod(NTL::MulMod(x, qModP[j], ptxtSpace),
+                      digits[j] % ptxtSpace,
+                      ptxtSpace);
+
+    // If x > floor(Q'/2), the symmetric representative is x-Q'. Compare the
+    // digits lexicographically, most significant first.
+    bool aboveHalf = false;
+    for (long j = k - 1; j >= 0; j--) {
+      if (digits[j] != halfDigits[j]) {
+        aboveHalf = (digits[j] > halfDigits[j]);
+        break;
+      }
+    }
+    if (aboveHalf)
+      x = NTL::SubMod(x, QmodP, ptxtSpace);
+
+    conv(plaintxt[c], x);
+  }
+  plaintxt.normalize();
+
+  // if p>2, multiply by (intFactor * Q)^{-1} mod p, where Q is the modulus
+  // of the ciphertext (not of the primes that we used)
+  if (ptxtSpace > 2) {
+    long factor = rem(context.productOfPrimes(primeSet), ptxtSpace);
+    factor = NTL::MulMod(factor, ciphertxt.intFactor, ptxtSpace);
+    if (factor != 1) {
+      factor = NTL::InvMod(factor, ptxtSpace);
+      MulMod(plaintxt, plaintxt, factor, ptxtSpace, /*abs=*/true);
+    }
+  }
+}
+
+template <>
+void SecKey::fastDecrypt<BGV>(Ptxt<BGV>& plaintxt, const Ctxt& ciphertxt) const
+{
+  NTL::ZZX pp;
+  fastDecrypt(pp, ciphertxt);
+  plaintxt.decodeSetData(pp);
+}
+
+template <>
+void SecKey::fastDecrypt<CKKS>(Ptxt<CKKS>& plaintxt,
+                               const Ctxt& ciphertxt) const
+{
+  Decrypt(plaintxt, ciphertxt); // no fast path for CKKS
+}
+
+template <typename Scheme>
+void SecKey::DecryptMany(std::vector<Ptxt<Scheme>>& plaintxts,
+                         const std::vector<Ctxt>& ciphertxts) const
+{
+  HELIB_TIMER_START;
+  long n = ciphertxts.size();
+  plaintxts.clear();
+  plaintxts.resize(n, Ptxt<Scheme>(getContext()));
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long i = first; i < last; i++)
+    fastDecrypt(plaintxts[i], ciphertxts[i]);
+  NTL_EXEC_RANGE_END
+}
+
+template void SecKey::DecryptMany(std::vector<Ptxt<BGV>>& plaintxts,
+                                  const std::vector<Ctxt>& ciphertxts) const;
+template void SecKey::DecryptMany(std::vector<Ptxt<CKKS>>& plaintxts,
+                                  const std::vector<Ctxt>& ciphertxts) const;
+
 // Encryption using the secret key, this is useful, e.g., to put an
 // encryption of the secret key into the public key.
 long SecKey::skEncrypt(Ctxt& ctxt,
                        const NTL::ZZX& ptxt,
                        long ptxtSpace,
-                       long skIdx) const
+                       long skIdx,
+                       const NTL::ZZ* prgSeed) const
 {
   HELIB_TIMER_START;
 
@@ -1168,7 +1514,17 @@ long SecKey::skEncrypt(Ctxt& ctxt,
 
   const DoubleCRT& sKey = sKeys.at(skIdx); // get key
   // Sample a new RLWE instance
-  ctxt.noiseBound = RLWE(ctxt.parts[0], ctxt.parts[1], sKey, ptxtSpace);
+  if (prgSeed == nullptr) {
+    ctxt.noiseBound = RLWE(ctxt.parts[0], ctxt.parts[1], sKey, ptxtSpace);
+  } else {
+    // Only the random part comes from the seed, the error does not
+    {
+      RandomState state;
+      SetSeed(*prgSeed);
+      ctxt.parts[1].randomize();
+    } // restore state upon destruction of state
+    ctxt.noiseBound = RLWE1(ctxt.parts[0], ctxt.parts[1], sKey, ptxtSpace);
+  }
 
   if (isCKKS()) {
 
@@ -1229,6 +1585,35 @@ long SecKey::skEncrypt(Ctxt& ctxt,
 }
 
 long SecKey::skEncrypt(Ctxt& ctxt,
+                       const zzX& ptxt,
+                       long ptxtSpace,
+                       long skIdx,
+                       const NTL::ZZ* prgSeed) const
+{
+  NTL::ZZX tmp;
+  convert(tmp, ptxt);
+  return skEncrypt(ctxt, tmp, ptxtSpace, skIdx, prgSeed);
+}
+
+// Encrypt, then drop the random part and keep only the seed it came from
+long SecKey::skEncrypt(SeededCtxt& ctxt,
+                       const NTL::ZZX& ptxt,
+                       long ptxtSpace,
+                       long skIdx) const
+{
+  HELIB_TIMER_START;
+  RandomBits(ctxt.prgSeed, 256); // a random 256-bit seed
+  long ret = skEncrypt(ctxt.ctxt, ptxt, ptxtSpace, skIdx, &ctxt.prgSeed);
+
+  assertEq(ctxt.ctxt.parts.size(),
+           std::size_t(2),
+           "Fresh symmetric encryption must have exactly two parts");
+  ctxt.randHandle = ctxt.ctxt.parts[1].skHandle;
+  ctxt.ctxt.parts.pop_back();
+  return ret;
+}
+
+long SecKey::skEncrypt(SeededCtxt& ctxt,
                        const zzX& ptxt,
                        long ptxtSpace,
                        long skIdx) const
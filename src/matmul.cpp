@@ -10,10 +10,26 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 #include <cstddef>
+#include <cstdio> // std::rename, std::remove
+#include <cstring>
 #include <tuple>
 #include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HELIB_THREADS
+#include <condition_variable>
+#include <thread>
+#endif
+#include <exception>
 #include <NTL/BasicThreadPool.h>
 #include <helib/matmul.h>
+#include <helib/multicore.h>
+#include <helib/binio.h>
 #include <helib/norms.h>
 #include <helib/fhe_stats.h>
 #include <helib/apiAttributes.h>
@@ -44,129 +60,110 @@ static bool comp_hoist(bool hoist)
 /********************************************************************/
 /****************** Auxiliary stuff: should go elsewhere   **********/
 
-/**
- * @class BasicAutomorphPrecon
- * @brief Pre-computation to speed many automorphism on the same ciphertext.
- *
- * The expensive part of homomorphic automorphism is breaking the ciphertext
- * parts into digits. The usual setting is we first rotate the ciphertext
- * parts, then break them into digits. But when we apply many automorphisms
- * it is faster to break the original ciphertext into digits, then rotate
- * the digits (as opposed to first rotate, then break).
- * An BasicAutomorphPrecon object breaks the original ciphertext and keeps
- * the digits, then when you call automorph is only needs to apply the
- * native automorphism and key switching to the digits, which is fast(er).
- **/
-class BasicAutomorphPrecon
+BasicAutomorphPrecon::BasicAutomorphPrecon(const Ctxt& _ctxt) :
+    ctxt(_ctxt), noise(1.0)
 {
-  Ctxt ctxt;
-  NTL::xdouble noise;
-  std::vector<DoubleCRT> polyDigits;
-
-public:
-  BasicAutomorphPrecon(const Ctxt& _ctxt) : ctxt(_ctxt), noise(1.0)
-  {
-    HELIB_TIMER_START;
-    if (ctxt.parts.size() >= 1)
-      assertTrue(
-          ctxt.parts[0].skHandle.isOne(),
-          "Invalid ciphertext (secret key handle for part 0 is not one)");
-    if (ctxt.parts.size() <= 1)
-      return; // nothing to do
-
-    ctxt.cleanUp();
-    const Context& context = ctxt.getContext();
-    const PubKey& pubKey = ctxt.getPubKey();
-    long keyID = ctxt.getKeyID();
-
-    // The call to cleanUp() should ensure that this assertion passes.
-    assertTrue(ctxt.inCanonicalForm(keyID),
-               "Ciphertext is not in canonical form");
-
-    // Compute the number of digits that we need and the estimated
-    // added noise from switching this ciphertext.
+  HELIB_TIMER_START;
+  if (ctxt.parts.size() >= 1)
+    assertTrue(
+        ctxt.parts[0].skHandle.isOne(),
+        "Invalid ciphertext (secret key handle for part 0 is not one)");
+  if (ctxt.parts.size() <= 1)
+    return; // nothing to do
 
-    NTL::xdouble addedNoise = ctxt.parts[1].breakIntoDigits(polyDigits);
-    NTL::xdouble max_ks_noise(0.0);
-    for (const KeySwitch& ks : pubKey.keySWlist()) {
-      if (max_ks_noise < ks.noiseBound)
-        max_ks_noise = ks.noiseBound;
-    }
-    addedNoise *= max_ks_noise;
+  ctxt.cleanUp();
+  const Context& context = ctxt.getContext();
+  const PubKey& pubKey = ctxt.getPubKey();
+  long keyID = ctxt.getKeyID();
 
-    double logProd = context.logOfProduct(context.specialPrimes);
-    noise = ctxt.getNoiseBound() * NTL::xexp(logProd);
+  // The call to cleanUp() should ensure that this assertion passes.
+  assertTrue(ctxt.inCanonicalForm(keyID),
+             "Ciphertext is not in canonical form");
 
-    HELIB_STATS_UPDATE("KS-noise-ratio-hoist",
-                       NTL::conv<double>(addedNoise / noise));
-    // HERE
-    // std::cout << "*** HOIST INIT\n";
-    // fprintf(stderr, "   KS-log-noise-ratio-hoist: %f\n",
-    // log(addedNoise/noise)/log(2.0));
+  // Compute the number of digits that we need and the estimated
+  // added noise from switching this ciphertext.
 
-    noise += addedNoise;
+  NTL::xdouble addedNoise = ctxt.parts[1].breakIntoDigits(polyDigits);
+  NTL::xdouble max_ks_noise(0.0);
+  for (const KeySwitch& ks : pubKey.keySWlist()) {
+    if (max_ks_noise < ks.noiseBound)
+      max_ks_noise = ks.noiseBound;
   }
+  addedNoise *= max_ks_noise;
 
-  std::shared_ptr<Ctxt> automorph(long k) const
-  {
-    HELIB_TIMER_START;
+  double logProd = context.logOfProduct(context.specialPrimes);
+  noise = ctxt.getNoiseBound() * NTL::xexp(logProd);
 
-    // A hack: record this automorphism rather than actually performing it
-    if (isSetAutomorphVals()) { // defined in NumbTh.h
-      recordAutomorphVal(k);
-      return std::make_shared<Ctxt>(ctxt);
-    }
+  HELIB_STATS_UPDATE("KS-noise-ratio-hoist",
+                     NTL::conv<double>(addedNoise / noise));
+  // HERE
+  // std::cout << "*** HOIST INIT\n";
+  // fprintf(stderr, "   KS-log-noise-ratio-hoist: %f\n",
+  // log(addedNoise/noise)/log(2.0));
 
-    if (k == 1 || ctxt.isEmpty())
-      return std::make_shared<Ctxt>(ctxt); // nothing to do
+  noise += addedNoise;
+}
 
-    const Context& context = ctxt.getContext();
-    const PubKey& pubKey = ctxt.getPubKey();
-    // empty ctxt
-    std::shared_ptr<Ctxt> result = std::make_shared<Ctxt>(ZeroCtxtLike, ctxt);
-    result->noiseBound = noise; // noise estimate
-    result->intFactor = ctxt.intFactor;
+std::shared_ptr<Ctxt> BasicAutomorphPrecon::automorph(long k) const
+{
+  HELIB_TIMER_START;
 
-    if (ctxt.parts.size() == 1) { // only constant part, no need to key-switch
-      CtxtPart tmpPart = ctxt.parts[0];
-      tmpPart.automorph(k);
-      tmpPart.addPrimesAndScale(context.specialPrimes);
-      result->addPart(tmpPart, /*matchPrimeSet=*/true);
-      return result;
-    }
+  // A hack: record this automorphism rather than actually performing it
+  if (isSetAutomorphVals()) { // defined in NumbTh.h
+    recordAutomorphVal(k);
+    return std::make_shared<Ctxt>(ctxt);
+  }
 
-    // Ensure that we have a key-switching matrices for this automorphism
-    long keyID = ctxt.getKeyID();
-    if (!pubKey.isReachable(k, keyID)) {
-      throw LogicError("no key-switching matrices for k=" + std::to_string(k) +
-                       ", keyID=" + std::to_string(keyID));
-    }
+  if (k == 1 || ctxt.isEmpty())
+    return std::make_shared<Ctxt>(ctxt); // nothing to do
 
-    // Get the first key-switching matrix for this automorphism
-    const KeySwitch& W = pubKey.getNextKSWmatrix(k, keyID);
-    long amt = W.fromKey.getPowerOfX();
+  HELIB_COUNT_OP(automorphisms);
+  const Context& context = ctxt.getContext();
+  const PubKey& pubKey = ctxt.getPubKey();
+  // empty ctxt
+  std::shared_ptr<Ctxt> result = std::make_shared<Ctxt>(ZeroCtxtLike, ctxt);
+  result->noiseBound = noise; // noise estimate
+  result->intFactor = ctxt.intFactor;
 
-    // Start by rotating the constant part, no need to key-switch it
+  if (ctxt.parts.size() == 1) { // only constant part, no need to key-switch
     CtxtPart tmpPart = ctxt.parts[0];
-    tmpPart.automorph(amt);
+    tmpPart.automorph(k);
     tmpPart.addPrimesAndScale(context.specialPrimes);
     result->addPart(tmpPart, /*matchPrimeSet=*/true);
+    return result;
+  }
 
-    // Then rotate the digits and key-switch them
-    std::vector<DoubleCRT> tmpDigits = polyDigits;
-    for (auto&& tmp : tmpDigits) // rotate each of the digits
-      tmp.automorph(amt);
+  // Ensure that we have a key-switching matrices for this automorphism
+  long keyID = ctxt.getKeyID();
+  if (!pubKey.isReachable(k, keyID)) {
+    throw LogicError("no key-switching matrices for k=" + std::to_string(k) +
+                     ", keyID=" + std::to_string(keyID));
+  }
 
-    result->keySwitchDigits(W, tmpDigits); // key-switch the digits
+  // Get the first key-switching matrix for this automorphism
+  const KeySwitch& W = pubKey.getNextKSWmatrix(k, keyID);
+  long amt = W.fromKey.getPowerOfX();
 
-    long m = context.zMStar.getM();
-    if ((amt - k) % m != 0) { // amt != k (mod m), more automorphisms to do
-      k = NTL::MulMod(k, NTL::InvMod(amt, m), m); // k *= amt^{-1} mod m
-      result->smartAutomorph(k);                  // call usual smartAutomorph
-    }
-    return result;
+  // Start by rotating the constant part, no need to key-switch it
+  CtxtPart tmpPart = ctxt.parts[0];
+  tmpPart.automorph(amt);
+  tmpPart.addPrimesAndScale(context.specialPrimes);
+  result->addPart(tmpPart, /*matchPrimeSet=*/true);
+
+  // Then rotate the digits and key-switch them
+  std::vector<DoubleCRT> tmpDigits = polyDigits;
+  for (auto&& tmp : tmpDigits) // rotate each of the digits
+    tmp.automorph(amt);
+
+  result->keySwitchDigits(W, tmpDigits); // key-switch the digits
+
+  long m = context.zMStar.getM();
+  if ((amt - k) % m != 0) { // amt != k (mod m), more automorphisms to do
+    k = NTL::MulMod(k, NTL::InvMod(amt, m), m); // k *= amt^{-1} mod m
+    result->smartAutomorph(k);                  // call usual smartAutomorph
   }
-};
+  return result;
+}
 
 class GeneralAutomorphPrecon
 {
@@ -309,8 +306,32 @@ struct ConstMultiplier
   virtual std::shared_ptr<ConstMultiplier> upgrade(
       const Context& context) const = 0;
   // Upgrade to DCRT. Returns null if no upgrade required
+
+  virtual double getRows(long* rows,
+                         long stride,
+                         const IndexSet& s,
+                         const Context& context) const = 0;
+  // Writes the DCRT rows of the primes in s to rows, stride apart,
+  // and returns the size. Used by writeMappedExecs
+
+  virtual zzX getCoeffs() const = 0;
+  // The constant in zzX form. Used by writeMappedExecs
 };
 
+// Copies the rows of the primes in s of dcrt, which must all be there
+static void copyRows(long* rows,
+                     long stride,
+                     const IndexSet& s,
+                     const DoubleCRT& dcrt)
+{
+  long phim = dcrt.getContext().zMStar.getPhiM();
+  for (long i : s) {
+    const NTL::vec_long& row = dcrt.getMap()[i];
+    std::copy(row.elts(), row.elts() + phim, rows);
+    rows += stride;
+  }
+}
+
 struct ConstMultiplier_DoubleCRT : ConstMultiplier
 {
   DoubleCRT data;
@@ -327,6 +348,32 @@ struct ConstMultiplier_DoubleCRT : ConstMultiplier
   {
     return nullptr;
   }
+
+  double getRows(long* rows,
+                 long stride,
+                 const IndexSet& s,
+                 const Context& context) const override
+  {
+    if (data.getIndexSet() >= s)
+      copyRows(rows, stride, s, data);
+    else { // missing primes, e.g. the small ones
+      NTL::ZZX poly;
+      data.toPoly(poly);
+      copyRows(rows, stride, s, DoubleCRT(poly, context, s));
+    }
+    return sz;
+  }
+
+  zzX getCoeffs() const override
+  {
+    NTL::ZZX poly;
+    data.toPoly(poly); // balanced, and the constants are small
+    zzX coeffs;
+    coeffs.SetLength(poly.rep.length());
+    for (long i : range(coeffs.length()))
+      coeffs[i] = NTL::conv<long>(poly.rep[i]);
+    return coeffs;
+  }
 };
 
 struct ConstMultiplier_zzX : ConstMultiplier
@@ -345,6 +392,93 @@ struct ConstMultiplier_zzX : ConstMultiplier
         DoubleCRT(data, context, context.fullPrimes()),
         sz);
   }
+
+  double getRows(long* rows,
+                 long stride,
+                 const IndexSet& s,
+                 const Context& context) const override
+  {
+    copyRows(rows, stride, s, DoubleCRT(data, context, s));
+    return embeddingLargestCoeff(data, context.zMStar);
+  }
+
+  zzX getCoeffs() const override { return data; }
+};
+
+// A read-only mapping of a whole file, unmapped when the last
+// constant that points into it is gone
+class MappedFile
+{
+  void* addr;
+  std::size_t len;
+
+public:
+  explicit MappedFile(const std::string& fileName) : addr(MAP_FAILED), len(0)
+  {
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      len = st.st_size;
+      addr = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd); // the mapping stays valid
+  }
+
+  ~MappedFile()
+  {
+    if (addr != MAP_FAILED)
+      ::munmap(addr, len);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool isOpen() const { return addr != MAP_FAILED; }
+  const char* data() const { return static_cast<const char*>(addr); }
+  std::size_t size() const { return len; }
+};
+
+struct ConstMultiplier_Mapped : ConstMultiplier
+{
+  std::shared_ptr<const MappedFile> file; // keeps the rows mapped
+  std::vector<const long*> rows;          // indexed by prime, null if unused
+  double sz;
+
+  ConstMultiplier_Mapped(const std::shared_ptr<const MappedFile>& _file,
+                         const std::vector<const long*>& _rows,
+                         double _sz) :
+      file(_file), rows(_rows), sz(_sz)
+  {}
+
+  void mul(Ctxt& ctxt) const override { ctxt.multByConstant(rows, sz); }
+
+  std::shared_ptr<ConstMultiplier> upgrade(
+      UNUSED const Context& context) const override
+  {
+    return nullptr;
+  }
+
+  double getRows(long* out,
+                 long stride,
+                 const IndexSet& s,
+                 const Context& context) const override
+  {
+    long phim = context.zMStar.getPhiM();
+    for (long i : s) {
+      assertTrue(rows[i] != nullptr, "Mapped constant is missing a prime");
+      std::copy(rows[i], rows[i] + phim, out);
+      out += stride;
+    }
+    return sz;
+  }
+
+  zzX getCoeffs() const override
+  {
+    throw LogicError("A mapped DoubleCRT constant cannot be converted "
+                     "back to zzX form");
+  }
 };
 
 template <typename RX>
@@ -405,6 +539,151 @@ void ConstMultiplierCache::upgrade(const Context& context)
   NTL_EXEC_RANGE_END
 }
 
+// The constants of the caches of an exec object, converted to DoubleCRT
+// for a single mul(). They are used in groups (the giant steps) in an
+// order known in advance. With thread support, a background thread
+// converts the groups in that order, staying at most window groups ahead
+// of the computation; release(k) drops the converted forms of group k,
+// which keeps the memory used bounded. Without thread support, wait(k)
+// converts the group itself.
+class ConstMultiplierStream
+{
+public:
+  // groups[k] is the range [first, last) of indices of the kth group
+  ConstMultiplierStream(const Context& _context,
+                        long _window,
+                        const std::vector<std::pair<long, long>>& _groups,
+                        const ConstMultiplierCache& cache,
+                        const ConstMultiplierCache& cache1) :
+      context(_context),
+      window(std::max(_window, 1L)),
+      groups(_groups),
+      produced(0),
+      released(0),
+      stopping(false)
+  {
+    caches[0] = &cache;
+    caches[1] = &cache1;
+    for (long which : range(2))
+      converted[which].resize(caches[which]->multiplier.size());
+#ifdef HELIB_THREADS
+    worker = std::thread(&ConstMultiplierStream::run, this);
+#endif
+  }
+
+  ~ConstMultiplierStream()
+  {
+#ifdef HELIB_THREADS
+    {
+      std::lock_guard<std::mutex> lck(mtx);
+      stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+#endif
+  }
+
+  ConstMultiplierStream(const ConstMultiplierStream&) = delete;
+  ConstMultiplierStream& operator=(const ConstMultiplierStream&) = delete;
+
+  // Waits until group k is converted, rethrows any conversion error
+  void wait(long k)
+  {
+#ifdef HELIB_THREADS
+    std::unique_lock<std::mutex> lck(mtx);
+    cv.wait(lck, [this, k] { return produced > k || error; });
+    if (produced <= k)
+      std::rethrow_exception(error);
+#else
+    while (produced <= k)
+      convert(produced++);
+#endif
+  }
+
+  // Drops the converted constants of group k, groups are released in order
+  void release(long k)
+  {
+    for (long which : range(2))
+      for (long i : range(groups[k].first, groups[k].second))
+        if (i < lsize(converted[which]))
+          converted[which][i].reset();
+    {
+      HELIB_MUTEX_GUARD(mtx);
+      released++;
+    }
+#ifdef HELIB_THREADS
+    cv.notify_all();
+#endif
+  }
+
+  // Constant i of cache (which == 0) or cache1 (which == 1), whose group
+  // has been waited for and not yet released
+  const std::shared_ptr<ConstMultiplier>& get(long which, long i) const
+  {
+    return converted[which][i];
+  }
+
+private:
+  const Context& context;
+  const long window;
+  const std::vector<std::pair<long, long>> groups;
+  const ConstMultiplierCache* caches[2];
+  std::vector<std::shared_ptr<ConstMultiplier>> converted[2];
+
+  long produced; // number of groups converted
+  long released; // number of groups released
+  bool stopping;
+  std::exception_ptr error;
+  HELIB_MUTEX_TYPE mtx; // guards the four above
+
+  void convert(long k)
+  {
+    for (long which : range(2)) {
+      const auto& multiplier = caches[which]->multiplier;
+      for (long i : range(groups[k].first, groups[k].second)) {
+        if (i >= lsize(multiplier) || !multiplier[i])
+          continue;
+        auto newptr = multiplier[i]->upgrade(context);
+        converted[which][i] = newptr ? newptr : multiplier[i];
+      }
+    }
+  }
+
+#ifdef HELIB_THREADS
+  std::condition_variable cv;
+  std::thread worker;
+
+  void run()
+  {
+    for (long k : range(lsize(groups))) {
+      {
+        std::unique_lock<std::mutex> lck(mtx);
+        cv.wait(lck, [this, k] { return stopping || k - released < window; });
+        if (stopping)
+          return;
+      }
+
+      try {
+        convert(k);
+      } catch (...) {
+        {
+          std::lock_guard<std::mutex> lck(mtx);
+          error = std::current_exception();
+        }
+        cv.notify_all();
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lck(mtx);
+        produced = k + 1;
+      }
+      cv.notify_all();
+    }
+  }
+#endif
+};
+
 static inline long dimSz(const EncryptedArray& ea, long dim)
 {
   return (dim == ea.dimension()) ? 1 : ea.sizeOfDimension(dim);
@@ -801,6 +1080,257 @@ void GenBabySteps(std::vector<std::shared_ptr<Ctxt>>& v,
   }
 }
 
+// Baby steps v[j] = rot^j(ctxt) for mulStreaming: hoisted, or one
+// rotation at a time with the minimal key-switching strategy
+static void GenBabyStepsStreaming(std::vector<std::shared_ptr<Ctxt>>& v,
+                                  const Ctxt& ctxt,
+                                  long dim,
+                                  bool clean)
+{
+  if (ctxt.getPubKey().getKSStrategy(dim) != HELIB_KSS_MIN) {
+    GenBabySteps(v, ctxt, dim, clean);
+    return;
+  }
+
+  const PAlgebra& zMStar = ctxt.getContext().zMStar;
+  v[0] = std::make_shared<Ctxt>(ctxt);
+  for (long j : range(1, lsize(v))) {
+    v[j] = std::make_shared<Ctxt>(*v[j - 1]);
+    v[j]->smartAutomorph(zMStar.genToPow(dim, 1));
+    v[j]->cleanUp();
+  }
+}
+
+// In streaming mode the giant steps are done one at a time, in Horner
+// order as in the iterative case of mul, while the constants of the next
+// ones are converted in the background. The products within a giant step
+// are done in parallel.
+void MatMul1DExec::mulStreaming(Ctxt& ctxt) const
+{
+  HELIB_NTIMER_START(mulStreaming_MatMul1DExec);
+  const PAlgebra& zMStar = ea.getPAlgebra();
+  long h = divc(D, g);
+
+  // The nth group is giant step k = h-1-n, with constants [g*k, g*k+g)
+  std::vector<std::pair<long, long>> groups;
+  for (long k = h - 1; k >= 0; k--)
+    groups.emplace_back(g * k, std::min(g * k + g, D));
+  ConstMultiplierStream stream(ea.getContext(),
+                               streamWindow,
+                               groups,
+                               cache,
+                               cache1);
+
+  // For a non-native dimension, also baby_steps1[j] = rot^{j-D}(ctxt)
+  std::vector<std::shared_ptr<Ctxt>> baby_steps(g);
+  std::vector<std::shared_ptr<Ctxt>> baby_steps1(native ? 0 : g);
+  GenBabyStepsStreaming(baby_steps, ctxt, dim, native);
+  if (!native) {
+    Ctxt ctxt1(ctxt);
+    ctxt1.smartAutomorph(zMStar.genToPow(dim, -D));
+    GenBabyStepsStreaming(baby_steps1, ctxt1, dim, false);
+  }
+
+  Ctxt sum(ZeroCtxtLike, ctxt);
+  for (long n : range(h)) {
+    long k = h - 1 - n;
+    if (n > 0) {
+      sum.smartAutomorph(zMStar.genToPow(dim, g));
+      sum.cleanUp();
+    }
+
+    stream.wait(n);
+    long first_i = groups[n].first;
+    NTL::PartitionInfo pinfo(groups[n].second - first_i);
+    long cnt = pinfo.NumIntervals();
+    std::vector<Ctxt> acc(cnt, Ctxt(ZeroCtxtLike, ctxt));
+
+    // parallel for loop: j in [0..g), i = j + g * k
+    NTL_EXEC_INDEX(cnt, index)
+    long first, last;
+    pinfo.interval(first, last, index);
+    for (long j : range(first, last)) {
+      long i = j + g * k;
+      MulAdd(acc[index], stream.get(0, i), *baby_steps[j]);
+      if (!native)
+        MulAdd(acc[index], stream.get(1, i), *baby_steps1[j]);
+    }
+    NTL_EXEC_INDEX_END
+    stream.release(n);
+
+    for (const Ctxt& a : acc)
+      sum += a;
+  }
+  ctxt = sum;
+}
+
+void MatMulExecBase::mulMany(std::vector<Ctxt>& v) const
+{
+  // Nested parallel loops in mul run serially
+  NTL_EXEC_RANGE(lsize(v), first, last)
+  for (long i : range(first, last))
+    mul(v[i]);
+  NTL_EXEC_RANGE_END
+}
+
+// Checks that all the ciphertexts of a batch can be multiplied together
+static void checkBatch(const std::vector<Ctxt>& v, const EncryptedArray& ea)
+{
+  for (const Ctxt& ctxt : v) {
+    assertEq(&ea.getContext(),
+             &ctxt.getContext(),
+             "Cannot multiply ciphertexts with context different to "
+             "encrypted array one");
+    assertEq(&ctxt.getPubKey(),
+             &v[0].getPubKey(),
+             "All the ciphertexts of a batch must have the same key");
+  }
+}
+
+// The groups of constants that mulMany applies to the whole batch in
+// turn: the giant steps with BSGS, and about sqrt(D) rotations otherwise
+static std::vector<std::pair<long, long>> mulManyTiles(long D, long g)
+{
+  long sz = g ? g : KSGiantStepSize(D);
+  std::vector<std::pair<long, long>> tiles;
+  for (long first = 0; first < D; first += sz)
+    tiles.emplace_back(first, std::min(first + sz, D));
+  return tiles;
+}
+
+void MatMul1DExec::mulMany(std::vector<Ctxt>& v) const
+{
+  HELIB_NTIMER_START(mulMany_MatMul1DExec);
+
+  long n = lsize(v);
+  if (n <= 1) {
+    for (Ctxt& ctxt : v)
+      mul(ctxt);
+    return;
+  }
+  checkBatch(v, ea);
+
+  // The iterative strategy is bound by its sequential rotations, so the
+  // ciphertexts are just processed in parallel. Constants in zzX form are
+  // then converted to DoubleCRT once for the whole batch, unless
+  // streaming bounds the memory used.
+  if (v[0].getPubKey().getKSStrategy(dim) == HELIB_KSS_MIN ||
+      (!native && !ALT_MATMUL)) {
+    if (streamWindow > 0) {
+      for (Ctxt& ctxt : v)
+        mul(ctxt);
+      return;
+    }
+    MatMul1DExec batchExec(*this); // shares the constants
+    batchExec.upgrade();
+    batchExec.MatMulExecBase::mulMany(v);
+    return;
+  }
+
+  const PAlgebra& zMStar = ea.getPAlgebra();
+
+  // The hoisted rotations of each ciphertext: its baby steps with BSGS
+  // (and those of rot^{-D} of it in a non-native dimension), and the
+  // precomputation of all its rotations otherwise
+  std::vector<std::vector<std::shared_ptr<Ctxt>>> baby_steps(n);
+  std::vector<std::vector<std::shared_ptr<Ctxt>>> baby_steps1(n);
+  std::vector<std::shared_ptr<GeneralAutomorphPrecon>> precon(n);
+  std::vector<Ctxt> acc, acc1;
+  for (const Ctxt& ctxt : v) {
+    acc.emplace_back(ZeroCtxtLike, ctxt);
+    if (!native && g == 0)
+      acc1.emplace_back(ZeroCtxtLike, ctxt);
+  }
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long c : range(first, last)) {
+    v[c].cleanUp();
+    if (g == 0) {
+      precon[c] = buildGeneralAutomorphPrecon(v[c], dim, ea);
+      continue;
+    }
+    baby_steps[c].resize(g);
+    GenBabySteps(baby_steps[c], v[c], dim, native);
+    if (!native) {
+      Ctxt ctxt1(v[c]);
+      ctxt1.smartAutomorph(zMStar.genToPow(dim, -D));
+      baby_steps1[c].resize(g);
+      GenBabySteps(baby_steps1[c], ctxt1, dim, false);
+    }
+  }
+  NTL_EXEC_RANGE_END
+
+  // Each tile of constants is applied to the whole batch before moving on
+  // to the next, so that every constant is loaded once rather than once
+  // per ciphertext. The next tile is converted to DoubleCRT (if needed)
+  // in the background.
+  std::vector<std::pair<long, long>> tiles = mulManyTiles(D, g);
+  ConstMultiplierStream stream(ea.getContext(),
+                               std::max(streamWindow, 2L),
+                               tiles,
+                               cache,
+                               cache1);
+
+  for (long k : range(lsize(tiles))) {
+    stream.wait(k);
+    long first_i = tiles[k].first;
+    long last_i = tiles[k].second;
+
+    // parallel for loop over the ciphertexts, each thread applying every
+    // constant of the tile to all of its ciphertexts in turn
+    NTL_EXEC_RANGE(n, first, last)
+    if (g != 0) {
+      // giant step k: constants i = j + g * k for j in [0..g)
+      std::vector<Ctxt> acc_inner;
+      for (long c : range(first, last))
+        acc_inner.emplace_back(ZeroCtxtLike, v[c]);
+
+      for (long i : range(first_i, last_i)) {
+        long j = i - first_i;
+        for (long c : range(first, last)) {
+          MulAdd(acc_inner[c - first], stream.get(0, i), *baby_steps[c][j]);
+          if (!native)
+            MulAdd(acc_inner[c - first],
+                   stream.get(1, i),
+                   *baby_steps1[c][j]);
+        }
+      }
+
+      for (long c : range(first, last)) {
+        if (k > 0)
+          acc_inner[c - first].smartAutomorph(zMStar.genToPow(dim, g * k));
+        acc[c] += acc_inner[c - first];
+      }
+    } else {
+      for (long i : range(first_i, last_i)) {
+        if (!stream.get(0, i) && (native || !stream.get(1, i)))
+          continue;
+        for (long c : range(first, last)) {
+          std::shared_ptr<Ctxt> tmp = precon[c]->automorph(i);
+          if (native)
+            DestMulAdd(acc[c], stream.get(0, i), *tmp);
+          else {
+            MulAdd(acc[c], stream.get(0, i), *tmp);
+            DestMulAdd(acc1[c], stream.get(1, i), *tmp);
+          }
+        }
+      }
+    }
+    NTL_EXEC_RANGE_END
+    stream.release(k);
+  }
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long c : range(first, last)) {
+    if (!native && g == 0) {
+      acc1[c].smartAutomorph(zMStar.genToPow(dim, -D));
+      acc[c] += acc1[c];
+    }
+    v[c] = acc[c];
+  }
+  NTL_EXEC_RANGE_END
+}
+
 void MatMul1DExec::mul(Ctxt& ctxt) const
 {
   HELIB_NTIMER_START(mul_MatMul1DExec);
@@ -813,6 +1343,12 @@ void MatMul1DExec::mul(Ctxt& ctxt) const
 
   ctxt.cleanUp();
 
+  // mulStreaming uses the ALT_MATMUL form of the non-native constants
+  if (g != 0 && streamWindow > 0 && (native || ALT_MATMUL)) {
+    mulStreaming(ctxt);
+    return;
+  }
+
   bool iterative = false;
   if (ctxt.getPubKey().getKSStrategy(dim) == HELIB_KSS_MIN)
     iterative = true;
@@ -1515,6 +2051,119 @@ BlockMatMul1DExec::BlockMatMul1DExec(const BlockMatMul1D& mat,
                                            strategy);
 }
 
+void BlockMatMul1DExec::mulMany(std::vector<Ctxt>& v) const
+{
+  HELIB_NTIMER_START(mulMany_BlockMatMul1DExec);
+
+  long n = lsize(v);
+  if (n <= 1) {
+    for (Ctxt& ctxt : v)
+      mul(ctxt);
+    return;
+  }
+  checkBatch(v, ea);
+
+  long d0, d1;
+  long dim0, dim1;
+
+  if (strategy == +1) {
+    d0 = D;
+    dim0 = dim;
+    d1 = d;
+    dim1 = -1;
+  } else {
+    d1 = D;
+    dim1 = dim;
+    d0 = d;
+    dim0 = -1;
+  }
+
+  // As for MatMul1DExec
+  if (strategy == 0 || v[0].getPubKey().getKSStrategy(dim0) == HELIB_KSS_MIN) {
+    if (streamWindow > 0) {
+      for (Ctxt& ctxt : v)
+        mul(ctxt);
+      return;
+    }
+    BlockMatMul1DExec batchExec(*this); // shares the constants
+    batchExec.upgrade();
+    batchExec.MatMulExecBase::mulMany(v);
+    return;
+  }
+
+  const PAlgebra& zMStar = ea.getPAlgebra();
+
+  // The hoisted rotations of each ciphertext along dim0, and its d1
+  // accumulators (twice that in a non-native dimension)
+  std::vector<std::shared_ptr<GeneralAutomorphPrecon>> precon(n);
+  std::vector<std::vector<Ctxt>> acc(n), acc1(native ? 0 : n);
+  NTL_EXEC_RANGE(n, first, last)
+  for (long c : range(first, last)) {
+    v[c].cleanUp();
+    precon[c] = buildGeneralAutomorphPrecon(v[c], dim0, ea);
+    acc[c].assign(d1, Ctxt(ZeroCtxtLike, v[c]));
+    if (!native)
+      acc1[c].assign(d1, Ctxt(ZeroCtxtLike, v[c]));
+  }
+  NTL_EXEC_RANGE_END
+
+  // The constants [i*d1, (i+1)*d1) of each rotation i in [0..d0) are
+  // applied to the whole batch before moving on to the next rotation
+  std::vector<std::pair<long, long>> tiles;
+  for (long i : range(d0))
+    tiles.emplace_back(i * d1, (i + 1) * d1);
+  ConstMultiplierStream stream(ea.getContext(),
+                               std::max(streamWindow, 2L),
+                               tiles,
+                               cache,
+                               cache1);
+
+  for (long i : range(d0)) {
+    stream.wait(i);
+
+    // parallel for loop over the ciphertexts, each thread applying every
+    // constant of the tile to all of its ciphertexts in turn
+    NTL_EXEC_RANGE(n, first, last)
+    std::vector<std::shared_ptr<Ctxt>> sh_ctxt;
+    for (long c : range(first, last))
+      sh_ctxt.push_back(precon[c]->automorph(i));
+
+    for (long j : range(d1)) {
+      for (long c : range(first, last)) {
+        MulAdd(acc[c][j], stream.get(0, i * d1 + j), *sh_ctxt[c - first]);
+        if (!native)
+          MulAdd(acc1[c][j], stream.get(1, i * d1 + j), *sh_ctxt[c - first]);
+      }
+    }
+    NTL_EXEC_RANGE_END
+    stream.release(i);
+  }
+
+  // Sum the rotations of the accumulators along dim1, in Horner order as
+  // the work is already spread over the ciphertexts
+  NTL_EXEC_RANGE(n, first, last)
+  for (long c : range(first, last)) {
+    Ctxt sum(acc[c][d1 - 1]);
+    for (long j = d1 - 2; j >= 0; j--) {
+      sum.smartAutomorph(zMStar.genToPow(dim1, 1));
+      sum.cleanUp();
+      sum += acc[c][j];
+    }
+    if (!native) {
+      Ctxt sum1(acc1[c][d1 - 1]);
+      for (long j = d1 - 2; j >= 0; j--) {
+        sum1.smartAutomorph(zMStar.genToPow(dim1, 1));
+        sum1.cleanUp();
+        sum1 += acc1[c][j];
+      }
+      sum1.smartAutomorph(zMStar.genToPow(dim, -D));
+      sum += sum1;
+    }
+    v[c] = sum;
+  }
+  NTL_EXEC_RANGE_END
+}
+
 void BlockMatMul1DExec::mul(Ctxt& ctxt) const
 {
   HELIB_NTIMER_START(mul_BlockMatMul1DExec);
@@ -1587,6 +2236,26 @@ void BlockMatMul1DExec::mul(Ctxt& ctxt) const
     dim0 = -1;
   }
 
+  // In streaming mode, the constants [i*d1, (i+1)*d1) of each rotation i
+  // in [0..d0) are converted ahead of time
+  std::unique_ptr<ConstMultiplierStream> stream;
+  if (streamWindow > 0) {
+    std::vector<std::pair<long, long>> groups;
+    for (long i : range(d0))
+      groups.emplace_back(i * d1, (i + 1) * d1);
+    stream.reset(new ConstMultiplierStream(ea.getContext(),
+                                           streamWindow,
+                                           groups,
+                                           cache,
+                                           cache1));
+  }
+  auto constant = [&](long which,
+                      long i) -> const std::shared_ptr<ConstMultiplier>& {
+    if (stream)
+      return stream->get(which, i);
+    return (which == 0 ? cache : cache1).multiplier[i];
+  };
+
   const long par_buf_max = 50;
 
   bool iterative0 = false;
@@ -1612,9 +2281,13 @@ void BlockMatMul1DExec::mul(Ctxt& ctxt) const
           sh_ctxt.smartAutomorph(zMStar.genToPow(dim0, 1));
           sh_ctxt.cleanUp();
         }
+        if (stream)
+          stream->wait(i);
         for (long j : range(d1)) {
-          MulAdd(acc[j], cache.multiplier[i * d1 + j], sh_ctxt);
+          MulAdd(acc[j], constant(0, i * d1 + j), sh_ctxt);
         }
+        if (stream)
+          stream->release(i);
       }
     } else {
 
@@ -1624,6 +2297,8 @@ void BlockMatMul1DExec::mul(Ctxt& ctxt) const
       long par_buf_sz = 1;
       if (NTL::AvailableThreads() > 1)
         par_buf_sz = std::min(d0, par_buf_max);
+      if (stream) // the whole buffer must fit in the window
+        par_buf_sz = std::min(par_buf_sz, streamWindow);
 
       std::vector<std::shared_ptr<Ctxt>> par_buf(par_buf_sz);
 
@@ -1642,15 +2317,23 @@ void BlockMatMul1DExec::mul(Ctxt& ctxt) const
 
         NTL_EXEC_RANGE_END
 
+        if (stream)
+          for (long i : range(first_i, last_i))
+            stream->wait(i);
+
         NTL_EXEC_RANGE(d1, first, last)
 
         for (long j : range(first, last)) {
           for (long i : range(first_i, last_i)) {
-            MulAdd(acc[j], cache.multiplier[i * d1 + j], *par_buf[i - first_i]);
+            MulAdd(acc[j], constant(0, i * d1 + j), *par_buf[i - first_i]);
           }
         }
 
         NTL_EXEC_RANGE_END
+
+        if (stream)
+          for (long i : range(first_i, last_i))
+            stream->release(i);
       }
     }
 
@@ -1700,10 +2383,14 @@ void BlockMatMul1DExec::mul(Ctxt& ctxt) const
           sh_ctxt.smartAutomorph(zMStar.genToPow(dim0, 1));
           sh_ctxt.cleanUp();
         }
+        if (stream)
+          stream->wait(i);
         for (long j : range(d1)) {
-          MulAdd(acc[j], cache.multiplier[i * d1 + j], sh_ctxt);
-          MulAdd(acc1[j], cache1.multiplier[i * d1 + j], sh_ctxt);
+          MulAdd(acc[j], constant(0, i * d1 + j), sh_ctxt);
+          MulAdd(acc1[j], constant(1, i * d1 + j), sh_ctxt);
         }
+        if (stream)
+          stream->release(i);
       }
     } else {
 
@@ -1713,6 +2400,8 @@ void BlockMatMul1DExec::mul(Ctxt& ctxt) const
       long par_buf_sz = 1;
       if (NTL::AvailableThreads() > 1)
         par_buf_sz = std::min(d0, par_buf_max);
+      if (stream) // the whole buffer must fit in the window
+        par_buf_sz = std::min(par_buf_sz, streamWindow);
 
       std::vector<std::shared_ptr<Ctxt>> par_buf(par_buf_sz);
 
@@ -1731,18 +2420,24 @@ void BlockMatMul1DExec::mul(Ctxt& ctxt) const
 
         NTL_EXEC_RANGE_END
 
+        if (stream)
+          for (long i : range(first_i, last_i))
+            stream->wait(i);
+
         NTL_EXEC_RANGE(d1, first, last)
 
         for (long j : range(first, last)) {
           for (long i : range(first_i, last_i)) {
-            MulAdd(acc[j], cache.multiplier[i * d1 + j], *par_buf[i - first_i]);
-            MulAdd(acc1[j],
-                   cache1.multiplier[i * d1 + j],
-                   *par_buf[i - first_i]);
+            MulAdd(acc[j], constant(0, i * d1 + j), *par_buf[i - first_i]);
+            MulAdd(acc1[j], constant(1, i * d1 + j), *par_buf[i - first_i]);
           }
         }
 
         NTL_EXEC_RANGE_END
+
+        if (stream)
+          for (long i : range(first_i, last_i))
+            stream->release(i);
       }
     }
 
@@ -2091,6 +2786,124 @@ void MatMulFullExec::mul(Ctxt& ctxt) const
   ctxt = acc;
 }
 
+// As rec_mul, for a batch: the transforms are applied to the whole batch
+// with mulMany, and the rotations are done in parallel over the batch
+long MatMulFullExec::rec_mulMany(std::vector<Ctxt>& acc,
+                                 const std::vector<Ctxt>& v,
+                                 long dim_idx,
+                                 long idx) const
+{
+  long n = lsize(v);
+
+  if (dim_idx >= ea.dimension() - 1) {
+    // Last dimension (recursion edge condition)
+
+    std::vector<Ctxt> tmp(v);
+    transforms[idx].mulMany(tmp);
+    for (long c : range(n))
+      acc[c] += tmp[c];
+
+    return idx + 1;
+  }
+
+  long dim = dims[dim_idx];
+  long sdim = ea.sizeOfDimension(dim);
+  bool native = ea.nativeDimension(dim);
+  const PAlgebra& zMStar = ea.getPAlgebra();
+
+  bool iterative = false;
+  if (v[0].getPubKey().getKSStrategy(dim) == HELIB_KSS_MIN)
+    iterative = true;
+
+  // The rotations of each ciphertext by offset i: hoisted, or one at a
+  // time with the minimal key-switching strategy. In a non-native
+  // dimension, also those of rot^{-sdim} of each ciphertext.
+  std::vector<std::shared_ptr<GeneralAutomorphPrecon>> precon(n);
+  std::vector<std::shared_ptr<GeneralAutomorphPrecon>> precon1(n);
+  std::vector<Ctxt> sh_ctxt, sh_ctxt1;
+  if (iterative)
+    sh_ctxt = v;
+  if (!native)
+    sh_ctxt1 = v;
+  NTL_EXEC_RANGE(n, first, last)
+  for (long c : range(first, last)) {
+    if (!native)
+      sh_ctxt1[c].smartAutomorph(zMStar.genToPow(dim, -sdim));
+    if (!iterative) {
+      precon[c] = buildGeneralAutomorphPrecon(v[c], dim, ea);
+      if (!native)
+        precon1[c] = buildGeneralAutomorphPrecon(sh_ctxt1[c], dim, ea);
+    }
+  }
+  NTL_EXEC_RANGE_END
+
+  std::vector<Ctxt> tmp(v);
+  for (long i : range(sdim)) {
+    if (i == 0) {
+      idx = rec_mulMany(acc, v, dim_idx + 1, idx);
+      continue;
+    }
+
+    // The mask is the same for the whole batch
+    zzX mask;
+    double sz = 0;
+    if (!native) {
+      mask = ea.getAlMod().getMask_zzX(dim, i);
+      sz = embeddingLargestCoeff(mask, zMStar);
+    }
+
+    NTL_EXEC_RANGE(n, first, last)
+    for (long c : range(first, last)) {
+      if (iterative)
+        sh_ctxt[c].smartAutomorph(zMStar.genToPow(dim, 1));
+      tmp[c] = iterative ? sh_ctxt[c] : *precon[c]->automorph(i);
+      if (native)
+        continue;
+
+      if (iterative)
+        sh_ctxt1[c].smartAutomorph(zMStar.genToPow(dim, 1));
+      Ctxt tmp1 = iterative ? sh_ctxt1[c] : *precon1[c]->automorph(i);
+
+      DoubleCRT m1(mask,
+                   ea.getContext(),
+                   tmp[c].getPrimeSet() | tmp1.getPrimeSet());
+
+      // Compute tmp = tmp*m1 + tmp1 - tmp1*m1
+      tmp[c].multByConstant(m1, sz);
+      tmp[c] += tmp1;
+      tmp1.multByConstant(m1, sz);
+      tmp[c] -= tmp1;
+    }
+    NTL_EXEC_RANGE_END
+
+    idx = rec_mulMany(acc, tmp, dim_idx + 1, idx);
+  }
+
+  return idx;
+}
+
+void MatMulFullExec::mulMany(std::vector<Ctxt>& v) const
+{
+  HELIB_NTIMER_START(mulMany_MatMulFullExec);
+
+  if (v.size() <= 1) {
+    for (Ctxt& ctxt : v)
+      mul(ctxt);
+    return;
+  }
+  checkBatch(v, ea);
+  assertTrue(ea.size() > 1l, "Number of slots is less than 2");
+
+  std::vector<Ctxt> acc;
+  for (Ctxt& ctxt : v) {
+    ctxt.cleanUp();
+    acc.emplace_back(ZeroCtxtLike, ctxt);
+  }
+  rec_mulMany(acc, v, 0, 0);
+
+  v = acc;
+}
+
 // ================= BlockMatMulFull stuff ===============
 
 // lightly massaged version of MatMulFull code...some unfortunate
@@ -2642,6 +3455,571 @@ void mul(PlaintextArray& pa, const BlockMatMulFull& mat)
   ea.dispatch<mul_BlockMatMulFull_impl>(pa, mat);
 }
 
+//================= Memory-mapped exec objects ====================
+
+// Bump this whenever the format of the mapped files changes
+#define MAPPED_EXECS_VERSION 2
+
+// The constants are aligned for vector loads, and start on a new page
+#define MAPPED_EXECS_ALIGN (64)
+#define MAPPED_EXECS_PAGE (4096)
+
+enum MappedExecType
+{
+  MAPPED_NULL = 0,
+  MAPPED_MATMUL1D = 1,
+  MAPPED_BLOCKMATMUL1D = 2,
+  MAPPED_MATMULFULL = 3,
+  MAPPED_BLOCKMATMULFULL = 4
+};
+
+static long roundUp(long n, long k) { return (n + k - 1) / k * k; }
+
+NTL::ZZX getG(const EncryptedArray& ea); // defined in Context.cpp
+
+// The polynomial G of the slots, or zero for CKKS
+static NTL::ZZX mappedG(const EncryptedArray& ea)
+{
+  return ea.getTag() == PA_cx_tag ? NTL::ZZX() : getG(ea);
+}
+
+// The type and parameters of an exec object, with the two caches of a 1D
+// object or the 1D transforms of a full one
+struct MappedExecInfo
+{
+  long type;
+  std::vector<long> fields;
+  std::vector<const ConstMultiplierCache*> caches;
+  std::vector<MappedExecInfo> parts;
+
+  explicit MappedExecInfo(const MatMulExecBase* exec) : type(MAPPED_NULL)
+  {
+    if (exec == nullptr)
+      return;
+    if (auto p = dynamic_cast<const MatMul1DExec*>(exec)) {
+      type = MAPPED_MATMUL1D;
+      fields = {p->dim, p->D, p->native, p->minimal, p->g};
+      caches = {&p->cache, &p->cache1};
+    } else if (auto p = dynamic_cast<const BlockMatMul1DExec*>(exec)) {
+      type = MAPPED_BLOCKMATMUL1D;
+      fields = {p->dim, p->D, p->d, p->native, p->strategy};
+      caches = {&p->cache, &p->cache1};
+    } else if (auto p = dynamic_cast<const MatMulFullExec*>(exec)) {
+      type = MAPPED_MATMULFULL;
+      setFull(p->minimal, p->dims, p->transforms);
+    } else if (auto p = dynamic_cast<const BlockMatMulFullExec*>(exec)) {
+      type = MAPPED_BLOCKMATMULFULL;
+      setFull(p->minimal, p->dims, p->transforms);
+    } else {
+      throw LogicError("writeMappedExecs: unknown exec object");
+    }
+  }
+
+  template <typename T>
+  void setFull(bool minimal,
+               const std::vector<long>& dims,
+               const std::vector<T>& transforms)
+  {
+    fields = {minimal, lsize(dims)};
+    fields.insert(fields.end(), dims.begin(), dims.end());
+    fields.push_back(lsize(transforms));
+    for (const T& t : transforms)
+      parts.emplace_back(&t);
+  }
+
+  // Appends the constants, in the order in which write numbers them
+  void collect(std::vector<const ConstMultiplier*>& consts) const
+  {
+    for (const ConstMultiplierCache* cache : caches)
+      for (const auto& c : cache->multiplier)
+        if (c)
+          consts.push_back(c.get());
+    for (const MappedExecInfo& part : parts)
+      part.collect(consts);
+  }
+
+  // Writes the structure, with the offsets of the constants from offset on
+  void write(std::ostream& str, long& offset, long constBytes) const
+  {
+    write_raw_int(str, type);
+    for (long f : fields)
+      write_raw_int(str, f);
+    for (const ConstMultiplierCache* cache : caches) {
+      write_raw_int(str, cache->multiplier.size());
+      for (const auto& c : cache->multiplier) {
+        write_raw_int(str, c ? offset : 0);
+        if (c)
+          offset += constBytes;
+      }
+    }
+    for (const MappedExecInfo& part : parts)
+      part.write(str, offset, constBytes);
+  }
+};
+
+// Everything but the constants themselves. The constants are numbered in
+// order, each taking constBytes bytes from dataStart on.
+static void writeMappedMeta(std::ostream& str,
+                            const std::string& header,
+                            const EncryptedArray& ea,
+                            bool dcrt,
+                            long stride,
+                            const std::vector<MappedExecInfo>& infos,
+                            long dataStart,
+                            long constBytes)
+{
+  writeEyeCatcher(str, BINIO_EYE_MAPPEDEXECS_BEGIN);
+  write_raw_int(str, MAPPED_EXECS_VERSION);
+  write_raw_int(str, sizeof(long));
+  long order = 1; // the constants are in native byte order
+  str.write(reinterpret_cast<const char*>(&order), sizeof(long));
+
+  write_raw_int(str, header.size());
+  str.write(header.data(), header.size());
+  write_raw_int(str, dcrt);
+
+  // The plaintext space and the slots that the constants encode
+  const Context& context = ea.getContext();
+  write_raw_int(str, context.zMStar.getM());
+  write_raw_int(str, context.zMStar.getP());
+  write_raw_int(str, ea.getAlMod().getPPowR());
+  write_raw_int(str, ea.dimension());
+  for (long i : range(ea.dimension())) {
+    write_raw_int(str, ea.sizeOfDimension(i));
+    write_raw_int(str, ea.nativeDimension(i));
+  }
+  NTL::ZZX G = mappedG(ea);
+  write_raw_int(str, deg(G) + 1);
+  for (long i = 0; i <= deg(G); i++)
+    write_raw_int(str, NTL::conv<long>(coeff(G, i)));
+
+  // The zzX constants do not depend on the primes
+  write_raw_int(str, context.zMStar.getPhiM());
+  if (dcrt) {
+    const IndexSet s = context.allPrimes();
+    write_raw_int(str, s.card());
+    for (long i : s) {
+      write_raw_int(str, i);
+      write_raw_int(str, context.ithPrime(i));
+    }
+  }
+  write_raw_int(str, stride);
+  write_raw_int(str, dataStart);
+
+  write_raw_int(str, infos.size());
+  long offset = dataStart;
+  for (const MappedExecInfo& info : infos)
+    info.write(str, offset, constBytes);
+  writeEyeCatcher(str, BINIO_EYE_MAPPEDEXECS_END);
+}
+
+bool writeMappedExecs(const std::string& fileName,
+                      const std::string& header,
+                      const std::vector<const MatMulExecBase*>& execs,
+                      bool dcrt)
+{
+  HELIB_TIMER_START;
+
+  std::vector<MappedExecInfo> infos;
+  const EncryptedArray* ea = nullptr;
+  for (const MatMulExecBase* exec : execs) {
+    infos.emplace_back(exec);
+    if (exec)
+      ea = &exec->getEA();
+  }
+  if (ea == nullptr)
+    return false; // nothing to write
+  const Context& context = ea->getContext();
+  if (!dcrt && ea->getTag() == PA_cx_tag)
+    throw LogicError("writeMappedExecs: CKKS constants must be in "
+                     "DoubleCRT form");
+
+  // Each constant is its size (padded to an aligned block), followed by
+  // its rows modulo all the primes, each padded to an aligned length.
+  // In zzX form, it is its length followed by its coefficients.
+  const IndexSet s = context.allPrimes();
+  const long phim = context.zMStar.getPhiM();
+  const long stride = roundUp(phim, MAPPED_EXECS_ALIGN / sizeof(long));
+  const long constLongs =
+      (MAPPED_EXECS_ALIGN / sizeof(long)) + (dcrt ? s.card() : 1) * stride;
+  const long constBytes = constLongs * sizeof(long);
+
+  std::vector<const ConstMultiplier*> consts;
+  for (const MappedExecInfo& info : infos)
+    info.collect(consts);
+
+  // The metadata does not depend on dataStart for its length
+  std::ostringstream probe;
+  writeMappedMeta(probe, header, *ea, dcrt, stride, infos, 0, constBytes);
+  const long dataStart = roundUp(probe.str().size(), MAPPED_EXECS_PAGE);
+
+  // Write to a temporary file then rename it, so that concurrent readers
+  // never see a partial file
+  std::ostringstream tmpName;
+  tmpName << fileName << ".tmp" << std::random_device{}();
+  {
+    std::ofstream str(tmpName.str(), std::ios::binary);
+    if (!str.is_open())
+      return false;
+
+    std::ostringstream meta;
+    writeMappedMeta(meta,
+                    header,
+                    *ea,
+                    dcrt,
+                    stride,
+                    infos,
+                    dataStart,
+                    constBytes);
+    std::string metaStr = meta.str();
+    metaStr.resize(dataStart, '\0');
+    str.write(metaStr.data(), metaStr.size());
+
+    // Convert the constants a batch at a time, so as not to hold them
+    // all in memory at once
+    long batch = std::max(1L, NTL::AvailableThreads());
+    std::vector<std::vector<long>> bufs(batch);
+    for (long start = 0; start < lsize(consts); start += batch) {
+      long cnt = std::min(batch, lsize(consts) - start);
+      NTL_EXEC_RANGE(cnt, first, last)
+      for (long k : range(first, last)) {
+        std::vector<long>& buf = bufs[k];
+        buf.assign(constLongs, 0);
+        long* data = buf.data() + MAPPED_EXECS_ALIGN / sizeof(long);
+        if (dcrt) {
+          double sz = consts[start + k]->getRows(data, stride, s, context);
+          std::memcpy(buf.data(), &sz, sizeof(double));
+        } else {
+          zzX coeffs = consts[start + k]->getCoeffs();
+          assertTrue(coeffs.length() <= stride,
+                     "writeMappedExecs: constant of degree above phi(m)");
+          buf[0] = coeffs.length();
+          std::copy(coeffs.elts(), coeffs.elts() + coeffs.length(), data);
+        }
+      }
+      NTL_EXEC_RANGE_END
+      for (long k : range(cnt))
+        str.write(reinterpret_cast<const char*>(bufs[k].data()), constBytes);
+    }
+
+    if (!str.flush()) {
+      str.close();
+      std::remove(tmpName.str().c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmpName.str().c_str(), fileName.c_str()) != 0) {
+    std::remove(tmpName.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool MatMulExecBase::write(const std::string& fileName,
+                           const std::string& header,
+                           bool dcrt) const
+{
+  return writeMappedExecs(fileName, header, {this}, dcrt);
+}
+
+// An input stream over a memory buffer, without copying it
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+  MemoryStreamBuf(const char* data, std::size_t len)
+  {
+    char* p = const_cast<char*>(data); // only ever read
+    setg(p, p, p + len);
+  }
+};
+
+// Throws RuntimeError, to be caught by readMappedExecs
+static long readMappedInt(std::istream& str, long lo, long hi)
+{
+  long n = read_raw_int(str);
+  if (!str || n < lo || n > hi)
+    throw RuntimeError("Bad mapped exec file");
+  return n;
+}
+
+// Reads the exec objects of a mapped file, checking everything against ea.
+// Throws RuntimeError, to be caught by readMappedExecs
+class MappedExecReader
+{
+  const EncryptedArray& ea;
+  const Context& context;
+  std::shared_ptr<const MappedFile> file;
+  MemoryStreamBuf buf;
+  std::istream str;
+  const IndexSet s;
+  const long size;
+
+  bool dcrt = true;
+  long stride = 0;
+  long dataStart = 0;
+  long constBytes = 0;
+
+  long readInt(long lo, long hi) { return readMappedInt(str, lo, hi); }
+
+  void readHeader(const std::string& header)
+  {
+    if (readEyeCatcher(str, BINIO_EYE_MAPPEDEXECS_BEGIN) != 0)
+      throw RuntimeError("Bad mapped exec file");
+    readInt(MAPPED_EXECS_VERSION, MAPPED_EXECS_VERSION);
+    readInt(sizeof(long), sizeof(long));
+    long order = 0;
+    str.read(reinterpret_cast<char*>(&order), sizeof(long));
+    if (order != 1)
+      throw RuntimeError("Mapped exec file of a different byte order");
+
+    long headerLen = readInt(0, size);
+    std::string fileHeader(headerLen, '\0');
+    if (!str.read(&fileHeader[0], headerLen) || fileHeader != header)
+      throw RuntimeError("Mapped exec file header mismatch");
+    dcrt = readInt(0, 1);
+
+    const long m = context.zMStar.getM();
+    const long p = context.zMStar.getP();
+    const long p2r = ea.getAlMod().getPPowR();
+    readInt(m, m);
+    readInt(p, p);
+    readInt(p2r, p2r);
+    readInt(ea.dimension(), ea.dimension());
+    for (long i : range(ea.dimension())) {
+      readInt(ea.sizeOfDimension(i), ea.sizeOfDimension(i));
+      readInt(ea.nativeDimension(i), ea.nativeDimension(i));
+    }
+    NTL::ZZX G = mappedG(ea);
+    readInt(deg(G) + 1, deg(G) + 1);
+    for (long i = 0; i <= deg(G); i++) {
+      long c = NTL::conv<long>(coeff(G, i));
+      readInt(c, c);
+    }
+
+    const long phim = context.zMStar.getPhiM();
+    readInt(phim, phim);
+    if (dcrt) {
+      readInt(s.card(), s.card());
+      for (long i : s) {
+        readInt(i, i);
+        readInt(context.ithPrime(i), context.ithPrime(i));
+      }
+    }
+    stride = readInt(phim, size);
+    dataStart = readInt(0, size);
+    constBytes =
+        MAPPED_EXECS_ALIGN + (dcrt ? s.card() : 1) * stride * sizeof(long);
+  }
+
+  // A constant at the given offset, or null
+  std::shared_ptr<ConstMultiplier> readConst()
+  {
+    long offset = readInt(0, std::max(0L, size - constBytes));
+    if (offset == 0)
+      return nullptr;
+    if (offset < dataStart || offset % MAPPED_EXECS_ALIGN != 0)
+      throw RuntimeError("Bad constant offset in mapped exec file");
+    const char* p = file->data() + offset;
+    const long* row = reinterpret_cast<const long*>(p + MAPPED_EXECS_ALIGN);
+
+    if (!dcrt) { // copied, it is converted to DoubleCRT when used
+      long len;
+      std::memcpy(&len, p, sizeof(long));
+      if (len < 0 || len > stride)
+        throw RuntimeError("Bad constant length in mapped exec file");
+      zzX data;
+      data.SetLength(len);
+      std::copy(row, row + len, data.elts());
+      return std::make_shared<ConstMultiplier_zzX>(data);
+    }
+
+    double sz;
+    std::memcpy(&sz, p, sizeof(double));
+    std::vector<const long*> rows(context.numPrimes(), nullptr);
+    for (long i : s) {
+      rows[i] = row;
+      row += stride;
+    }
+    return std::make_shared<ConstMultiplier_Mapped>(file, rows, sz);
+  }
+
+  // Reads a cache, which must have either 0 or n entries
+  void readCache(ConstMultiplierCache& cache, long n)
+  {
+    long len = readInt(0, n);
+    if (len != 0 && len != n)
+      throw RuntimeError("Bad cache length in mapped exec file");
+    cache.multiplier.resize(len);
+    for (auto& c : cache.multiplier)
+      c = readConst();
+  }
+
+  std::unique_ptr<MatMul1DExec> readMatMul1D()
+  {
+    long dim = readInt(0, ea.dimension());
+    long D = readInt(dimSz(ea, dim), dimSz(ea, dim));
+    long native = dimNative(ea, dim);
+    std::unique_ptr<MatMul1DExec> exec(new MatMul1DExec(ea));
+    exec->dim = dim;
+    exec->D = D;
+    exec->native = readInt(native, native);
+    exec->minimal = readInt(0, 1);
+    exec->g = readInt(0, D);
+    readCache(exec->cache, D);
+    readCache(exec->cache1, D);
+    return exec;
+  }
+
+  std::unique_ptr<BlockMatMul1DExec> readBlockMatMul1D()
+  {
+    long dim = readInt(0, ea.dimension());
+    long D = readInt(dimSz(ea, dim), dimSz(ea, dim));
+    long native = dimNative(ea, dim);
+    std::unique_ptr<BlockMatMul1DExec> exec(new BlockMatMul1DExec(ea));
+    exec->dim = dim;
+    exec->D = D;
+    exec->d = readInt(ea.getDegree(), ea.getDegree());
+    exec->native = readInt(native, native);
+    exec->strategy = readInt(-1, 1);
+    if (exec->strategy == 0)
+      throw RuntimeError("Bad strategy in mapped exec file");
+    readCache(exec->cache, D * exec->d);
+    readCache(exec->cache1, D * exec->d);
+    return exec;
+  }
+
+  // The 1D transforms of the full objects
+  void readParts(std::vector<MatMul1DExec>& parts, long n)
+  {
+    for (long i = 0; i < n; i++) {
+      readInt(MAPPED_MATMUL1D, MAPPED_MATMUL1D);
+      parts.push_back(std::move(*readMatMul1D()));
+    }
+  }
+
+  void readParts(std::vector<BlockMatMul1DExec>& parts, long n)
+  {
+    for (long i = 0; i < n; i++) {
+      readInt(MAPPED_BLOCKMATMUL1D, MAPPED_BLOCKMATMUL1D);
+      parts.push_back(std::move(*readBlockMatMul1D()));
+    }
+  }
+
+  template <typename T>
+  std::unique_ptr<T> readFull()
+  {
+    std::unique_ptr<T> exec(new T(ea));
+    exec->minimal = readInt(0, 1);
+    long n = readInt(ea.dimension(), ea.dimension());
+    for (long i = 0; i < n; i++)
+      exec->dims.push_back(readInt(0, ea.dimension() - 1));
+    readParts(exec->transforms, readInt(1, size));
+    return exec;
+  }
+
+  std::unique_ptr<MatMulExecBase> readExec()
+  {
+    switch (readInt(MAPPED_NULL, MAPPED_BLOCKMATMULFULL)) {
+    case MAPPED_MATMUL1D:
+      return readMatMul1D();
+    case MAPPED_BLOCKMATMUL1D:
+      return readBlockMatMul1D();
+    case MAPPED_MATMULFULL:
+      return readFull<MatMulFullExec>();
+    case MAPPED_BLOCKMATMULFULL:
+      return readFull<BlockMatMulFullExec>();
+    default:
+      return nullptr;
+    }
+  }
+
+public:
+  MappedExecReader(const EncryptedArray& _ea,
+                   const std::shared_ptr<const MappedFile>& _file) :
+      ea(_ea),
+      context(_ea.getContext()),
+      file(_file),
+      buf(_file->data(), _file->size()),
+      str(&buf),
+      s(context.allPrimes()),
+      size(_file->size())
+  {}
+
+  std::vector<std::unique_ptr<MatMulExecBase>> read(
+      const std::string& header)
+  {
+    readHeader(header);
+    std::vector<std::unique_ptr<MatMulExecBase>> execs;
+    long nExecs = readInt(0, size);
+    for (long k = 0; k < nExecs; k++)
+      execs.push_back(readExec());
+    if (readEyeCatcher(str, BINIO_EYE_MAPPEDEXECS_END) != 0)
+      throw RuntimeError("Bad mapped exec file");
+    return execs;
+  }
+};
+
+std::vector<std::unique_ptr<MatMulExecBase>> readMappedExecs(
+    const std::string& fileName,
+    const std::string& header,
+    const EncryptedArray& ea)
+{
+  HELIB_TIMER_START;
+
+  auto file = std::make_shared<const MappedFile>(fileName);
+  if (!file->isOpen())
+    return {};
+
+  try {
+    return MappedExecReader(ea, file).read(header);
+  } catch (const RuntimeError&) {
+    return {}; // stale or corrupt file
+  }
+}
+
+// The single exec object of a file, if it has type T
+template <typename T>
+static std::unique_ptr<T> readMappedExec(const std::string& fileName,
+                                         const EncryptedArray& ea,
+                                         const std::string& header)
+{
+  auto execs = readMappedExecs(fileName, header, ea);
+  if (execs.size() != 1 || !dynamic_cast<T*>(execs[0].get()))
+    return nullptr;
+  return std::unique_ptr<T>(static_cast<T*>(execs[0].release()));
+}
+
+std::unique_ptr<MatMul1DExec> MatMul1DExec::read(const std::string& fileName,
+                                                 const EncryptedArray& ea,
+                                                 const std::string& header)
+{
+  return readMappedExec<MatMul1DExec>(fileName, ea, header);
+}
+
+std::unique_ptr<BlockMatMul1DExec> BlockMatMul1DExec::read(
+    const std::string& fileName,
+    const EncryptedArray& ea,
+    const std::string& header)
+{
+  return readMappedExec<BlockMatMul1DExec>(fileName, ea, header);
+}
+
+std::unique_ptr<MatMulFullExec> MatMulFullExec::read(
+    const std::string& fileName,
+    const EncryptedArray& ea,
+    const std::string& header)
+{
+  return readMappedExec<MatMulFullExec>(fileName, ea, header);
+}
+
+std::unique_ptr<BlockMatMulFullExec> BlockMatMulFullExec::read(
+    const std::string& fileName,
+    const EncryptedArray& ea,
+    const std::string& header)
+{
+  return readMappedExec<BlockMatMulFullExec>(fileName, ea, header);
+}
+
 //================= traceMap ====================
 
 #define HELIB_TRACE_THRESH (50)
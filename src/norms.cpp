@@ -15,6 +15,7 @@
 #include <complex>
 #include <cmath>
 #include <algorithm>
+#include <NTL/BasicThreadPool.h>
 #include <helib/NumbTh.h>
 #include <helib/DoubleCRT.h>
 #include <helib/norms.h>
@@ -490,33 +491,92 @@ NTL::xdouble embeddingLargestCoeff(const NTL::ZZX& f, const PAlgebra& palg)
 // logic.  We can revisit this if this code ever becomes a bottleneck,
 // but this does not seem to be a significant issue at the moment.
 
-void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
-                             const std::vector<double>& in,
-                             const PAlgebra& palg)
+// Transforms of size at least this are split between the available threads
+// in the single-vector CKKS_canonicalEmbedding and CKKS_embedInSlots.
+static constexpr long CKKS_FFT_MT_THRESH = 1L << 15;
+
+// The batched versions transform this many vectors at a time in each thread,
+// which bounds the size of the scratch space.
+static constexpr long CKKS_FFT_BATCH = 8;
+
+// Applies the (m/2)-point FFT to buf in place, using the available threads
+// if it is large enough.
+static void applyHalfFFT(const half_FFT& hfft, std::vector<cx_double>& buf)
 {
-  HELIB_TIMER_START;
+  long nthreads = NTL::AvailableThreads();
+  if (nthreads > 1 && long(buf.size()) >= CKKS_FFT_MT_THRESH)
+    hfft.fft.apply_mt(&buf[0], &buf[0], nthreads);
+  else
+    hfft.fft.apply(&buf[0]);
+}
 
-  long sz = in.size();
+// The first and second halves of the canonical embedding, on either side of
+// the FFT. buf points to m/2 entries of scratch space.
+template <typename T>
+static void canonicalEmbedding_pre(cx_double* buf,
+                                   const T& in,
+                                   long sz,
+                                   const PAlgebra& palg)
+{
   long m = palg.getM();
 
   if (!(palg.getP() == -1 && palg.getPow2() >= 2 && sz < m / 2))
     LogicError("bad args to CKKS_canonicalEmbedding");
 
-  const half_FFT& hfft = palg.getHalfFFTInfo();
-  const cx_double* pow = &hfft.pow[0];
+  const cx_double* pow = &palg.getHalfFFTInfo().pow[0];
 
-  std::vector<cx_double> buf(m / 2);
   for (long i : range(0, sz))
-    buf[i] = in[i] * pow[i];
+    buf[i] = double(in[i]) * pow[i];
   for (long i : range(sz, m / 2))
     buf[i] = 0;
-  hfft.fft.apply(&buf[0]);
+}
 
+static void canonicalEmbedding_post(std::vector<cx_double>& v,
+                                    const cx_double* buf,
+                                    const PAlgebra& palg)
+{
+  long m = palg.getM();
   v.resize(m / 4);
   for (long i : range(m / 4))
     v[m / 4 - i - 1] = buf[palg.ith_rep(i) >> 1];
 }
 
+void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
+                             const std::vector<double>& in,
+                             const PAlgebra& palg)
+{
+  HELIB_TIMER_START;
+  std::vector<cx_double> buf(palg.getM() / 2);
+  canonicalEmbedding_pre(&buf[0], in, long(in.size()), palg);
+  applyHalfFFT(palg.getHalfFFTInfo(), buf);
+  canonicalEmbedding_post(v, &buf[0], palg);
+}
+
+void CKKS_canonicalEmbedding(std::vector<std::vector<cx_double>>& v,
+                             const std::vector<zzX>& f,
+                             const PAlgebra& palg)
+{
+  HELIB_TIMER_START;
+
+  long n = f.size();
+  long hm = palg.getM() / 2;
+  const half_FFT& hfft = palg.getHalfFFTInfo();
+  v.resize(n);
+
+  NTL_EXEC_RANGE(n, first, last)
+  // one scratch buffer per thread, for up to CKKS_FFT_BATCH vectors
+  std::vector<cx_double> buf(std::min(last - first, CKKS_FFT_BATCH) * hm);
+  for (long i = first; i < last; i += CKKS_FFT_BATCH) {
+    long cnt = std::min(last - i, CKKS_FFT_BATCH);
+    for (long j : range(cnt))
+      canonicalEmbedding_pre(&buf[j * hm], f[i + j], f[i + j].length(), palg);
+    hfft.fft.apply_batch(&buf[0], &buf[0], cnt, hm);
+    for (long j : range(cnt))
+      canonicalEmbedding_post(v[i + j], &buf[j * hm], palg);
+  }
+  NTL_EXEC_RANGE_END
+}
+
 void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
                              const zzX& f,
                              const PAlgebra& palg)
@@ -566,21 +626,19 @@ void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
 // then applies D^{-1} * DFT^{-1}, and then reverses the expanding
 // step by dropping the complex part.
 
-void CKKS_embedInSlots(zzX& f,
-                       const std::vector<cx_double>& v,
-                       const PAlgebra& palg,
-                       double scaling)
-
+// The first and second halves of the inverse of the canonical embedding,
+// on either side of the FFT. buf points to m/2 entries of scratch space.
+static void embedInSlots_pre(cx_double* buf,
+                             const std::vector<cx_double>& v,
+                             const PAlgebra& palg)
 {
-  HELIB_TIMER_START;
-
   long v_sz = v.size();
   long m = palg.getM();
 
   if (!(palg.getP() == -1 && palg.getPow2() >= 2))
     LogicError("bad args to CKKS_canonicalEmbedding");
 
-  std::vector<cx_double> buf(m / 2, cx_double(0));
+  std::fill(buf, buf + m / 2, cx_double(0));
   for (long i : range(m / 4)) {
     long j = palg.ith_rep(i);
     long ii = m / 4 - i - 1;
@@ -589,19 +647,72 @@ void CKKS_embedInSlots(zzX& f,
       buf[(m - j) >> 1] = v[ii];
     }
   }
+}
 
-  const half_FFT& hfft = palg.getHalfFFTInfo();
-  const cx_double* pow = &hfft.pow[0];
+static void embedInSlots_post(zzX& f,
+                              const cx_double* buf,
+                              const PAlgebra& palg,
+                              double scaling)
+{
+  long m = palg.getM();
+  const cx_double* pow = &palg.getHalfFFTInfo().pow[0];
 
   scaling /= (m / 2);
-  hfft.fft.apply(&buf[0]);
+
+  // Untwist, scale and round in a single pass over the FFT output. Only the
+  // real part of buf[i]*pow[i] is needed.
   f.SetLength(m / 2);
+  long* fp = f.elts();
   for (long i : range(m / 2))
-    f[i] = std::round(MUL(buf[i], pow[i]).real() * scaling);
+    fp[i] = std::lround(
+        (buf[i].real() * pow[i].real() - buf[i].imag() * pow[i].imag()) *
+        scaling);
 
   normalize(f);
 }
 
+void CKKS_embedInSlots(zzX& f,
+                       const std::vector<cx_double>& v,
+                       const PAlgebra& palg,
+                       double scaling)
+
+{
+  HELIB_TIMER_START;
+  std::vector<cx_double> buf(palg.getM() / 2);
+  embedInSlots_pre(&buf[0], v, palg);
+  applyHalfFFT(palg.getHalfFFTInfo(), buf);
+  embedInSlots_post(f, &buf[0], palg, scaling);
+}
+
+void CKKS_embedInSlots(std::vector<zzX>& f,
+                       const std::vector<std::vector<cx_double>>& v,
+                       const PAlgebra& palg,
+                       const std::vector<double>& scaling)
+{
+  HELIB_TIMER_START;
+
+  long n = v.size();
+  assertEq<InvalidArgument>(long(scaling.size()),
+                            n,
+                            "Need one scaling factor per vector");
+  long hm = palg.getM() / 2;
+  const half_FFT& hfft = palg.getHalfFFTInfo();
+  f.resize(n);
+
+  NTL_EXEC_RANGE(n, first, last)
+  // one scratch buffer per thread, for up to CKKS_FFT_BATCH vectors
+  std::vector<cx_double> buf(std::min(last - first, CKKS_FFT_BATCH) * hm);
+  for (long i = first; i < last; i += CKKS_FFT_BATCH) {
+    long cnt = std::min(last - i, CKKS_FFT_BATCH);
+    for (long j : range(cnt))
+      embedInSlots_pre(&buf[j * hm], v[i + j], palg);
+    hfft.fft.apply_batch(&buf[0], &buf[0], cnt, hm);
+    for (long j : range(cnt))
+      embedInSlots_post(f[i + j], &buf[j * hm], palg, scaling[i + j]);
+  }
+  NTL_EXEC_RANGE_END
+}
+
 // === obsolete versions of canonical embedding and inverse ===
 
 // These are less efficient, and seem to have some logic errors.
@@ -10,6 +10,7 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 #include <helib/Context.h>
+#include <helib/keys.h>
 #include <helib/polyEval.h>
 
 namespace helib {
@@ -21,8 +22,17 @@ Ctxt& DynamicCtxtPowers::getPower(long e)
 
     // largest power of two smaller than e
     long k = 1L << (NTL::NextPowerOfTwo(e) - 1);
-    v[e - 1] = getPower(e - k); // compute X^e = X^{e-k} * X^k
-    v[e - 1].multiplyBy(getPower(k));
+    Ctxt& lo = getPower(e - k);
+    Ctxt& hi = getPower(k);
+
+    // Under an auto-bootstrap policy, bootstrap the stored powers in place,
+    // otherwise multiplyBy bootstraps a copy on every use
+    const PubKey& pubKey = lo.getPubKey();
+    if (pubKey.getAutoBootstrap().enabled())
+      pubKey.autoReCrypt({&lo, &hi});
+
+    v[e - 1] = lo; // compute X^e = X^{e-k} * X^k
+    v[e - 1].multiplyBy(hi);
     // FIXME: could drop down / cleanup further as an optimization?
   }
   return v[e - 1];
@@ -83,6 +93,16 @@ void polyEval(Ctxt& ret, const NTL::Vec<Ctxt>& poly, const Ctxt& x)
     }
   }
 
+  // Under an auto-bootstrap policy, bootstrap the powers in place, as
+  // recursivePolyEval multiplies by each of them several times
+  const PubKey& pubKey = x.getPubKey();
+  if (pubKey.getAutoBootstrap().enabled()) {
+    std::vector<Ctxt*> due;
+    for (long i = 0; i <= logD; i++)
+      due.push_back(&powers[i]);
+    pubKey.autoReCrypt(due);
+  }
+
   // Compute in three parts p0(X) + ( p1(X) + p2(X)*X^d )*X^d
   Ctxt tmp(ZeroCtxtLike, ret);
   recursivePolyEval(ret,
@@ -15,6 +15,8 @@
 
 #include <helib/powerful.h>
 
+#include <NTL/BasicThreadPool.h>
+
 namespace helib {
 
 // powVec[d] = p_d^{e_d}, m = \prod_d p_d^{e_d}
@@ -390,6 +392,48 @@ void PowerfulDCRT::powerfulToZZX(NTL::ZZX& poly,
   }
 }
 
+void PowerfulDCRT::powerfulToZZX(NTL::ZZX& poly,
+                                 const NTL::Vec<long>& powerful) const
+{
+  if (triv) {
+    NTL::conv(poly, powerful);
+    return;
+  }
+
+  // Same number of primes as for one-word ZZ coefficients
+  long target_bits = NTL_ZZ_NBITS + to_poly_excess_bits;
+
+  long n = product_bits.length();
+  long m = 1;
+  while (m <= n && product_bits[m - 1] < target_bits)
+    m++;
+
+  if (m > n)
+    throw LogicError("powerfulToZZX: not enough primes");
+
+  // The conversions modulo each prime are independent, only the CRT
+  // combination is sequential
+  std::vector<NTL::zz_pX> rows(m);
+  NTL_EXEC_RANGE(m, first, last)
+  NTL::zz_pPush push;
+  for (long i = first; i < last; i++) {
+    pConvVec[i].restoreModulus();
+    HyperCube<NTL::zz_p> oneRowPwrfl(indexes.shortSig);
+    NTL::conv(oneRowPwrfl.getData(), powerful);
+    pConvVec[i].powerfulToPoly(rows[i], oneRowPwrfl);
+  }
+  NTL_EXEC_RANGE_END
+
+  NTL::zz_pPush push; // backup NTL's current modulus
+  clear(poly);
+  NTL::ZZ product{1};
+
+  for (long i : range(m)) {
+    pConvVec[i].restoreModulus();
+    NTL::CRT(poly, product, rows[i]);
+  }
+}
+
 void PowerfulDCRT::dcrtToPowerful(NTL::Vec<NTL::ZZ>& powerful,
                                   const DoubleCRT& dcrt) const
 {
@@ -21,6 +21,8 @@
 #include <helib/sample.h>
 #include <helib/binio.h>
 
+#include <NTL/BasicThreadPool.h>
+
 namespace helib {
 
 inline bool operator>(const ModuliSizes::Entry& a, const ModuliSizes::Entry& b)
@@ -375,28 +377,51 @@ struct PrimeGenerator
   }
 };
 
-void Context::AddSmallPrime(long q)
+long Context::addModuli(const std::vector<long>& qs)
+{
+  for (long i : range(qs.size())) {
+    assertFalse(inChain(qs[i]), "Prime q is already in the prime chain");
+    for (long j : range(i))
+      assertNeq(qs[i], qs[j], "Prime q is given twice");
+  }
+
+  // The Cmodulus constructor saves and restores the current zz_p modulus,
+  // so the threads need no special care
+  long first = moduli.size();
+  moduli.resize(first + qs.size());
+  NTL_EXEC_RANGE(long(qs.size()), lo, hi)
+  for (long i = lo; i < hi; i++)
+    moduli[first + i] = Cmodulus(zMStar, qs[i], 0);
+  NTL_EXEC_RANGE_END
+
+  return first;
+}
+
+void Context::AddSmallPrime(long q) { AddSmallPrimes({q}); }
+
+void Context::AddCtxtPrime(long q) { AddCtxtPrimes({q}); }
+
+void Context::AddSpecialPrime(long q) { AddSpecialPrimes({q}); }
+
+void Context::AddSmallPrimes(const std::vector<long>& qs)
 {
-  assertFalse(inChain(q), "Small prime q is already in the prime chain");
-  long i = moduli.size(); // The index of the new prime in the list
-  moduli.push_back(Cmodulus(zMStar, q, 0));
-  smallPrimes.insert(i);
+  long first = addModuli(qs);
+  for (long i : range(qs.size()))
+    smallPrimes.insert(first + i);
 }
 
-void Context::AddCtxtPrime(long q)
+void Context::AddCtxtPrimes(const std::vector<long>& qs)
 {
-  assertFalse(inChain(q), "Prime q is already in the prime chain");
-  long i = moduli.size(); // The index of the new prime in the list
-  moduli.push_back(Cmodulus(zMStar, q, 0));
-  ctxtPrimes.insert(i);
+  long first = addModuli(qs);
+  for (long i : range(qs.size()))
+    ctxtPrimes.insert(first + i);
 }
 
-void Context::AddSpecialPrime(long q)
+void Context::AddSpecialPrimes(const std::vector<long>& qs)
 {
-  assertFalse(inChain(q), "Special prime q is already in the prime chain");
-  long i = moduli.size(); // The index of the new prime in the list
-  moduli.push_back(Cmodulus(zMStar, q, 0));
-  specialPrimes.insert(i);
+  long first = addModuli(qs);
+  for (long i : range(qs.size()))
+    specialPrimes.insert(first + i);
 }
 
 //! @brief Add small primes to get target resolution
@@ -453,15 +478,17 @@ void addSmallPrimes(Context& context, long resolution, long cpSize)
 
   std::sort(sizes.begin(), sizes.end()); // order by size
 
+  // The primes are found first, then their tables are built in parallel
   long last_sz = 0;
   std::unique_ptr<PrimeGenerator> gen;
+  std::vector<long> qs;
   for (long sz : sizes) {
     if (sz != last_sz)
       gen.reset(new PrimeGenerator(sz, m));
-    long q = gen->next();
-    context.AddSmallPrime(q);
+    qs.push_back(gen->next());
     last_sz = sz;
   }
+  context.AddSmallPrimes(qs);
 }
 
 // Determine the target size of the ctxtPrimes. The target size is
@@ -510,12 +537,14 @@ void addCtxtPrimes(Context& context, long nBits, long targetSize)
   long m = palg.getM();
 
   PrimeGenerator gen(targetSize, m);
+  std::vector<long> qs;
   double bitlen = 0; // how many bits we already have
   while (bitlen < nBits - 0.5) {
-    long q = gen.next();     // generate the next prime
-    context.AddCtxtPrime(q); // add it to the list
+    long q = gen.next(); // generate the next prime
+    qs.push_back(q);     // add it to the list
     bitlen += std::log2(q);
   }
+  context.AddCtxtPrimes(qs);
 }
 
 static void addSpecialPrimes(Context& context,
@@ -616,6 +645,7 @@ static void addSpecialPrimes(Context& context,
 
   PrimeGenerator gen(nbits, m);
 
+  std::vector<long> qs;
   double bitsSoFar = 0.0;
   while (bitsSoFar < totalBits - 0.5) {
     long q = gen.next();
@@ -627,9 +657,10 @@ static void addSpecialPrimes(Context& context,
     // this is not the most efficient way to do this,
     // but it doesn't make sense to optimize this any further
 
-    context.AddSpecialPrime(q);
+    qs.push_back(q);
     bitsSoFar += std::log2(q);
   }
+  context.AddSpecialPrimes(qs);
 
 #if 0
   std::cerr << "****** special primes: "
@@ -9,7 +9,13 @@
  * See the License for the specific language governing permissions and
  * limitations under the License. See accompanying LICENSE file.
  */
+#include <algorithm>
+#include <chrono>
+#include <ctime>
 #include <NTL/BasicThreadPool.h>
+#if (defined(__unix__) || defined(__unix) || defined(unix))
+#include <sys/resource.h>
+#endif
 
 #include <helib/recryption.h>
 #include <helib/EncryptedArray.h>
@@ -65,18 +71,23 @@ static void x2iInSlots(NTL::ZZX& poly,
   ea.encode(poly, xVec);
 }
 
-// Make every entry of vec divisible by p2e by adding/subtracting q, while
-// keeping the added multiples small.  Specifically, for q = 1 mod p2e and any
-// integer z can be made divisible by p2e via z' = z + v*q, with |v| <= p2e/2.
+// Make every entry of the powerful-basis vector pwrfl divisible by p2e by
+// adding/subtracting q, while keeping the added multiples small, then divide
+// it by p2e. Specifically, for q = 1 mod p2e any integer z can be made
+// divisible by p2e via z' = z + v*q, with |v| <= p2e/2. Writing
+// q = 1 + k*p2e, we have z'/p2e = (z+v)/p2e + v*k, and since |z| <= q/2 all
+// of this is done in words. The multiples v are returned in vvec.
 
-static void newMakeDivisible(NTL::ZZX& poly,
+static void newMakeDivisible(NTL::Vec<long>& pwrfl,
                              long p2e,
                              long q,
                              const Context& context,
-                             NTL::ZZX& vpoly)
+                             NTL::Vec<long>& vvec)
 {
+  vvec.SetLength(pwrfl.length());
   if (p2e == 1) {
-    vpoly = 0;
+    for (long& v : vvec)
+      v = 0;
     return;
   }
 
@@ -86,23 +97,16 @@ static void newMakeDivisible(NTL::ZZX& poly,
   assertEq<InvalidArgument>(q % p2e, 1l, "q must equal 1 modulo p2e");
 
   long p = context.zMStar.getP();
-
-  const RecryptData& rcData = context.rcData;
-  const PowerfulDCRT& p2d_conv = *rcData.p2dConv;
-
-  NTL::Vec<NTL::ZZ> pwrfl;
-  p2d_conv.ZZXtoPowerful(pwrfl, poly);
-
-#ifdef HELIB_DEBUG
-  NTL::Vec<NTL::ZZ> vvec(NTL::INIT_SIZE, pwrfl.length());
-#endif
+  long k = q / p2e; // q = 1 + k*p2e
 
   for (long i : range(pwrfl.length())) {
-    NTL::ZZ& z = pwrfl[i];
+    long z = pwrfl[i];
     long v;
 
     // What to add to z to make it divisible by p2e?
-    long zMod = rem(z, p2e); // zMod is in [0,p2e-1]
+    long zMod = z % p2e;
+    if (zMod < 0)
+      zMod += p2e; // zMod is in [0,p2e-1]
     // NOTE: this makes sure we get a truly balanced remainder
     if (zMod > p2e / 2 || (p == 2 && zMod == p2e / 2 && NTL::RandomBnd(2))) {
       // randomize so that v has expected value 0
@@ -112,26 +116,13 @@ static void newMakeDivisible(NTL::ZZX& poly,
       zMod = -zMod;
     }
     v = zMod;
-    z += NTL::to_ZZ(q) * v; // make z divisible by p2e
-
-    if (rem(z, p2e) != 0) { // sanity check
-      std::cerr << "**error: original z[" << i
-                << "]=" << (z - (NTL::to_ZZ(q) * v)) << std::dec
-                << ", p^e=" << p2e << std::endl;
-      std::cerr << "z' = z + " << v << "*q = " << z << std::endl;
-      exit(1);
-    }
 
-#ifdef HELIB_DEBUG
+    long zv = z + v;
+    assertEq(zv % p2e, 0l, "newMakeDivisible: z+v is not divisible by p^e");
+    pwrfl[i] = zv / p2e + v * k; // (z + v*q) / p2e
+
     vvec[i] = v;
-#endif
   }
-
-  p2d_conv.powerfulToZZX(poly, pwrfl);
-
-#ifdef HELIB_DEBUG
-  p2d_conv.powerfulToZZX(vpoly, vvec);
-#endif
 }
 
 /*********************************************************************/
@@ -278,7 +269,8 @@ void RecryptData::init(const Context& context,
                        bool enableThick,
                        long t,
                        bool build_cache_,
-                       bool minimal)
+                       bool minimal,
+                       long streamWindow)
 {
   if (alMod != nullptr) { // were we called for a second time?
     std::cerr << "@Warning: multiple calls to RecryptData::init\n";
@@ -343,14 +335,190 @@ void RecryptData::init(const Context& context,
       v[k] = C[j];
     ea->encode(unpackSlotEncoding[j], v);
   }
-  firstMap = std::make_shared<EvalMap>(*ea, minimal, mvec, true, build_cache);
-  secondMap =
+  auto first =
+      std::make_shared<EvalMap>(*ea, minimal, mvec, true, build_cache);
+  auto second =
       std::make_shared<EvalMap>(*context.ea, minimal, mvec, false, build_cache);
+  if (!build_cache && streamWindow > 0) {
+    first->setStreaming(streamWindow);
+    second->setStreaming(streamWindow);
+  }
+  firstMap = first;
+  secondMap = second;
 }
 
 /********************************************************************/
 /********************************************************************/
 
+static std::function<void(const BootstrapProfile&)> bootstrapProfileCallback;
+
+void setBootstrapProfileCallback(
+    std::function<void(const BootstrapProfile&)> callback)
+{
+  bootstrapProfileCallback = std::move(callback);
+}
+
+const char* BootstrapProfile::stageName(BootstrapStage s)
+{
+  switch (s) {
+  case BootstrapStage::PreProcess:
+    return "preProcess";
+  case BootstrapStage::LinearTransform1:
+    return "LinearTransform1";
+  case BootstrapStage::ExtractDigits:
+    return "extractDigits";
+  case BootstrapStage::LinearTransform2:
+    return "LinearTransform2";
+  }
+  return "";
+}
+
+// Collects the BootstrapProfile of a bootstrap, if it was asked for
+// through the profile argument or the callback
+class BootstrapProfiler
+{
+public:
+  BootstrapProfiler(BootstrapProfile* _out, bool thin) :
+      out(_out), active(_out != nullptr || bootstrapProfileCallback)
+  {
+    if (!active)
+      return;
+    opCounters.profiling++;
+    profile.thin = thin;
+    totalStart = now();
+  }
+
+  ~BootstrapProfiler()
+  {
+    if (active)
+      opCounters.profiling--;
+  }
+
+  BootstrapProfiler(const BootstrapProfiler&) = delete;
+  BootstrapProfiler& operator=(const BootstrapProfiler&) = delete;
+
+  // Records the size and the capacity of the input
+  void input(const Ctxt& ctxt)
+  {
+    if (!active)
+      return;
+    profile.batchSize = 1;
+    profile.inputCapacity = ctxt.bitCapacity();
+  }
+  void input(const std::vector<Ctxt>& ctxts)
+  {
+    if (!active)
+      return;
+    profile.batchSize = lsize(ctxts);
+    profile.inputCapacity = minBitCapacity(ctxts);
+  }
+
+  // Reports a bootstrap whose ciphertexts were all empty or noiseless
+  void skip()
+  {
+    if (!active)
+      return;
+    profile.batchSize = 0;
+    finish(0);
+  }
+
+  void start() { stageStart = now(); }
+
+  void stop(BootstrapStage stage)
+  {
+    if (active)
+      add(profile.stages[static_cast<std::size_t>(stage)], stageStart, now());
+  }
+
+  void finish(const Ctxt& ctxt)
+  {
+    if (active)
+      finish(ctxt.bitCapacity());
+  }
+  void finish(const std::vector<Ctxt>& ctxts)
+  {
+    if (active)
+      finish(minBitCapacity(ctxts));
+  }
+
+private:
+  struct Snapshot
+  {
+    std::chrono::steady_clock::time_point wall;
+    std::clock_t cpu = 0;
+    long keySwitches = 0;
+    long automorphisms = 0;
+    long ntts = 0;
+  };
+
+  BootstrapProfile* out;
+  bool active;
+  BootstrapProfile profile;
+  Snapshot totalStart, stageStart;
+
+  static long minBitCapacity(const std::vector<Ctxt>& ctxts)
+  {
+    long capacity = ctxts.empty() ? 0 : ctxts[0].bitCapacity();
+    for (const Ctxt& ctxt : ctxts)
+      capacity = std::min(capacity, ctxt.bitCapacity());
+    return capacity;
+  }
+
+  void finish(long outputCapacity)
+  {
+    add(profile.total, totalStart, now());
+    profile.outputCapacity = outputCapacity;
+#if (defined(__unix__) || defined(__unix) || defined(unix))
+    struct rusage rusage;
+    if (getrusage(RUSAGE_SELF, &rusage) == 0)
+      profile.peakMemoryKB = rusage.ru_maxrss;
+#endif
+    if (out)
+      *out = profile;
+    if (bootstrapProfileCallback)
+      bootstrapProfileCallback(profile);
+  }
+
+  Snapshot now() const
+  {
+    Snapshot snap;
+    if (!active)
+      return snap;
+    snap.wall = std::chrono::steady_clock::now();
+    snap.cpu = std::clock();
+    snap.keySwitches = opCounters.keySwitches;
+    snap.automorphisms = opCounters.automorphisms;
+    snap.ntts = opCounters.ntts;
+    return snap;
+  }
+
+  static void add(BootstrapStageProfile& stage,
+                  const Snapshot& from,
+                  const Snapshot& to)
+  {
+    stage.wallTime +=
+        std::chrono::duration<double>(to.wall - from.wall).count();
+    stage.cpuTime += double(to.cpu - from.cpu) / CLOCKS_PER_SEC;
+    stage.keySwitches += to.keySwitches - from.keySwitches;
+    stage.automorphisms += to.automorphisms - from.automorphisms;
+    stage.ntts += to.ntts - from.ntts;
+  }
+};
+
+// The number of bootstraps in progress on this thread, whose ciphertexts
+// are never auto-bootstrapped. The worker threads of a parallel bootstrap
+// do not see it, but the ciphertexts they multiply keep more capacity than
+// the bootstrap leaves, which is above the auto-bootstrap threshold.
+static thread_local long bootstrapDepth = 0;
+
+// Counts a bootstrap in progress on this thread for its lifetime
+struct BootstrapDepthGuard
+{
+  BootstrapDepthGuard() { bootstrapDepth++; }
+  ~BootstrapDepthGuard() { bootstrapDepth--; }
+};
+
+
 // Extract digits from fully packed slots
 void extractDigitsPacked(Ctxt& ctxt,
                          long botHigh,
@@ -361,15 +529,13 @@ void extractDigitsPacked(Ctxt& ctxt,
 // Extract digits from unpacked slots
 void extractDigitsThin(Ctxt& ctxt, long botHigh, long r, long ePrime);
 
-// bootstrap a ciphertext to reduce noise
-void PubKey::reCrypt(Ctxt& ctxt) const
+// Empty and dummy ciphertexts need no bootstrapping
+bool PubKey::reCryptTrivial(Ctxt& ctxt) const
 {
-  HELIB_TIMER_START;
-
   // Some sanity checks for dummy ciphertext
   long ptxtSpace = ctxt.getPtxtSpace();
   if (ctxt.isEmpty())
-    return;
+    return true;
   if (ctxt.parts.size() == 1 && ctxt.parts[0].skHandle.isOne()) {
     // Dummy encryption, just ensure that it is reduced mod p
     NTL::ZZX poly = to_ZZX(ctxt.parts[0]);
@@ -377,42 +543,20 @@ void PubKey::reCrypt(Ctxt& ctxt) const
       poly[i] = NTL::to_ZZ(rem(poly[i], ptxtSpace));
     poly.normalize();
     ctxt.DummyEncrypt(poly);
-    return;
+    return true;
   }
+  return false;
+}
 
-  // check that we have bootstrapping data
-  assertTrue(recryptKeyID >= 0l, "No bootstrapping data");
-
-  long p = getContext().zMStar.getP();
-  long r = getContext().alMod.getR();
-  long p2r = getContext().alMod.getPPowR();
-
-  long intFactor = ctxt.intFactor;
-
-  // the bootstrapping key is encrypted relative to plaintext space p^{e-e'+r}.
-  const RecryptData& rcData = getContext().rcData;
-  long e = rcData.e;
-  long ePrime = rcData.ePrime;
-  long p2ePrime = NTL::power_long(p, ePrime);
-  long q = NTL::power_long(p, e) + 1;
-  assertTrue(e >= r, "rcData.e must be at least alMod.r");
-
-#ifdef HELIB_DEBUG
-  std::cerr << "reCrypt: p=" << p << ", r=" << r << ", e=" << e
-            << " ePrime=" << ePrime << ", q=" << q << std::endl;
-  CheckCtxt(ctxt, "init");
-#endif
-
-  // can only bootstrap ciphertext with plaintext-space dividing p^r
-  assertEq(p2r % ptxtSpace, 0l, "ptxtSpace must divide p^r when bootstrapping");
-
-  ctxt.dropSmallAndSpecialPrimes();
-
-#ifdef HELIB_DEBUG
-  CheckCtxt(ctxt, "after mod down");
-#endif
-
-  HELIB_NTIMER_START(AAA_preProcess);
+// The part of reCrypt and thinReCrypt that switches ctxt to the
+// bootstrapping key and to the modulus q=p^e+1, and replaces it by the
+// encryption of the result under recryptEkey
+void PubKey::bootKeySwitch(Ctxt& ctxt) const
+{
+  long p = context.zMStar.getP();
+  long p2r = context.alMod.getPPowR();
+  long p2ePrime = NTL::power_long(p, context.rcData.ePrime);
+  long q = NTL::power_long(p, context.rcData.e) + 1;
 
   // Make sure that this ciphertext is in canonical form
   if (!ctxt.inCanonicalForm())
@@ -436,10 +580,12 @@ void PubKey::reCrypt(Ctxt& ctxt) const
 #endif
 
   // "raw mod-switch" to the bootstrapping modulus q=p^e+1.
-  std::vector<NTL::ZZX> zzParts; // the mod-switched parts, in ZZX format
+  // The mod-switched parts are kept in the powerful basis, as words, until
+  // they are made divisible by p^{e'} and divided by it.
+  std::vector<NTL::Vec<long>> pwrflParts;
 
   double mfac = ctxt.getContext().zMStar.getNormBnd();
-  double noise_est = ctxt.rawModSwitch(zzParts, q) * mfac;
+  double noise_est = ctxt.rawModSwitch(pwrflParts, q) * mfac;
   // noise_est is an upper bound on the L-infty norm of the scaled noise
   // in the pwrfl basis
   double noise_bnd =
@@ -454,12 +600,17 @@ void PubKey::reCrypt(Ctxt& ctxt) const
             std::to_string(noise_rat));
   }
 
-  assertEq(zzParts.size(),
+  assertEq(pwrflParts.size(),
            (std::size_t)2,
            "Exactly 2 parts required for mod-switching in thin bootstrapping");
 
+  const PowerfulDCRT& p2d_conv = *ctxt.getContext().rcData.p2dConv;
+  std::vector<NTL::ZZX> zzParts(2); // the parts in ZZX format
+
 #ifdef HELIB_DEBUG
   if (dbgKey) {
+    for (long i : range(2))
+      p2d_conv.powerfulToZZX(zzParts[i], pwrflParts[i]);
     checkRecryptBounds(zzParts,
                        dbgKey->sKeys[recryptKeyID],
                        ctxt.getContext(),
@@ -467,19 +618,25 @@ void PubKey::reCrypt(Ctxt& ctxt) const
   }
 #endif
 
-  std::vector<NTL::ZZX> v;
-  v.resize(2);
-
-  // Add multiples of q to make the zzParts divisible by p^{e'}
-  for (long i : range(2)) {
-    // make divisible by p^{e'}
+  std::vector<NTL::Vec<long>> v(2);
 
-    newMakeDivisible(zzParts[i], p2ePrime, q, ctxt.getContext(), v[i]);
-  }
+  // Add multiples of q to make the parts divisible by p^{e'}, and divide
+  // them by p^{e'}
+  for (long i : range(2))
+    newMakeDivisible(pwrflParts[i], p2ePrime, q, ctxt.getContext(), v[i]);
 
 #ifdef HELIB_DEBUG
   if (dbgKey) {
-    checkRecryptBounds_v(v, dbgKey->sKeys[recryptKeyID], ctxt.getContext(), q);
+    std::vector<NTL::ZZX> vpoly(2);
+    for (long i : range(2)) {
+      p2d_conv.powerfulToZZX(vpoly[i], v[i]);
+      p2d_conv.powerfulToZZX(zzParts[i], pwrflParts[i]);
+      zzParts[i] *= p2ePrime; // the parts before the division
+    }
+    checkRecryptBounds_v(vpoly,
+                         dbgKey->sKeys[recryptKeyID],
+                         ctxt.getContext(),
+                         q);
     checkCriticalValue(zzParts,
                        dbgKey->sKeys[recryptKeyID],
                        ctxt.getContext().rcData,
@@ -487,25 +644,81 @@ void PubKey::reCrypt(Ctxt& ctxt) const
   }
 #endif
 
-  for (long i : range(zzParts.size())) {
-    zzParts[i] /= p2ePrime; // divide by p^{e'}
-  }
+  for (long i : range(2))
+    p2d_conv.powerfulToZZX(zzParts[i], pwrflParts[i]); // convert to ZZX
 
   // NOTE: here we lose the intFactor associated with ctxt.
-  // We will restore it below.
+  // The callers restore it.
   ctxt = recryptEkey;
 
   ctxt.multByConstant(zzParts[1]);
   ctxt.addConstant(zzParts[0]);
+}
+
+// bootstrap a ciphertext to reduce noise
+void PubKey::reCrypt(Ctxt& ctxt, BootstrapProfile* profile) const
+{
+  HELIB_TIMER_START;
+  BootstrapDepthGuard depthGuard;
+  BootstrapProfiler profiler(profile, /*thin=*/false);
+
+  if (reCryptTrivial(ctxt)) {
+    profiler.skip();
+    return;
+  }
+
+  profiler.input(ctxt);
+
+  // check that we have bootstrapping data
+  assertTrue(recryptKeyID >= 0l, "No bootstrapping data");
+
+  long ptxtSpace = ctxt.getPtxtSpace();
+  long r = getContext().alMod.getR();
+  long p2r = getContext().alMod.getPPowR();
+
+  long intFactor = ctxt.intFactor;
+
+  // the bootstrapping key is encrypted relative to plaintext space p^{e-e'+r}.
+  const RecryptData& rcData = getContext().rcData;
+  long e = rcData.e;
+  long ePrime = rcData.ePrime;
+  assertTrue(e >= r, "rcData.e must be at least alMod.r");
+
+#ifdef HELIB_DEBUG
+  long p = getContext().zMStar.getP();
+  std::cerr << "reCrypt: p=" << p << ", r=" << r << ", e=" << e
+            << " ePrime=" << ePrime << ", q=" << NTL::power_long(p, e) + 1
+            << std::endl;
+  CheckCtxt(ctxt, "init");
+#endif
+
+  // can only bootstrap ciphertext with plaintext-space dividing p^r
+  assertEq(p2r % ptxtSpace, 0l, "ptxtSpace must divide p^r when bootstrapping");
+
+  ctxt.dropSmallAndSpecialPrimes();
+
+#ifdef HELIB_DEBUG
+  CheckCtxt(ctxt, "after mod down");
+#endif
+
+  HELIB_NTIMER_START(AAA_preProcess);
+  profiler.start();
+
+  // NOTE: here we lose the intFactor associated with ctxt.
+  // We will restore it below.
+  bootKeySwitch(ctxt);
 
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after preProcess");
 #endif
+  profiler.stop(BootstrapStage::PreProcess);
   HELIB_NTIMER_STOP(AAA_preProcess);
 
   // Move the powerful-basis coefficients to the plaintext slots
   HELIB_NTIMER_START(AAA_LinearTransform1);
+  profiler.start();
   ctxt.getContext().rcData.firstMap->apply(ctxt);
+  profiler.stop(BootstrapStage::LinearTransform1);
   HELIB_NTIMER_STOP(AAA_LinearTransform1);
 
 #ifdef HELIB_DEBUG
@@ -514,11 +727,13 @@ void PubKey::reCrypt(Ctxt& ctxt) const
 
   // Extract the digits e-e'+r-1,...,e-e' (from fully packed slots)
   HELIB_NTIMER_START(AAA_extractDigitsPacked);
+  profiler.start();
   extractDigitsPacked(ctxt,
                       e - ePrime,
                       r,
                       ePrime,
                       context.rcData.unpackSlotEncoding);
+  profiler.stop(BootstrapStage::ExtractDigits);
   HELIB_NTIMER_STOP(AAA_extractDigitsPacked);
 
 #ifdef HELIB_DEBUG
@@ -527,7 +742,9 @@ void PubKey::reCrypt(Ctxt& ctxt) const
 
   // Move the slots back to powerful-basis coefficients
   HELIB_NTIMER_START(AAA_LinearTransform2);
+  profiler.start();
   ctxt.getContext().rcData.secondMap->apply(ctxt);
+  profiler.stop(BootstrapStage::LinearTransform2);
   HELIB_NTIMER_STOP(AAA_LinearTransform2);
 
 #ifdef HELIB_DEBUG
@@ -537,6 +754,127 @@ void PubKey::reCrypt(Ctxt& ctxt) const
   // restore intFactor
   if (intFactor != 1)
     ctxt.intFactor = NTL::MulMod(ctxt.intFactor, intFactor, ptxtSpace);
+
+  profiler.finish(ctxt);
+}
+
+// Copies the ciphertexts of ctxts that need bootstrapping to batch,
+// records their indexes and intFactors
+static void collectForReCrypt(std::vector<Ctxt>& batch,
+                              std::vector<long>& idx,
+                              std::vector<long>& intFactors,
+                              const std::vector<Ctxt>& ctxts,
+                              const std::vector<bool>& trivial)
+{
+  for (long i : range(lsize(ctxts))) {
+    if (trivial[i])
+      continue;
+    batch.push_back(ctxts[i]);
+    idx.push_back(i);
+    intFactors.push_back(ctxts[i].intFactor);
+  }
+}
+
+// Copies batch back to ctxts and restores the intFactors
+static void restoreFromReCrypt(std::vector<Ctxt>& ctxts,
+                               std::vector<Ctxt>& batch,
+                               const std::vector<long>& idx,
+                               const std::vector<long>& intFactors)
+{
+  for (long k : range(lsize(batch))) {
+    long ptxtSpace = ctxts[idx[k]].getPtxtSpace();
+    if (intFactors[k] != 1)
+      batch[k].intFactor =
+          NTL::MulMod(batch[k].intFactor, intFactors[k], ptxtSpace);
+    ctxts[idx[k]] = batch[k];
+  }
+}
+
+// bootstrap a batch of ciphertexts, one stage at a time
+void PubKey::reCryptMany(std::vector<Ctxt>& ctxts,
+                         BootstrapProfile* profile) const
+{
+  HELIB_TIMER_START;
+  BootstrapDepthGuard depthGuard;
+
+  if (ctxts.size() == 1) { // nothing to share
+    reCrypt(ctxts[0], profile);
+    return;
+  }
+
+  BootstrapProfiler profiler(profile, /*thin=*/false);
+
+  std::vector<bool> trivial(ctxts.size());
+  for (long i : range(lsize(ctxts)))
+    trivial[i] = reCryptTrivial(ctxts[i]);
+
+  std::vector<Ctxt> batch;
+  std::vector<long> idx, intFactors;
+  collectForReCrypt(batch, idx, intFactors, ctxts, trivial);
+  if (batch.empty()) {
+    profiler.skip();
+    return;
+  }
+
+  // check that we have bootstrapping data
+  assertTrue(recryptKeyID >= 0l, "No bootstrapping data");
+
+  long r = getContext().alMod.getR();
+  long p2r = getContext().alMod.getPPowR();
+
+  const RecryptData& rcData = getContext().rcData;
+  long e = rcData.e;
+  long ePrime = rcData.ePrime;
+  assertTrue(e >= r, "rcData.e must be at least alMod.r");
+
+  // can only bootstrap ciphertext with plaintext-space dividing p^r
+  for (const Ctxt& ctxt : batch)
+    assertEq(p2r % ctxt.getPtxtSpace(),
+             0l,
+             "ptxtSpace must divide p^r when bootstrapping");
+
+  profiler.input(batch);
+
+  long n = lsize(batch);
+
+  HELIB_NTIMER_START(AAA_preProcessMany);
+  profiler.start();
+  NTL_EXEC_RANGE(n, first, last)
+  for (long k : range(first, last)) {
+    batch[k].dropSmallAndSpecialPrimes();
+    bootKeySwitch(batch[k]);
+  }
+  NTL_EXEC_RANGE_END
+  profiler.stop(BootstrapStage::PreProcess);
+  HELIB_NTIMER_STOP(AAA_preProcessMany);
+
+  HELIB_NTIMER_START(AAA_LinearTransform1Many);
+  profiler.start();
+  rcData.firstMap->applyMany(batch);
+  profiler.stop(BootstrapStage::LinearTransform1);
+  HELIB_NTIMER_STOP(AAA_LinearTransform1Many);
+
+  HELIB_NTIMER_START(AAA_extractDigitsPackedMany);
+  profiler.start();
+  NTL_EXEC_RANGE(n, first, last)
+  for (long k : range(first, last))
+    extractDigitsPacked(batch[k],
+                        e - ePrime,
+                        r,
+                        ePrime,
+                        rcData.unpackSlotEncoding);
+  NTL_EXEC_RANGE_END
+  profiler.stop(BootstrapStage::ExtractDigits);
+  HELIB_NTIMER_STOP(AAA_extractDigitsPackedMany);
+
+  HELIB_NTIMER_START(AAA_LinearTransform2Many);
+  profiler.start();
+  rcData.secondMap->applyMany(batch);
+  profiler.stop(BootstrapStage::LinearTransform2);
+  HELIB_NTIMER_STOP(AAA_LinearTransform2Many);
+
+  restoreFromReCrypt(ctxts, batch, idx, intFactors);
+  profiler.finish(batch);
 }
 
 #ifdef HELIB_BOOT_THREADS
@@ -773,16 +1111,29 @@ void ThinRecryptData::init(const Context& context,
                            bool alsoThick,
                            long t,
                            bool build_cache_,
-                           bool minimal)
+                           bool minimal,
+                           long streamWindow)
 {
-  RecryptData::init(context, mvec_, alsoThick, t, build_cache_, minimal);
-  coeffToSlot =
+  RecryptData::init(context,
+                    mvec_,
+                    alsoThick,
+                    t,
+                    build_cache_,
+                    minimal,
+                    streamWindow);
+  auto first =
       std::make_shared<ThinEvalMap>(*ea, minimal, mvec, true, build_cache);
-  slotToCoeff = std::make_shared<ThinEvalMap>(*context.ea,
+  auto second = std::make_shared<ThinEvalMap>(*context.ea,
                                               minimal,
                                               mvec,
                                               false,
                                               build_cache);
+  if (!build_cache && streamWindow > 0) {
+    first->setStreaming(streamWindow);
+    second->setStreaming(streamWindow);
+  }
+  coeffToSlot = first;
+  slotToCoeff = second;
 }
 
 // Extract digits from thinly packed slots
@@ -935,30 +1286,43 @@ struct PubKeyHack
   Ctxt recryptEkey;  // the key itself, encrypted under key #0
 };
 
+// Drops the small and special primes, and (experimentally) all but a few
+// levels, before the first linear map of thinReCrypt and thinReCryptMany
+static void thinReCryptModDown(Ctxt& ctxt)
+{
+  ctxt.dropSmallAndSpecialPrimes();
+
+#define DROP_BEFORE_THIN_RECRYPT
+#define THIN_RECRYPT_NLEVELS (3)
+#ifdef DROP_BEFORE_THIN_RECRYPT
+  // experimental code...we should drop down to a reasonably low level
+  // before doing the first linear map.
+  const Context& context = ctxt.getContext();
+  long first = context.ctxtPrimes.first();
+  long last =
+      std::min(context.ctxtPrimes.last(), first + THIN_RECRYPT_NLEVELS - 1);
+  ctxt.bringToSet(IndexSet(first, last));
+#endif
+}
+
 // bootstrap a ciphertext to reduce noise
-void PubKey::thinReCrypt(Ctxt& ctxt) const
+void PubKey::thinReCrypt(Ctxt& ctxt, BootstrapProfile* profile) const
 {
   HELIB_TIMER_START;
+  BootstrapDepthGuard depthGuard;
+  BootstrapProfiler profiler(profile, /*thin=*/true);
 
-  // Some sanity checks for dummy ciphertext
-  long ptxtSpace = ctxt.getPtxtSpace();
-  if (ctxt.isEmpty())
-    return;
-
-  if (ctxt.parts.size() == 1 && ctxt.parts[0].skHandle.isOne()) {
-    // Dummy encryption, just ensure that it is reduced mod p
-    NTL::ZZX poly = to_ZZX(ctxt.parts[0]);
-    for (long i = 0; i < poly.rep.length(); i++)
-      poly[i] = NTL::to_ZZ(rem(poly[i], ptxtSpace));
-    poly.normalize();
-    ctxt.DummyEncrypt(poly);
+  if (reCryptTrivial(ctxt)) {
+    profiler.skip();
     return;
   }
 
+  profiler.input(ctxt);
+
   // check that we have bootstrapping data
   assertTrue(recryptKeyID >= 0l, "Bootstrapping data not present");
 
-  long p = ctxt.getContext().zMStar.getP();
+  long ptxtSpace = ctxt.getPtxtSpace();
   long r = ctxt.getContext().alMod.getR();
   long p2r = ctxt.getContext().alMod.getPPowR();
 
@@ -969,8 +1333,6 @@ void PubKey::thinReCrypt(Ctxt& ctxt) const
   // the bootstrapping key is encrypted relative to plaintext space p^{e-e'+r}.
   long e = trcData.e;
   long ePrime = trcData.ePrime;
-  long p2ePrime = NTL::power_long(p, ePrime);
-  long q = NTL::power_long(p, e) + 1;
   assertTrue(e >= r, "trcData.e must be at least alMod.r");
 
   // can only bootstrap ciphertext with plaintext-space dividing p^r
@@ -982,18 +1344,7 @@ void PubKey::thinReCrypt(Ctxt& ctxt) const
   CheckCtxt(ctxt, "init");
 #endif
 
-  ctxt.dropSmallAndSpecialPrimes();
-
-#define DROP_BEFORE_THIN_RECRYPT
-#define THIN_RECRYPT_NLEVELS (3)
-#ifdef DROP_BEFORE_THIN_RECRYPT
-  // experimental code...we should drop down to a reasonably low level
-  // before doing the first linear map.
-  long first = context.ctxtPrimes.first();
-  long last =
-      std::min(context.ctxtPrimes.last(), first + THIN_RECRYPT_NLEVELS - 1);
-  ctxt.bringToSet(IndexSet(first, last));
-#endif
+  thinReCryptModDown(ctxt);
 
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after mod down");
@@ -1001,7 +1352,9 @@ void PubKey::thinReCrypt(Ctxt& ctxt) const
 
   // Move the slots to powerful-basis coefficients
   HELIB_NTIMER_START(AAA_slotToCoeff);
+  profiler.start();
   trcData.slotToCoeff->apply(ctxt);
+  profiler.stop(BootstrapStage::LinearTransform2);
   HELIB_NTIMER_STOP(AAA_slotToCoeff);
 
 #ifdef HELIB_DEBUG
@@ -1009,100 +1362,24 @@ void PubKey::thinReCrypt(Ctxt& ctxt) const
 #endif
 
   HELIB_NTIMER_START(AAA_bootKeySwitch);
-
-  // Make sure that this ciphertext is in canonical form
-  if (!ctxt.inCanonicalForm())
-    ctxt.reLinearize();
-
-  // Mod-switch down if needed
-  IndexSet s = ctxt.getPrimeSet() / context.specialPrimes;
-  assertTrue(s <= context.ctxtPrimes, "prime set is messed up");
-  if (s.card() > 3) { // leave only first three ciphertext primes
-    long first = s.first();
-    IndexSet s3(first, first + 2);
-    s.retain(s3);
-  }
-  ctxt.modDownToSet(s);
-
-  // key-switch to the bootstrapping key
-  ctxt.reLinearize(recryptKeyID);
-
-#ifdef HELIB_DEBUG
-  CheckCtxt(ctxt, "after key switching");
-#endif
-
-  // "raw mod-switch" to the bootstrapping mosulus q=p^e+1.
-  std::vector<NTL::ZZX> zzParts; // the mod-switched parts, in ZZX format
-
-  double mfac = ctxt.getContext().zMStar.getNormBnd();
-  double noise_est = ctxt.rawModSwitch(zzParts, q) * mfac;
-  // noise_est is an upper bound on the L-infty norm of the scaled noise
-  // in the pwrfl basis
-  double noise_bnd =
-      HELIB_MIN_CAP_FRAC * p2r * ctxt.getContext().boundForRecryption();
-  // noise_bnd is the bound assumed in selecting the parameters
-  double noise_rat = noise_est / noise_bnd;
-
-  HELIB_STATS_UPDATE("raw-mod-switch-noise", noise_rat);
-
-  if (noise_rat > 1) {
-    Warning("rawModSwitch scaled noise exceeds bound: " +
-            std::to_string(noise_rat));
-  }
-
-  assertEq(zzParts.size(),
-           (std::size_t)2,
-           "Exactly 2 parts required for mod-switching in thin bootstrapping");
-
-#ifdef HELIB_DEBUG
-  if (dbgKey) {
-    checkRecryptBounds(zzParts,
-                       dbgKey->sKeys[recryptKeyID],
-                       ctxt.getContext(),
-                       q);
-  }
-#endif
-
-  std::vector<NTL::ZZX> v;
-  v.resize(2);
-
-  // Add multiples of q to make the zzParts divisible by p^{e'}
-  for (long i : range(2)) {
-    // make divisible by p^{e'}
-
-    newMakeDivisible(zzParts[i], p2ePrime, q, ctxt.getContext(), v[i]);
-  }
-
-#ifdef HELIB_DEBUG
-  if (dbgKey) {
-    checkRecryptBounds_v(v, dbgKey->sKeys[recryptKeyID], ctxt.getContext(), q);
-    checkCriticalValue(zzParts,
-                       dbgKey->sKeys[recryptKeyID],
-                       ctxt.getContext().rcData,
-                       q);
-  }
-#endif
-
-  for (long i : range(zzParts.size())) {
-    zzParts[i] /= p2ePrime; // divide by p^{e'}
-  }
+  profiler.start();
 
   // NOTE: here we lose the intFactor associated with ctxt.
   // We will restore it below.
-  ctxt = recryptEkey;
-
-  ctxt.multByConstant(zzParts[1]);
-  ctxt.addConstant(zzParts[0]);
+  bootKeySwitch(ctxt);
 
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after bootKeySwitch");
 #endif
 
+  profiler.stop(BootstrapStage::PreProcess);
   HELIB_NTIMER_STOP(AAA_bootKeySwitch);
 
   // Move the powerful-basis coefficients to the plaintext slots
   HELIB_NTIMER_START(AAA_coeffToSlot);
+  profiler.start();
   trcData.coeffToSlot->apply(ctxt);
+  profiler.stop(BootstrapStage::LinearTransform1);
   HELIB_NTIMER_STOP(AAA_coeffToSlot);
 
 #ifdef HELIB_DEBUG
@@ -1111,7 +1388,9 @@ void PubKey::thinReCrypt(Ctxt& ctxt) const
 
   // Extract the digits e-e'+r-1,...,e-e' (from fully packed slots)
   HELIB_NTIMER_START(AAA_extractDigitsThin);
+  profiler.start();
   extractDigitsThin(ctxt, e - ePrime, r, ePrime);
+  profiler.stop(BootstrapStage::ExtractDigits);
   HELIB_NTIMER_STOP(AAA_extractDigitsThin);
 
 #ifdef HELIB_DEBUG
@@ -1121,6 +1400,139 @@ void PubKey::thinReCrypt(Ctxt& ctxt) const
   // restore intFactor
   if (intFactor != 1)
     ctxt.intFactor = NTL::MulMod(ctxt.intFactor, intFactor, ptxtSpace);
+
+  profiler.finish(ctxt);
+}
+
+// thin-bootstrap a batch of ciphertexts, one stage at a time
+void PubKey::thinReCryptMany(std::vector<Ctxt>& ctxts,
+                             BootstrapProfile* profile) const
+{
+  HELIB_TIMER_START;
+  BootstrapDepthGuard depthGuard;
+
+  if (ctxts.size() == 1) { // nothing to share
+    thinReCrypt(ctxts[0], profile);
+    return;
+  }
+
+  BootstrapProfiler profiler(profile, /*thin=*/true);
+
+  std::vector<bool> trivial(ctxts.size());
+  for (long i : range(lsize(ctxts)))
+    trivial[i] = reCryptTrivial(ctxts[i]);
+
+  std::vector<Ctxt> batch;
+  std::vector<long> idx, intFactors;
+  collectForReCrypt(batch, idx, intFactors, ctxts, trivial);
+  if (batch.empty()) {
+    profiler.skip();
+    return;
+  }
+
+  // check that we have bootstrapping data
+  assertTrue(recryptKeyID >= 0l, "Bootstrapping data not present");
+
+  long r = getContext().alMod.getR();
+  long p2r = getContext().alMod.getPPowR();
+
+  const ThinRecryptData& trcData = getContext().rcData;
+  long e = trcData.e;
+  long ePrime = trcData.ePrime;
+  assertTrue(e >= r, "trcData.e must be at least alMod.r");
+
+  // can only bootstrap ciphertext with plaintext-space dividing p^r
+  for (const Ctxt& ctxt : batch)
+    assertEq(p2r % ctxt.getPtxtSpace(),
+             0l,
+             "ptxtSpace must divide p^r when thin bootstrapping");
+
+  profiler.input(batch);
+
+  long n = lsize(batch);
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long k : range(first, last))
+    thinReCryptModDown(batch[k]);
+  NTL_EXEC_RANGE_END
+
+  HELIB_NTIMER_START(AAA_slotToCoeffMany);
+  profiler.start();
+  trcData.slotToCoeff->applyMany(batch);
+  profiler.stop(BootstrapStage::LinearTransform2);
+  HELIB_NTIMER_STOP(AAA_slotToCoeffMany);
+
+  HELIB_NTIMER_START(AAA_bootKeySwitchMany);
+  profiler.start();
+  NTL_EXEC_RANGE(n, first, last)
+  for (long k : range(first, last))
+    bootKeySwitch(batch[k]);
+  NTL_EXEC_RANGE_END
+  profiler.stop(BootstrapStage::PreProcess);
+  HELIB_NTIMER_STOP(AAA_bootKeySwitchMany);
+
+  HELIB_NTIMER_START(AAA_coeffToSlotMany);
+  profiler.start();
+  trcData.coeffToSlot->applyMany(batch);
+  profiler.stop(BootstrapStage::LinearTransform1);
+  HELIB_NTIMER_STOP(AAA_coeffToSlotMany);
+
+  HELIB_NTIMER_START(AAA_extractDigitsThinMany);
+  profiler.start();
+  NTL_EXEC_RANGE(n, first, last)
+  for (long k : range(first, last))
+    extractDigitsThin(batch[k], e - ePrime, r, ePrime);
+  NTL_EXEC_RANGE_END
+  profiler.stop(BootstrapStage::ExtractDigits);
+  HELIB_NTIMER_STOP(AAA_extractDigitsThinMany);
+
+  restoreFromReCrypt(ctxts, batch, idx, intFactors);
+  profiler.finish(batch);
+}
+
+bool PubKey::needsAutoReCrypt(const Ctxt& ctxt) const
+{
+  return autoBootstrap.enabled() && bootstrapDepth == 0 && !ctxt.isEmpty() &&
+         ctxt.bitCapacity() < autoBootstrap.minCapacity &&
+         context.alMod.getPPowR() % ctxt.getPtxtSpace() == 0;
+}
+
+// bootstrap the ciphertexts that the auto-bootstrap policy calls for
+long PubKey::autoReCrypt(const std::vector<Ctxt*>& ctxts) const
+{
+  std::vector<Ctxt*> due;
+  for (Ctxt* ctxt : ctxts)
+    if (needsAutoReCrypt(*ctxt) &&
+        std::find(due.begin(), due.end(), ctxt) == due.end())
+      due.push_back(ctxt);
+  if (due.empty())
+    return 0;
+
+  HELIB_TIMER_START;
+  if (due.size() == 1) {
+    if (autoBootstrap.thin)
+      thinReCrypt(*due[0]);
+    else
+      reCrypt(*due[0]);
+  } else {
+    std::vector<Ctxt> batch;
+    batch.reserve(due.size());
+    for (const Ctxt* ctxt : due)
+      batch.push_back(*ctxt);
+    if (autoBootstrap.thin)
+      thinReCryptMany(batch);
+    else
+      reCryptMany(batch);
+    for (long i : range(lsize(due)))
+      *due[i] = batch[i];
+  }
+
+  // Otherwise the next multiplication would bootstrap again, and again
+  for (const Ctxt* ctxt : due)
+    assertTrue(ctxt->bitCapacity() >= autoBootstrap.minCapacity,
+               "Auto-bootstrap minCapacity is above the capacity that "
+               "bootstrapping leaves");
+  return lsize(due);
 }
 
 #ifdef HELIB_DEBUG
@@ -11,6 +11,7 @@
  */
 #include <cstring>
 #include <fstream>
+#include <sstream>
 #include <utility>
 #include <unistd.h>
 
@@ -406,6 +407,49 @@ TEST_P(GTestBinIO, implementsBinaryFileIoCorrectly)
   }
 }
 
+TEST_P(GTestBinIO, readsContextWithPrecomputedTables)
+{
+  helib::Context context(m, p, r);
+  helib::buildModChain(context, L, c);
+
+  std::stringstream str;
+  helib::writeContextBaseBinary(str, context);
+  helib::writeContextBinary(str, context, /*withTables=*/true);
+
+  std::unique_ptr<helib::Context> restored =
+      helib::buildContextFromBinary(str);
+  helib::readContextBinary(str, *restored);
+  EXPECT_TRUE(*restored == context);
+
+  // The restored FFT tables must give the same transforms
+  NTL::ZZX poly;
+  for (long i = 0; i < long(context.zMStar.getPhiM()); i++)
+    SetCoeff(poly, i, NTL::RandomBnd(1L << 20));
+  for (long i = 0; i < context.numPrimes(); i++) {
+    NTL::vec_long expected, result;
+    context.ithModulus(i).FFT(expected, poly);
+    restored->ithModulus(i).FFT(result, poly);
+    EXPECT_EQ(result, expected) << "prime #" << i;
+
+    NTL::zz_pPush push;
+    restored->ithModulus(i).restoreModulus();
+    NTL::zz_pX back;
+    restored->ithModulus(i).iFFT(back, result);
+    NTL::ZZX reduced = poly;
+    helib::PolyRed(reduced, restored->ithPrime(i), /*abs=*/true);
+    EXPECT_EQ(NTL::conv<NTL::ZZX>(back), reduced) << "prime #" << i;
+  }
+
+  // A context written without the tables is still read correctly
+  std::stringstream plain;
+  helib::writeContextBaseBinary(plain, context);
+  helib::writeContextBinary(plain, context);
+  std::unique_ptr<helib::Context> rebuilt =
+      helib::buildContextFromBinary(plain);
+  helib::readContextBinary(plain, *rebuilt);
+  EXPECT_TRUE(*rebuilt == context);
+}
+
 INSTANTIATE_TEST_SUITE_P(
     representativeParameters,
     GTestBinIO,
@@ -119,6 +119,40 @@ TEST_P(GTestEaCx, encodingWorksCorrectly)
   EXPECT_LE(maxDiff, 0.1) << "max |v-vd2|_{infty}=" << maxDiff;
 }
 
+TEST_P(GTestEaCx, batchedEncodingMatchesSingleEncoding)
+{
+  std::vector<std::vector<std::complex<double>>> vs(5);
+  for (auto& v : vs)
+    eacx.random(v);
+
+  std::vector<helib::zzX> polys;
+  std::vector<double> factors;
+  eacx.encodeMany(polys, factors, vs);
+  ASSERT_EQ(polys.size(), vs.size());
+  ASSERT_EQ(factors.size(), vs.size());
+
+  for (std::size_t i = 0; i < vs.size(); ++i) {
+    helib::zzX poly;
+    double factor = eacx.encode(poly, vs[i], -1.0);
+    EXPECT_EQ(factor, factors[i]);
+    EXPECT_EQ(poly, polys[i]);
+  }
+
+  std::vector<std::vector<std::complex<double>>> decoded;
+  eacx.decodeMany(decoded, polys, factors);
+  ASSERT_EQ(decoded.size(), vs.size());
+  for (std::size_t i = 0; i < vs.size(); ++i) {
+    std::vector<std::complex<double>> single;
+    eacx.decode(single, polys[i], factors[i]);
+    EXPECT_EQ(single, decoded[i]);
+
+    double maxDiff = 0.0;
+    for (long j = 0; j < helib::lsize(vs[i]); j++)
+      maxDiff = std::max(maxDiff, std::abs(vs[i][j] - decoded[i][j]));
+    EXPECT_LE(maxDiff, 0.1) << "max |v-decoded|_{infty}=" << maxDiff;
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(smallParameters,
                          GTestEaCx,
                          ::testing::Values(Parameters(16, 8)));
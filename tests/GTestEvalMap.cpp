@@ -10,6 +10,10 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 
+#include <cstdio>
+#include <dirent.h>
+#include <sys/stat.h>
+
 #include <NTL/BasicThreadPool.h>
 
 #include <helib/EvalMap.h>
@@ -325,6 +329,74 @@ TEST_P(GTestEvalMap, evalMapBehavesCorrectly)
   }
 }
 
+// The names of the files of dir that start with prefix
+std::vector<std::string> cacheFiles(const std::string& dir,
+                                    const std::string& prefix)
+{
+  std::vector<std::string> files;
+  if (DIR* d = ::opendir(dir.c_str())) {
+    while (struct dirent* entry = ::readdir(d)) {
+      std::string name = entry->d_name;
+      if (name.compare(0, prefix.size(), prefix) == 0)
+        files.push_back(name);
+    }
+    ::closedir(d);
+  }
+  return files;
+}
+
+TEST_P(GTestEvalMap, mappedConstantsFromTheCacheGiveTheSameResults)
+{
+  helib::EncryptedArray ea(context, context.alMod.getFactorsOverZZ()[0]);
+  helib::PlaintextArray pa(ea);
+  helib::random(ea, pa);
+  helib::Ctxt ctxt(publicKey);
+  ea.encrypt(ctxt, publicKey, pa);
+  helib::Ctxt ctxtCached = ctxt;
+
+  helib::EvalMap map(ea,
+                     /*minimal=*/false,
+                     mvec,
+                     /*invert=*/false,
+                     /*build_cache=*/true,
+                     /*normal_basis=*/false);
+
+  // A directory of its own, so that the file written can be found
+  const std::string dir = ::testing::TempDir() + "/evalmap_cache";
+  ::mkdir(dir.c_str(), 0755);
+  helib::setEvalMapCacheDir(dir);
+  // The first one writes the file, the second one only maps it
+  helib::EvalMap cold(ea,
+                      /*minimal=*/false,
+                      mvec,
+                      /*invert=*/false,
+                      /*build_cache=*/true,
+                      /*normal_basis=*/false);
+  std::vector<std::string> files = cacheFiles(dir, "evalmap-");
+  ASSERT_EQ(files.size(), 1u);
+  helib::EvalMap warm(ea,
+                      /*minimal=*/false,
+                      mvec,
+                      /*invert=*/false,
+                      /*build_cache=*/true,
+                      /*normal_basis=*/false);
+  helib::setEvalMapCacheDir("");
+  EXPECT_FALSE(map.isMapped());
+  EXPECT_TRUE(cold.isMapped());
+  EXPECT_TRUE(warm.isMapped());
+  for (const std::string& file : files)
+    std::remove((dir + "/" + file).c_str());
+
+  map.apply(ctxt);
+  warm.apply(ctxtCached);
+
+  NTL::ZZX poly, polyCached;
+  secretKey.Decrypt(poly, ctxt);
+  secretKey.Decrypt(polyCached, ctxtCached);
+  EXPECT_EQ(poly, polyCached);
+  EXPECT_EQ(ctxt.getNoiseBound(), ctxtCached.getNoiseBound());
+}
+
 // clang-format off
 INSTANTIATE_TEST_SUITE_P(someParameters, GTestEvalMap, ::testing::Values(
     //SLOW
@@ -15,6 +15,7 @@
  *   the base-$p$ representation of an encrypted values.
  */
 #include <NTL/ZZ.h>
+#include <NTL/BasicThreadPool.h>
 #include <helib/EncryptedArray.h>
 #include <helib/polyEval.h>
 
@@ -166,6 +167,65 @@ TEST_P(GTestExtractDigits, correctlyExtractsDigits)
   }
 }
 
+TEST_P(GTestExtractDigits, extractsTheSameDigitsWithSeveralThreads)
+{
+  helib::EncryptedArray ea(context);
+  std::vector<long> v;
+  ea.random(v);
+  helib::Ctxt c(publicKey);
+  ea.encrypt(c, publicKey, v);
+
+  long oldThreads = NTL::AvailableThreads();
+  std::vector<helib::Ctxt> serialDigits, parallelDigits;
+  NTL::SetNumThreads(1);
+  helib::extractDigits(serialDigits, c);
+  NTL::SetNumThreads(4);
+  helib::extractDigits(parallelDigits, c);
+  NTL::SetNumThreads(oldThreads);
+
+  ASSERT_EQ(serialDigits.size(), parallelDigits.size());
+  for (std::size_t i = 0; i < serialDigits.size(); i++) {
+    std::vector<long> serial, parallel;
+    ea.decrypt(serialDigits[i], secretKey, serial);
+    ea.decrypt(parallelDigits[i], secretKey, parallel);
+    EXPECT_EQ(serial, parallel) << " for the " << i << "th digit";
+  }
+}
+
+TEST_P(GTestExtractDigits, extendExtractsTheSameDigitsWithSeveralThreads)
+{
+  // Leave one digit of headroom, as thin bootstrapping does
+  long e = 1;
+  long digitsToExtract = r - e;
+  helib::EncryptedArray ea(context);
+  std::vector<long> v;
+  ea.random(v);
+  helib::Ctxt c(publicKey);
+  ea.encrypt(c, publicKey, v);
+
+  // With more than one thread, extendExtractDigits raises each digit to
+  // the p'th power speculatively; the result must not depend on it
+  long oldThreads = NTL::AvailableThreads();
+  std::vector<helib::Ctxt> serialDigits, parallelDigits;
+  NTL::SetNumThreads(1);
+  helib::extendExtractDigits(serialDigits, c, digitsToExtract, e);
+  NTL::SetNumThreads(4);
+  helib::extendExtractDigits(parallelDigits, c, digitsToExtract, e);
+  NTL::SetNumThreads(oldThreads);
+
+  ASSERT_EQ(serialDigits.size(), parallelDigits.size());
+  for (std::size_t i = 0; i < serialDigits.size(); i++) {
+    EXPECT_TRUE(parallelDigits[i].isCorrect())
+        << " for the " << i << "th digit";
+    EXPECT_EQ(serialDigits[i].getPtxtSpace(),
+              parallelDigits[i].getPtxtSpace());
+    std::vector<long> serial, parallel;
+    ea.decrypt(serialDigits[i], secretKey, serial);
+    ea.decrypt(parallelDigits[i], secretKey, parallel);
+    EXPECT_EQ(serial, parallel) << " for the " << i << "th digit";
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(variousPlaintextBases,
                          GTestExtractDigits,
                          ::testing::Values(
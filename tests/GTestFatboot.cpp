@@ -345,6 +345,330 @@ TEST_P(GTestFatboot, correctlyPerformsFatboot)
     helib::print_stats(std::cout);
 }
 
+TEST_P(GTestFatboot, reCryptManyBootstrapsEveryCiphertext)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*t=*/skHwt);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache);
+
+  helib::SecKey secretKey(context);
+  helib::PubKey& publicKey = secretKey;
+  secretKey.GenSecKey(skHwt);
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+
+  long p2r = context.alMod.getPPowR();
+  NTL::zz_p::init(p2r);
+
+  const long batchSize = 3;
+  std::vector<NTL::ZZX> expected(batchSize);
+  std::vector<helib::Ctxt> ctxts(batchSize, helib::Ctxt(publicKey));
+  for (long i = 0; i < batchSize; i++) {
+    NTL::zz_pX poly_p = NTL::random_zz_pX(context.zMStar.getPhiM());
+    NTL::ZZX ptxt_poly = helib::convert<NTL::ZZX>(helib::balanced_zzX(poly_p));
+    helib::PolyRed(expected[i], ptxt_poly, p2r, true);
+    secretKey.Encrypt(ctxts[i], ptxt_poly, p2r);
+  }
+
+  publicKey.reCryptMany(ctxts);
+
+  for (long i = 0; i < batchSize; i++) {
+    NTL::ZZX decrypted;
+    secretKey.Decrypt(decrypted, ctxts[i]);
+    EXPECT_EQ(expected[i], decrypted);
+  }
+}
+
+TEST_P(GTestFatboot, reCryptReportsTheProfileOfEachStage)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*t=*/skHwt);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache);
+
+  helib::SecKey secretKey(context);
+  helib::PubKey& publicKey = secretKey;
+  secretKey.GenSecKey(skHwt);
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+
+  long p2r = context.alMod.getPPowR();
+  NTL::ZZX poly(1);
+  helib::Ctxt ctxt(publicKey);
+  secretKey.Encrypt(ctxt, poly, p2r);
+
+  long callbackCalls = 0;
+  helib::setBootstrapProfileCallback(
+      [&callbackCalls](const helib::BootstrapProfile&) { callbackCalls++; });
+  helib::BootstrapProfile profile;
+  publicKey.reCrypt(ctxt, &profile);
+  helib::setBootstrapProfileCallback(nullptr);
+
+  EXPECT_EQ(callbackCalls, 1);
+  EXPECT_FALSE(profile.thin);
+  EXPECT_EQ(profile.batchSize, 1);
+  EXPECT_EQ(profile.outputCapacity, ctxt.bitCapacity());
+  EXPECT_GT(profile.total.keySwitches, 0);
+  EXPECT_GT(profile.total.automorphisms, 0);
+  EXPECT_GT(profile.total.ntts, 0);
+
+  long keySwitches = 0;
+  double wallTime = 0;
+  for (const auto& stage : profile.stages) {
+    keySwitches += stage.keySwitches;
+    wallTime += stage.wallTime;
+  }
+  EXPECT_LE(keySwitches, profile.total.keySwitches);
+  EXPECT_LE(wallTime, profile.total.wallTime);
+  EXPECT_GT(
+      profile.stage(helib::BootstrapStage::LinearTransform1).automorphisms,
+      0);
+
+  // Without a profiler the operations are not counted
+  long ntts = helib::opCounters.ntts;
+  publicKey.reCrypt(ctxt);
+  EXPECT_EQ(long(helib::opCounters.ntts), ntts);
+}
+
+TEST_P(GTestFatboot, reCryptReportsTheProfileOfATrivialBootstrap)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*t=*/skHwt);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache);
+
+  helib::SecKey secretKey(context);
+  helib::PubKey& publicKey = secretKey;
+  secretKey.GenSecKey(skHwt);
+  secretKey.genRecryptData();
+
+  long callbackCalls = 0;
+  helib::setBootstrapProfileCallback(
+      [&callbackCalls](const helib::BootstrapProfile&) { callbackCalls++; });
+
+  helib::BootstrapProfile profile;
+  helib::Ctxt empty(publicKey);
+  publicKey.reCrypt(empty, &profile);
+  EXPECT_EQ(callbackCalls, 1);
+  EXPECT_EQ(profile.batchSize, 0);
+  EXPECT_EQ(profile.total.keySwitches, 0);
+
+  helib::BootstrapProfile manyProfile;
+  std::vector<helib::Ctxt> ctxts(2, empty);
+  publicKey.reCryptMany(ctxts, &manyProfile);
+  helib::setBootstrapProfileCallback(nullptr);
+  EXPECT_EQ(callbackCalls, 2);
+  EXPECT_EQ(manyProfile.batchSize, 0);
+  EXPECT_EQ(manyProfile.total.keySwitches, 0);
+}
+
+TEST_P(GTestFatboot, autoBootstrapRecryptsTheOperandsOfAMultiplication)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*t=*/skHwt);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache);
+
+  helib::SecKey secretKey(context);
+  helib::PubKey& publicKey = secretKey;
+  secretKey.GenSecKey(skHwt);
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+
+  long p2r = context.alMod.getPPowR();
+  NTL::zz_p::init(p2r);
+  NTL::zz_pXModulus phimX(
+      NTL::conv<NTL::zz_pX>(context.zMStar.getPhimX()));
+
+  NTL::zz_pX expectedX = NTL::random_zz_pX(context.zMStar.getPhiM());
+  NTL::zz_pX expectedY = NTL::random_zz_pX(context.zMStar.getPhiM());
+  helib::Ctxt x(publicKey), y(publicKey);
+  secretKey.Encrypt(x, NTL::conv<NTL::ZZX>(expectedX), p2r);
+  secretKey.Encrypt(y, NTL::conv<NTL::ZZX>(expectedY), p2r);
+
+  // Just below the capacity that bootstrapping leaves
+  helib::AutoBootstrapPolicy policy;
+  helib::Ctxt tmp = x;
+  publicKey.reCrypt(tmp);
+  policy.minCapacity = tmp.bitCapacity() - 1;
+  ASSERT_GT(policy.minCapacity, 0);
+
+  // Bring both operands below the threshold
+  while (x.bitCapacity() >= policy.minCapacity ||
+         y.bitCapacity() >= policy.minCapacity) {
+    x.square();
+    y.square();
+    NTL::SqrMod(expectedX, expectedX, phimX);
+    NTL::SqrMod(expectedY, expectedY, phimX);
+  }
+
+  std::vector<long> batchSizes;
+  helib::setBootstrapProfileCallback(
+      [&batchSizes](const helib::BootstrapProfile& profile) {
+        batchSizes.push_back(profile.batchSize);
+      });
+  publicKey.setAutoBootstrap(policy);
+  x.multiplyBy(y);
+  publicKey.setAutoBootstrap(helib::AutoBootstrapPolicy());
+  helib::setBootstrapProfileCallback(nullptr);
+
+  // Both operands were bootstrapped together
+  EXPECT_EQ(batchSizes, std::vector<long>{2});
+
+  NTL::ZZX decrypted;
+  secretKey.Decrypt(decrypted, x);
+  EXPECT_EQ(NTL::conv<NTL::ZZX>(MulMod(expectedX, expectedY, phimX)),
+            decrypted);
+}
+
+TEST_P(GTestFatboot, autoBootstrapKeepsTheAliasingOfTheOperands)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*t=*/skHwt);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache);
+
+  helib::SecKey secretKey(context);
+  helib::PubKey& publicKey = secretKey;
+  secretKey.GenSecKey(skHwt);
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+
+  long p2r = context.alMod.getPPowR();
+  NTL::zz_p::init(p2r);
+  NTL::zz_pXModulus phimX(
+      NTL::conv<NTL::zz_pX>(context.zMStar.getPhimX()));
+
+  NTL::zz_pX expectedX = NTL::random_zz_pX(context.zMStar.getPhiM());
+  NTL::zz_pX expectedY = NTL::random_zz_pX(context.zMStar.getPhiM());
+  helib::Ctxt x(publicKey), y(publicKey);
+  secretKey.Encrypt(x, NTL::conv<NTL::ZZX>(expectedX), p2r);
+  secretKey.Encrypt(y, NTL::conv<NTL::ZZX>(expectedY), p2r);
+
+  helib::AutoBootstrapPolicy policy;
+  helib::Ctxt tmp = x;
+  publicKey.reCrypt(tmp);
+  policy.minCapacity = tmp.bitCapacity() - 1;
+  ASSERT_GT(policy.minCapacity, 0);
+
+  while (x.bitCapacity() >= policy.minCapacity ||
+         y.bitCapacity() >= policy.minCapacity) {
+    x.square();
+    y.square();
+    NTL::SqrMod(expectedX, expectedX, phimX);
+    NTL::SqrMod(expectedY, expectedY, phimX);
+  }
+
+  std::vector<long> batchSizes;
+  helib::setBootstrapProfileCallback(
+      [&batchSizes](const helib::BootstrapProfile& profile) {
+        batchSizes.push_back(profile.batchSize);
+      });
+  publicKey.setAutoBootstrap(policy);
+
+  // An operand given twice is bootstrapped once
+  helib::Ctxt twice = x;
+  twice.multiplyBy2(y, y);
+  EXPECT_EQ(batchSizes, std::vector<long>{2});
+
+  // *this as an operand is bootstrapped in place, not through a copy
+  batchSizes.clear();
+  helib::Ctxt self = x;
+  self.multiplyBy2(self, y);
+  EXPECT_EQ(batchSizes, std::vector<long>{2});
+
+  batchSizes.clear();
+  helib::Ctxt square = x;
+  square.multiplyBy(square);
+  EXPECT_EQ(batchSizes, std::vector<long>{1});
+
+  publicKey.setAutoBootstrap(helib::AutoBootstrapPolicy());
+  helib::setBootstrapProfileCallback(nullptr);
+
+  NTL::zz_pX expectedYY = NTL::SqrMod(expectedY, phimX);
+  NTL::ZZX decrypted;
+  secretKey.Decrypt(decrypted, twice);
+  EXPECT_EQ(NTL::conv<NTL::ZZX>(MulMod(expectedX, expectedYY, phimX)),
+            decrypted);
+  NTL::zz_pX expectedXX = NTL::SqrMod(expectedX, phimX);
+  secretKey.Decrypt(decrypted, self);
+  EXPECT_EQ(NTL::conv<NTL::ZZX>(MulMod(expectedXX, expectedY, phimX)),
+            decrypted);
+  secretKey.Decrypt(decrypted, square);
+  EXPECT_EQ(NTL::conv<NTL::ZZX>(expectedXX), decrypted);
+}
+
+TEST_P(GTestFatboot, autoBootstrapRecryptsTheStoredPowersOnce)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*t=*/skHwt);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache);
+
+  helib::SecKey secretKey(context);
+  helib::PubKey& publicKey = secretKey;
+  secretKey.GenSecKey(skHwt);
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+
+  long p2r = context.alMod.getPPowR();
+  NTL::zz_p::init(p2r);
+  NTL::zz_pXModulus phimX(
+      NTL::conv<NTL::zz_pX>(context.zMStar.getPhimX()));
+
+  NTL::zz_pX expected = NTL::random_zz_pX(context.zMStar.getPhiM());
+  helib::Ctxt x(publicKey);
+  secretKey.Encrypt(x, NTL::conv<NTL::ZZX>(expected), p2r);
+
+  helib::AutoBootstrapPolicy policy;
+  helib::Ctxt tmp = x;
+  publicKey.reCrypt(tmp);
+  policy.minCapacity = tmp.bitCapacity() - 1;
+  ASSERT_GT(policy.minCapacity, 0);
+
+  while (x.bitCapacity() >= policy.minCapacity) {
+    x.square();
+    NTL::SqrMod(expected, expected, phimX);
+  }
+
+  std::vector<long> batchSizes;
+  helib::setBootstrapProfileCallback(
+      [&batchSizes](const helib::BootstrapProfile& profile) {
+        batchSizes.push_back(profile.batchSize);
+      });
+  publicKey.setAutoBootstrap(policy);
+  x.power(3);
+  publicKey.setAutoBootstrap(helib::AutoBootstrapPolicy());
+  helib::setBootstrapProfileCallback(nullptr);
+
+  // X is bootstrapped before X^2 = X*X, and X^2 before X^3 = X*X^2. Each
+  // of them is bootstrapped in place, and only once.
+  EXPECT_EQ(batchSizes, (std::vector<long>{1, 1}));
+
+  NTL::ZZX decrypted;
+  secretKey.Decrypt(decrypted, x);
+  NTL::zz_pX cube = MulMod(NTL::SqrMod(expected, phimX), expected, phimX);
+  EXPECT_EQ(NTL::conv<NTL::ZZX>(cube), decrypted);
+}
+
 // LEGACY TEST DEFAULT PARAMETERS:
 // long p=2;
 // long r=1;
@@ -339,4 +339,94 @@ TYPED_TEST(GTestMatmul, multipliesWithoutErrors)
   EXPECT_TRUE(equals(this->ea, v, v1)); // check that we've got the right answer
 }
 
+TYPED_TEST(GTestMatmul, streamingGivesTheSameResultAsTheCachedConstants)
+{
+  const typename TypeParam::MatrixType& mat = *(this->matrixPtr);
+  typename TypeParam::MatrixType::ExecType cached_exec(mat, (this->minimal));
+  typename TypeParam::MatrixType::ExecType stream_exec(mat, (this->minimal));
+  cached_exec.upgrade();
+  stream_exec.setStreaming(/*window=*/2);
+
+  helib::PlaintextArray v(this->ea);
+  random(this->ea, v);
+  helib::Ctxt ctxt(this->secretKey);
+  this->ea.encrypt(ctxt, this->secretKey, v);
+  helib::Ctxt ctxt2 = ctxt;
+
+  cached_exec.mul(ctxt);
+  stream_exec.mul(ctxt2);
+
+  helib::PlaintextArray v1(this->ea), v2(this->ea);
+  this->ea.decrypt(ctxt, this->secretKey, v1);
+  this->ea.decrypt(ctxt2, this->secretKey, v2);
+  mul(v, mat);
+  EXPECT_TRUE(equals(this->ea, v, v1));
+  EXPECT_TRUE(equals(this->ea, v, v2));
+}
+
+TYPED_TEST(GTestMatmul, execsReadFromAFileGiveTheSameResult)
+{
+  typedef typename TypeParam::MatrixType::ExecType ExecType;
+  const typename TypeParam::MatrixType& mat = *(this->matrixPtr);
+  ExecType zzx_exec(mat, (this->minimal));
+  ExecType dcrt_exec(mat, (this->minimal));
+  dcrt_exec.upgrade();
+
+  const std::string zzxFile = ::testing::TempDir() + "/matmul_zzx.bin";
+  const std::string dcrtFile = ::testing::TempDir() + "/matmul_dcrt.bin";
+  ASSERT_TRUE(zzx_exec.write(zzxFile, "zzx", /*dcrt=*/false));
+  ASSERT_TRUE(dcrt_exec.write(dcrtFile, "dcrt"));
+
+  // A different header is a mismatch
+  EXPECT_FALSE(ExecType::read(zzxFile, this->ea, "dcrt"));
+  std::unique_ptr<ExecType> zzx_read = ExecType::read(zzxFile, this->ea, "zzx");
+  std::unique_ptr<ExecType> dcrt_read =
+      ExecType::read(dcrtFile, this->ea, "dcrt");
+  ASSERT_TRUE(zzx_read);
+  ASSERT_TRUE(dcrt_read);
+
+  helib::PlaintextArray v(this->ea);
+  random(this->ea, v);
+  helib::Ctxt ctxt(this->secretKey);
+  this->ea.encrypt(ctxt, this->secretKey, v);
+  helib::Ctxt ctxt2 = ctxt;
+
+  zzx_read->mul(ctxt);
+  dcrt_read->mul(ctxt2);
+
+  helib::PlaintextArray v1(this->ea), v2(this->ea);
+  this->ea.decrypt(ctxt, this->secretKey, v1);
+  this->ea.decrypt(ctxt2, this->secretKey, v2);
+  mul(v, mat);
+  EXPECT_TRUE(equals(this->ea, v, v1));
+  EXPECT_TRUE(equals(this->ea, v, v2));
+
+  std::remove(zzxFile.c_str());
+  std::remove(dcrtFile.c_str());
+}
+
+TYPED_TEST(GTestMatmul, mulManyGivesTheSameResultAsMul)
+{
+  const typename TypeParam::MatrixType& mat = *(this->matrixPtr);
+  typename TypeParam::MatrixType::ExecType mat_exec(mat, (this->minimal));
+
+  std::vector<helib::PlaintextArray> vs;
+  std::vector<helib::Ctxt> ctxts;
+  for (long i = 0; i < 3; i++) {
+    vs.emplace_back(this->ea);
+    random(this->ea, vs.back());
+    ctxts.emplace_back(this->secretKey);
+    this->ea.encrypt(ctxts.back(), this->secretKey, vs.back());
+  }
+
+  mat_exec.mulMany(ctxts);
+
+  for (long i = 0; i < 3; i++) {
+    helib::PlaintextArray v1(this->ea);
+    this->ea.decrypt(ctxts[i], this->secretKey, v1);
+    mul(vs[i], mat);
+    EXPECT_TRUE(equals(this->ea, vs[i], v1)) << " for ciphertext " << i;
+  }
+}
+
 } // namespace
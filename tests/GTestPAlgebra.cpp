@@ -10,6 +10,7 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 #include <cassert>
+#include <fstream>
 #include <string>
 #include <sstream>
 #include <NTL/ZZ.h>
@@ -120,11 +121,78 @@ TEST_P(GTestPAlgebra, readsAndWritesContextsAsStrings)
   EXPECT_EQ(context, c1);
 }
 
+TEST_P(GTestPAlgebra, embedsInSlotsAndDecodesCorrectly)
+{
+  if (context.alMod.getTag() != helib::PA_zz_p_tag)
+    return; // only testing the p > 2 tables here
+
+  const helib::PAlgebraModDerived<helib::PA_zz_p>& tab =
+      context.alMod.getDerived(helib::PA_zz_p());
+  NTL::zz_pBak bak;
+  bak.save();
+  tab.restoreContext();
+
+  // G = F1 is allowed also when r > 1
+  helib::MappingData<helib::PA_zz_p> mappingData;
+  tab.mapToSlots(mappingData, tab.getFactors()[0]);
+  long d = mappingData.getDegG();
+
+  long nSlots = context.zMStar.getNSlots();
+  std::vector<NTL::zz_pX> alphas(nSlots);
+  for (auto& alpha : alphas)
+    NTL::random(alpha, d);
+
+  NTL::zz_pX H;
+  tab.embedInSlots(H, alphas, mappingData);
+  EXPECT_LT(NTL::deg(H), context.zMStar.getPhiM());
+
+  // Compare against reducing H modulo each factor directly
+  if (d == 1) {
+    for (long i = 0; i < nSlots; i++)
+      EXPECT_EQ(H % tab.getFactors()[i], alphas[i]);
+  }
+
+  std::vector<NTL::zz_pX> decoded;
+  tab.decodePlaintext(decoded, H, mappingData);
+  EXPECT_EQ(decoded, alphas);
+}
+
+TEST_P(GTestPAlgebra, tablesReadFromTheCacheMatchComputedOnes)
+{
+  const std::string dir = ::testing::TempDir();
+  helib::setPAlgebraModCacheDir(dir);
+  helib::Context cold(m, p, r, gens, ords); // computes and writes the tables
+  helib::Context warm(m, p, r, gens, ords); // reads them
+  helib::setPAlgebraModCacheDir("");
+
+  // The cache file is named after (m, p, r, gens, ords)
+  const helib::PAlgebra& zMStar = context.zMStar;
+  std::ostringstream name;
+  name << dir << "/palgebramod-m" << m << "-p" << p << "-r" << r << "-g";
+  for (long i = 0; i < zMStar.numOfGens(); i++)
+    name << (i ? "_" : "") << zMStar.ZmStarGen(i);
+  name << "-o";
+  for (long i = 0; i < zMStar.numOfGens(); i++)
+    name << (i ? "_" : "")
+         << (zMStar.SameOrd(i) ? zMStar.OrderOf(i) : -zMStar.OrderOf(i));
+  name << ".bin";
+  EXPECT_TRUE(std::ifstream(name.str()).good());
+
+  EXPECT_EQ(cold.alMod.getFactorsOverZZ(), context.alMod.getFactorsOverZZ());
+  EXPECT_EQ(warm.alMod.getFactorsOverZZ(), context.alMod.getFactorsOverZZ());
+  for (long i = 0; i < zMStar.numOfGens(); i++)
+    for (long j = 0; j <= zMStar.OrderOf(i); j++)
+      EXPECT_EQ(warm.alMod.getMask_zzX(i, j), context.alMod.getMask_zzX(i, j));
+}
+
 INSTANTIATE_TEST_SUITE_P(
     smallParameters,
     GTestPAlgebra,
     ::testing::Values(
         // FAST
-        Parameters(91, 2, 1, std::vector<long>{}, std::vector<long>{})));
+        Parameters(91, 2, 1, std::vector<long>{}, std::vector<long>{}),
+        // p = 1 mod m, so the slots are Z_{p^r}
+        Parameters(17, 103, 2, std::vector<long>{}, std::vector<long>{}),
+        Parameters(16, 113, 1, std::vector<long>{}, std::vector<long>{})));
 
 } // namespace
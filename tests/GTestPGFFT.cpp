@@ -11,6 +11,7 @@
 #include <cstdint>
 #include <stdexcept>
 #include <limits>
+#include <NTL/BasicThreadPool.h>
 #include <gtest/gtest.h>
 
 namespace {
@@ -333,4 +334,69 @@ TEST(GTestPGFFT, PGFFTWorksInRange10000to20000Points)
     TestIt(n);
   }
 }
+
+TEST(GTestPGFFT, PGFFTWorksWithEverySIMDPath)
+{
+  SetSeed();
+
+  const helib::PGFFT::simd_path best = helib::PGFFT::simd_enabled();
+  for (helib::PGFFT::simd_path path : {helib::PGFFT::SIMD_NONE,
+                                       helib::PGFFT::SIMD_AVX2,
+                                       helib::PGFFT::SIMD_AVX512}) {
+    // Paths not supported by the CPU fall back to the best supported one
+    EXPECT_LE(helib::PGFFT::set_simd_path(path), path);
+    for (long n : {1, 2, 3, 17, 100, 1024, 12345, 32 * 1024})
+      TestIt(n);
+  }
+  helib::PGFFT::set_simd_path(best);
+}
+
+// The batched and multi-threaded transforms do the same operations as
+// apply, so the results should be identical.
+static void TestBatchAndMT(long n)
+{
+  helib::PGFFT pgfft(n);
+
+  const long count = 5;
+  const long stride = n + 3;
+  vector<cmplx_t> src(count * stride);
+  for (auto& x : src)
+    x = cmplx_t(RandomBnd(20) - 10, RandomBnd(20) - 10);
+
+  vector<cmplx_t> expected(count * stride);
+  for (long i = 0; i < count; i++)
+    pgfft.apply(&src[i * stride], &expected[i * stride]);
+
+  vector<cmplx_t> batch(src);
+  pgfft.apply_batch(batch.data(), batch.data(), count, stride);
+  for (long i = 0; i < count; i++)
+    for (long j = 0; j < n; j++)
+      EXPECT_EQ(batch[i * stride + j], expected[i * stride + j]);
+
+  // apply_mt takes its threads from NTL's pool, whose size bounds them
+  long oldThreads = NTL::AvailableThreads();
+  for (long nthreads : {1, 2, 3, 4, 16}) {
+    NTL::SetNumThreads(nthreads);
+    vector<cmplx_t> mt(n);
+    pgfft.apply_mt(src.data(), mt.data(), nthreads);
+    for (long j = 0; j < n; j++)
+      EXPECT_EQ(mt[j], expected[j]);
+  }
+  NTL::SetNumThreads(4);
+  vector<cmplx_t> capped(n);
+  pgfft.apply_mt(src.data(), capped.data(), 16);
+  for (long j = 0; j < n; j++)
+    EXPECT_EQ(capped[j], expected[j]);
+  NTL::SetNumThreads(oldThreads);
+}
+
+TEST(GTestPGFFT, PGFFTBatchAndMultiThreadedMatchSingle)
+{
+  SetSeed();
+
+  for (long n : {1, 2, 7, 100, 1024, 12345})
+    TestBatchAndMT(n);
+  for (long n = 16 * 1024; n <= 64 * 1024; n *= 2)
+    TestBatchAndMT(n);
+}
 } // namespace
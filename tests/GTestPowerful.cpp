@@ -111,6 +111,24 @@ TEST_P(GTestPowerful, highLevelConversionWorks)
   EXPECT_EQ(poly1, poly2);
 }
 
+TEST_P(GTestPowerful, wordConversionMatchesMultiPrecisionOne)
+{
+  helib::PowerfulDCRT p2d(context, mvec);
+  NTL::Vec<long> words;
+  NTL::Vec<NTL::ZZ> zzs;
+  words.SetLength(context.zMStar.getPhiM());
+  zzs.SetLength(words.length());
+  for (long i = 0; i < words.length(); i++) {
+    words[i] = NTL::RandomBnd(1L << 60) - (1L << 59);
+    zzs[i] = words[i];
+  }
+
+  NTL::ZZX poly1, poly2;
+  p2d.powerfulToZZX(poly1, zzs);
+  p2d.powerfulToZZX(poly2, words);
+  EXPECT_EQ(poly1, poly2);
+}
+
 INSTANTIATE_TEST_SUITE_P(standardParameters,
                          GTestPowerful,
                          ::testing::Values(
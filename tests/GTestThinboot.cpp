@@ -532,6 +532,137 @@ TEST_P(GTestThinboot, correctlyPerformsThinboot)
   }
 }
 
+TEST_P(GTestThinboot, thinReCryptManyBootstrapsEveryCiphertext)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*skHwt=*/skHwt,
+                       /*resolution=*/3,
+                       /*bitsInSpecialPrimes=*/special_bits);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache, /*alsoThick=*/false);
+
+  helib::SecKey secretKey(context);
+  secretKey.GenSecKey(skHwt);
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+  const helib::PubKey& publicKey = secretKey;
+
+  long p2r = context.alMod.getPPowR();
+  long nslots = context.zMStar.getNSlots();
+  NTL::ZZX GG = context.alMod.getFactorsOverZZ()[0];
+  helib::EncryptedArray ea(context, GG);
+
+  // Thin bootstrapping assumes that the slots hold constants
+  const long batchSize = 3;
+  NTL::zz_p::init(p2r);
+  std::vector<std::vector<NTL::ZZX>> expected(batchSize);
+  std::vector<helib::Ctxt> ctxts(batchSize, helib::Ctxt(publicKey));
+  for (long i = 0; i < batchSize; i++) {
+    NTL::Vec<NTL::zz_p> val(NTL::INIT_SIZE, nslots);
+    std::vector<NTL::ZZX> ptxt(nslots);
+    expected[i].resize(nslots);
+    for (long j = 0; j < nslots; j++) {
+      random(val[j]);
+      ptxt[j] = NTL::conv<NTL::ZZX>(NTL::conv<NTL::ZZ>(rep(val[j])));
+      NTL::zz_p square = val[j] * val[j];
+      expected[i][j] = NTL::conv<NTL::ZZX>(NTL::conv<NTL::ZZ>(rep(square)));
+    }
+    ea.encrypt(ctxts[i], publicKey, ptxt);
+    ctxts[i].multiplyBy(ctxts[i]);
+  }
+
+  publicKey.thinReCryptMany(ctxts);
+
+  for (long i = 0; i < batchSize; i++) {
+    std::vector<NTL::ZZX> decrypted;
+    ea.decrypt(ctxts[i], secretKey, decrypted);
+    EXPECT_EQ(expected[i], decrypted) << " for the " << i << "th ciphertext";
+  }
+}
+
+TEST_P(GTestThinboot, thinAutoBootstrapRecryptsTheOperandsTogether)
+{
+  helib::buildModChain(context,
+                       bits,
+                       c,
+                       /*willBeBootstrappable=*/true,
+                       /*skHwt=*/skHwt,
+                       /*resolution=*/3,
+                       /*bitsInSpecialPrimes=*/special_bits);
+  context.makeBootstrappable(mvec, /*t=*/skHwt, useCache, /*alsoThick=*/false);
+
+  helib::SecKey secretKey(context);
+  secretKey.GenSecKey(skHwt);
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+  const helib::PubKey& publicKey = secretKey;
+
+  long p2r = context.alMod.getPPowR();
+  long nslots = context.zMStar.getNSlots();
+  NTL::ZZX GG = context.alMod.getFactorsOverZZ()[0];
+  helib::EncryptedArray ea(context, GG);
+
+  // Thin bootstrapping assumes that the slots hold constants
+  NTL::zz_p::init(p2r);
+  NTL::Vec<NTL::zz_p> valX(NTL::INIT_SIZE, nslots);
+  NTL::Vec<NTL::zz_p> valY(NTL::INIT_SIZE, nslots);
+  std::vector<NTL::ZZX> ptxtX(nslots), ptxtY(nslots);
+  for (long j = 0; j < nslots; j++) {
+    random(valX[j]);
+    random(valY[j]);
+    ptxtX[j] = NTL::conv<NTL::ZZX>(NTL::conv<NTL::ZZ>(rep(valX[j])));
+    ptxtY[j] = NTL::conv<NTL::ZZX>(NTL::conv<NTL::ZZ>(rep(valY[j])));
+  }
+  helib::Ctxt x(publicKey), y(publicKey);
+  ea.encrypt(x, publicKey, ptxtX);
+  ea.encrypt(y, publicKey, ptxtY);
+
+  helib::AutoBootstrapPolicy policy;
+  policy.thin = true;
+  helib::Ctxt tmp = x;
+  publicKey.thinReCrypt(tmp);
+  policy.minCapacity = tmp.bitCapacity() - 1;
+  ASSERT_GT(policy.minCapacity, 0);
+
+  // Bring both operands below the threshold
+  while (x.bitCapacity() >= policy.minCapacity ||
+         y.bitCapacity() >= policy.minCapacity) {
+    x.square();
+    y.square();
+    for (long j = 0; j < nslots; j++) {
+      valX[j] *= valX[j];
+      valY[j] *= valY[j];
+    }
+  }
+
+  std::vector<long> batchSizes;
+  std::vector<bool> thin;
+  helib::setBootstrapProfileCallback(
+      [&](const helib::BootstrapProfile& profile) {
+        batchSizes.push_back(profile.batchSize);
+        thin.push_back(profile.thin);
+      });
+  publicKey.setAutoBootstrap(policy);
+  x.multiplyBy(y);
+  publicKey.setAutoBootstrap(helib::AutoBootstrapPolicy());
+  helib::setBootstrapProfileCallback(nullptr);
+
+  // Both operands were thin-bootstrapped together
+  EXPECT_EQ(batchSizes, std::vector<long>{2});
+  EXPECT_EQ(thin, std::vector<bool>{true});
+
+  std::vector<NTL::ZZX> expected(nslots), decrypted;
+  for (long j = 0; j < nslots; j++)
+    expected[j] =
+        NTL::conv<NTL::ZZX>(NTL::conv<NTL::ZZ>(rep(valX[j] * valY[j])));
+  ea.decrypt(x, secretKey, decrypted);
+  EXPECT_EQ(expected, decrypted);
+}
+
 // LEGACY TEST DEFAULT PARAMETERS:
 // long p=2;
 // long r=1;
@@ -79,6 +79,48 @@ TEST_P(TestContext, hasCorrectSlotRingWhenConstructed)
   EXPECT_EQ(context->slotRing->G, helib::getG(*(context->ea)));
 }
 
+TEST_P(TestContext, slotStructuresAreBuiltOnFirstUse)
+{
+  EXPECT_FALSE(context->alMod.isBuilt());
+  EXPECT_FALSE(context->ea.isBuilt());
+  EXPECT_EQ(context->alMod.getPPowR(), pow(p, r));
+  EXPECT_FALSE(context->alMod.isBuilt());
+
+  EXPECT_EQ(context->ea->size(), context->zMStar.getNSlots());
+  EXPECT_TRUE(context->alMod.isBuilt());
+  EXPECT_TRUE(context->ea.isBuilt());
+}
+
+TEST_P(TestContext, noSlotsContextThrowsOnSlotUseButSupportsKeySwitching)
+{
+  context->disableSlots();
+  buildModChain(*context, /*bits=*/100, /*c=*/2);
+  EXPECT_THROW(context->ea->size(), helib::LogicError);
+  EXPECT_THROW(context->slotRing->p2r, helib::LogicError);
+
+  helib::SecKey secretKey(*context);
+  secretKey.GenSecKey();
+  helib::addSome1DMatrices(secretKey);
+  long k = context->zMStar.ZmStarGen(0);
+
+  NTL::ZZX poly, expected, result;
+  for (long i = 0; i < 5; i++)
+    SetCoeff(poly, i, i % p);
+  helib::Ctxt ctxt(secretKey);
+  secretKey.Encrypt(ctxt, poly, p);
+  ctxt.smartAutomorph(k);
+  secretKey.Decrypt(result, ctxt);
+
+  // X^i -> X^{ik mod m}, then reduce mod Phi_m(X)
+  for (long i = 0; i <= deg(poly); i++)
+    SetCoeff(expected, (i * k) % m, coeff(poly, i));
+  rem(expected, expected, context->zMStar.getPhimX());
+  helib::PolyRed(result, p, /*abs=*/true);
+  helib::PolyRed(expected, p, /*abs=*/true);
+  EXPECT_EQ(result, expected);
+  EXPECT_FALSE(context->alMod.isBuilt());
+}
+
 TEST_P(TestContext, buildModChainThrowsWhenBitsIsZero)
 {
   EXPECT_THROW(helib::buildModChain(*context, /*bits=*/0, /*c=*/2),
@@ -15,8 +15,14 @@
 // The older tests with more extensive coverage can be found in the files
 // with names matching "GTest*".
 
+#include <chrono>
+#include <sstream>
+#include <thread>
+
 #include <helib/helib.h>
 #include <helib/debugging.h>
+#include <helib/ZeroEncryptionPool.h>
+#include <helib/EncodedPtxt.h>
 
 #include "test_common.h"
 #include "gtest/gtest.h"
@@ -244,6 +250,343 @@ TEST_P(TestCtxtWithBadDimensions, rotate1DRotatesCorrectlyWithBadDimensions)
   }
 }
 
+TEST_P(TestCtxt, encryptManyEncryptsEachPlaintext)
+{
+  std::vector<helib::Ptxt<helib::BGV>> ptxts;
+  for (long i = 0; i < 5; ++i) {
+    std::vector<long> data(ea.size());
+    std::iota(data.begin(), data.end(), i);
+    for (auto& num : data)
+      num %= p;
+    ptxts.emplace_back(context, data);
+  }
+
+  std::vector<helib::Ctxt> ctxts;
+  publicKey.EncryptMany(ctxts, ptxts);
+
+  ASSERT_EQ(ctxts.size(), ptxts.size());
+  for (std::size_t i = 0; i < ctxts.size(); ++i) {
+    helib::Ptxt<helib::BGV> result(context);
+    secretKey.Decrypt(result, ctxts[i]);
+    EXPECT_EQ(ptxts[i], result) << "EncryptMany failed at index " << i;
+  }
+}
+
+TEST_P(TestCtxt, encryptManySamplesFreshRandomnessForEachCiphertext)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  for (auto& num : data)
+    num %= p;
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  std::vector<helib::Ptxt<helib::BGV>> ptxts(4, ptxt);
+
+  // Each thread reuses its sampling scratch space for several ciphertexts
+  std::vector<helib::Ctxt> ctxts;
+  publicKey.EncryptMany(ctxts, ptxts);
+
+  ASSERT_EQ(ctxts.size(), ptxts.size());
+  for (std::size_t i = 0; i < ctxts.size(); ++i) {
+    helib::Ptxt<helib::BGV> result(context);
+    secretKey.Decrypt(result, ctxts[i]);
+    EXPECT_EQ(ptxts[i], result);
+    for (std::size_t j = 0; j < i; ++j)
+      EXPECT_FALSE(ctxts[i] == ctxts[j]) << i << " and " << j;
+  }
+}
+
+TEST_P(TestCtxt, encryptUsesAttachedZeroEncryptionPool)
+{
+  auto pool = std::make_shared<helib::ZeroEncryptionPool>(publicKey,
+                                                          /*depth=*/2,
+                                                          /*numThreads=*/0);
+  pool->refill();
+  EXPECT_EQ(pool->getMetrics().queued, 2);
+  publicKey.setZeroEncryptionPool(pool);
+
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  for (auto& num : data)
+    num %= p;
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  for (long i = 0; i < 3; ++i) {
+    helib::Ctxt ctxt(publicKey);
+    publicKey.Encrypt(ctxt, ptxt);
+    helib::Ptxt<helib::BGV> result(context);
+    secretKey.Decrypt(result, ctxt);
+    EXPECT_EQ(ptxt, result);
+  }
+  publicKey.setZeroEncryptionPool(nullptr);
+
+  helib::ZeroEncryptionPool::Metrics metrics = pool->getMetrics();
+  EXPECT_EQ(metrics.produced, 2);
+  EXPECT_EQ(metrics.consumed, 2);
+  EXPECT_EQ(metrics.starved, 1);
+}
+
+TEST_P(TestCtxt, encryptUsesModSwitchedZeroEncryptions)
+{
+  helib::IndexSet primeSet = context.ctxtPrimes;
+  primeSet.remove(primeSet.last());
+  auto pool = std::make_shared<helib::ZeroEncryptionPool>(publicKey,
+                                                          /*depth=*/1,
+                                                          /*numThreads=*/0,
+                                                          primeSet);
+  pool->refill();
+  publicKey.setZeroEncryptionPool(pool);
+
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  for (auto& num : data)
+    num %= p;
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+  publicKey.setZeroEncryptionPool(nullptr);
+
+  EXPECT_EQ(pool->getMetrics().consumed, 1);
+  EXPECT_EQ(ctxt.getPrimeSet(), primeSet);
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(ptxt, result);
+}
+
+#ifdef HELIB_THREADS
+TEST_P(TestCtxt, zeroEncryptionPoolRefillsInTheBackground)
+{
+  auto pool = std::make_shared<helib::ZeroEncryptionPool>(publicKey,
+                                                          /*depth=*/2,
+                                                          /*numThreads=*/1);
+
+  // Wait for the worker to fill the queue
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+  while (pool->getMetrics().queued < 2 &&
+         std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(pool->getMetrics().queued, 2);
+
+  publicKey.setZeroEncryptionPool(pool);
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  for (auto& num : data)
+    num %= p;
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+  publicKey.setZeroEncryptionPool(nullptr);
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(ptxt, result);
+
+  helib::ZeroEncryptionPool::Metrics metrics = pool->getMetrics();
+  EXPECT_GE(metrics.produced, 2);
+  EXPECT_EQ(metrics.consumed, 1);
+  EXPECT_EQ(metrics.starved, 0);
+  EXPECT_EQ(metrics.failed, 0);
+}
+#endif
+
+TEST_P(TestCtxt, seededCtxtSerializesAndExpandsCorrectly)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  for (auto& num : data)
+    num %= p;
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+
+  helib::SeededCtxt seeded(secretKey);
+  secretKey.skEncrypt(seeded, ptxt.getPolyRepr());
+
+  std::stringstream seededStream;
+  seeded.write(seededStream);
+
+  // Read back relative to the public key, as a server would
+  helib::SeededCtxt received(publicKey);
+  received.read(seededStream);
+  helib::Ctxt ctxt(publicKey);
+  received.expand(ctxt);
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(ptxt, result);
+
+  // The seeded form should be about half the size of the full ciphertext
+  std::stringstream fullStream;
+  ctxt.write(fullStream);
+  EXPECT_LT(seededStream.str().size(), fullStream.str().size());
+
+  // Expanding twice gives the same ciphertext
+  std::vector<helib::SeededCtxt> many(2, received);
+  std::vector<helib::Ctxt> expanded;
+  helib::expandSeededCtxts(expanded, many);
+  ASSERT_EQ(expanded.size(), 2u);
+  EXPECT_EQ(expanded[0], ctxt);
+  EXPECT_EQ(expanded[1], ctxt);
+}
+
+TEST_P(TestCtxt, fastDecryptMatchesDecrypt)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  for (auto& num : data)
+    num %= p;
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+
+  std::vector<helib::Ptxt<helib::BGV>> ptxts(3, ptxt);
+  std::vector<helib::Ctxt> ctxts;
+  publicKey.EncryptMany(ctxts, ptxts);
+  ctxts[1].multiplyBy(ctxts[2]);
+  ptxts[1].multiplyBy(ptxts[2]);
+
+  for (const auto& ctxt : ctxts) {
+    NTL::ZZX expected, result;
+    secretKey.Decrypt(expected, ctxt);
+    secretKey.fastDecrypt(result, ctxt);
+    EXPECT_EQ(expected, result);
+  }
+
+  std::vector<helib::Ptxt<helib::BGV>> results;
+  secretKey.DecryptMany(results, ctxts);
+  ASSERT_EQ(results.size(), ptxts.size());
+  for (std::size_t i = 0; i < ptxts.size(); ++i)
+    EXPECT_EQ(ptxts[i], results[i]);
+}
+
+TEST_P(TestCtxt, encodedPtxtOperationsMatchPtxtOperations)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  for (auto& num : data)
+    num %= p;
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ptxt<helib::BGV> weights(context, data);
+  weights += 1;
+
+  helib::EncodedPtxt encoded(context, weights);
+  EXPECT_FALSE(encoded.isUpgraded());
+  std::size_t compactSize = encoded.memoryUsage();
+
+  for (bool upgrade : {false, true}) {
+    if (upgrade)
+      encoded.upgrade(context.ctxtPrimes);
+
+    helib::Ctxt ctxt(publicKey);
+    publicKey.Encrypt(ctxt, ptxt);
+    helib::Ptxt<helib::BGV> expected(ptxt);
+
+    ctxt *= encoded;
+    expected *= weights;
+    ctxt += encoded;
+    expected += weights;
+    ctxt.modDownToSet(ctxt.naturalPrimeSet());
+    ctxt -= encoded;
+    expected -= weights;
+
+    helib::Ptxt<helib::BGV> result(context);
+    secretKey.Decrypt(result, ctxt);
+    EXPECT_EQ(expected, result);
+  }
+
+  EXPECT_GT(encoded.memoryUsage(), compactSize);
+  encoded.downgrade();
+  EXPECT_EQ(encoded.memoryUsage(), compactSize);
+}
+
+TEST_P(TestCtxt, totalSumsWorksCorrectly)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+
+  helib::totalSums(ea, ctxt);
+  ptxt.totalSums();
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(ptxt, result);
+}
+
+TEST_P(TestCtxt, totalProductsWorksCorrectly)
+{
+  std::vector<long> data(ea.size());
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = 1 + i % std::min<unsigned long>(p - 1, 3);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+
+  helib::totalProducts(ea, ctxt);
+  ptxt.totalProduct();
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(ptxt, result);
+}
+
+TEST_P(TestCtxtWithBadDimensions,
+       allSlotsReduceWorksCorrectlyWithBadDimensions)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+
+  helib::allSlotsReduce(ea, ctxt, [](helib::Ctxt& acc, const helib::Ctxt& b) {
+    acc += b;
+  });
+  ptxt.totalSums();
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(ptxt, result);
+}
+
+TEST_P(TestCtxtWithBadDimensions, rotateAndShiftWorkWithCachedMasks)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+
+  helib::EncodedPtxtCache* cache = ea.getMaskCache();
+  ASSERT_NE(cache, nullptr);
+  const std::size_t limit = cache->getLimit();
+
+  // The second round uses the cached masks, the third one a cache that
+  // can only hold the mask being used
+  for (long round = 0; round < 3; ++round) {
+    if (round == 2)
+      cache->setLimit(1);
+    for (long amt : {1l, 2l, -3l, long(ea.size()) / 2 + 1}) {
+      helib::Ctxt rotated(ctxt);
+      ea.rotate(rotated, amt);
+      helib::Ptxt<helib::BGV> expected(ptxt);
+      expected.rotate(amt);
+      helib::Ptxt<helib::BGV> result(context);
+      secretKey.Decrypt(result, rotated);
+      EXPECT_EQ(expected, result);
+
+      helib::Ctxt shifted(ctxt);
+      ea.shift(shifted, amt);
+      expected = ptxt;
+      expected.shift(amt);
+      secretKey.Decrypt(result, shifted);
+      EXPECT_EQ(expected, result);
+    }
+    if (round == 0)
+      EXPECT_GT(cache->size(), 0);
+    if (round == 2)
+      EXPECT_LE(cache->size(), 1);
+  }
+
+  cache->setLimit(limit);
+}
+
 // Use this when thoroughly exploring an (m, p) grid of parameters.
 // std::vector<BGVParameters> getParameters(bool good)
 // {
@@ -1618,6 +1618,42 @@ TEST_P(TestPtxtBGV, runningSumsWorksCorrectly)
   }
 }
 
+TEST_P(TestPtxtBGV, arithmeticMatchesSlotWiseArithmeticModPPowR)
+{
+  // When d = 1 the slots are kept as plain integers, the non-const accessor
+  // switches to the PolyMod form and the next operation switches back.
+  long n = context.ea->size();
+  long q = ppowr;
+  std::vector<long> a(n), b(n);
+  for (long i = 0; i < n; ++i) {
+    a[i] = (3 * i + 1) % q;
+    b[i] = (5 * i + 2) % q;
+  }
+  helib::Ptxt<helib::BGV> ptxt(context, a);
+  helib::Ptxt<helib::BGV> other(context, b);
+
+  ptxt *= other;
+  ptxt[0] = a[0] * b[0];
+  ptxt += other;
+  ptxt -= 3;
+  ptxt.power(3);
+  ptxt.rotate(1);
+  ptxt.runningSums();
+
+  std::vector<long> expected(n);
+  for (long i = 0; i < n; ++i) {
+    long x = NTL::SubMod((a[i] * b[i] + b[i]) % q, 3 % q, q);
+    expected[helib::mcMod(i + 1, n)] = NTL::PowerMod(x, 3, q);
+  }
+  for (long i = 1; i < n; ++i)
+    expected[i] = (expected[i] + expected[i - 1]) % q;
+
+  for (long i = 0; i < n; ++i) {
+    EXPECT_EQ(ptxt[i], expected[i]);
+  }
+  EXPECT_EQ(ptxt, helib::Ptxt<helib::BGV>(context, expected));
+}
+
 TEST_P(TestPtxtBGV, totalSumsWorksCorrectly)
 {
   std::vector<long> data(context.ea->size());